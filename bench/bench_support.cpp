@@ -0,0 +1,172 @@
+#include "bench_support.h"
+#include "mandelbrot.h"
+
+#include <chrono>
+#include <algorithm>
+
+
+// Set the paths to the shaders and palettes
+const char* BENCH_VERTEX_SHADER_PATH = "./shaders/vertex_shader.glsl";
+const char* BENCH_FRAGMENT_SHADER_PATH = "./shaders/fragment_shader.glsl";
+const char* BENCH_PALETTES_PATH = "./palettes";
+
+// Size of the cumulative distribution buffer read by the fragment shader in histogram mode (not used here, but bound)
+constexpr GLsizeiptr BENCH_CDF_SIZE = 8192 * sizeof(GLuint);
+
+
+const std::vector<benchView> BENCH_VIEWS = {
+	{ "default", { 0.0, 0.0 }, 1.0, { 256, 2048 } },
+	{ "seahorse-valley", { -0.7453, 0.1127 }, 200.0, { 1024, 8192 } },
+	{ "elephant-valley", { 0.2925, 0.0149 }, 100.0, { 1024, 8192 } },
+
+	// Nucleus of a period 200 minibrot about 1e-12 across
+	{ "minibrot-1e-12", { -0.7436369322415599, 0.1318358297239205 }, 1e12, { 4096, 16384 } },
+
+	// Mostly the main cardioid, nearly every pixel runs to the iteration limit
+	{ "interior", { -0.1, 0.0 }, 3.0, { 256, 2048 } },
+
+	// Far from the set, every pixel escapes within a few iterations
+	{ "exterior", { 1.2, 1.2 }, 8.0, { 256, 2048 } }
+};
+
+const std::vector<benchResolution> BENCH_RESOLUTIONS = { { 320, 240 }, { 1280, 720 } };
+
+
+GpuKernel::GpuKernel() : context(createHeadlessContext()), program(nullptr), pixelState(nullptr), VAO(0), VBO(0), cdfSSBO(0),
+	framebuffer(0), renderbuffer(0), width(0), height(0) {
+	if (context == nullptr)
+		return;
+
+	program = new Shader(BENCH_VERTEX_SHADER_PATH, BENCH_FRAGMENT_SHADER_PATH);
+	pixelState = new PixelStateBuffer(0);
+	palettes = loadPalettes(BENCH_PALETTES_PATH);
+
+	// Two triangles covering the viewport
+
+	const GLfloat vertices[] = {
+		-1.0f,  1.0f, 0.0f,  -1.0f, -1.0f, 0.0f,   1.0f, -1.0f, 0.0f,
+		 1.0f, -1.0f, 0.0f,   1.0f,  1.0f, 0.0f,  -1.0f,  1.0f, 0.0f
+	};
+
+	glGenVertexArrays(1, &VAO);
+	glBindVertexArray(VAO);
+	glGenBuffers(1, &VBO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
+	glEnableVertexAttribArray(0);
+
+	glGenBuffers(1, &cdfSSBO);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, cdfSSBO);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, BENCH_CDF_SIZE, nullptr, GL_STATIC_DRAW);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, cdfSSBO);
+
+	glGenFramebuffers(1, &framebuffer);
+	glGenRenderbuffers(1, &renderbuffer);
+}
+
+
+GpuKernel::~GpuKernel() {
+	if (context == nullptr)
+		return;
+
+	glDeleteRenderbuffers(1, &renderbuffer);
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteBuffers(1, &cdfSSBO);
+	glDeleteBuffers(1, &VBO);
+	glDeleteVertexArrays(1, &VAO);
+	delete pixelState;
+	delete program;
+	palettes.clear();
+
+	glfwDestroyWindow(context);
+	glfwTerminate();
+}
+
+
+bool GpuKernel::isAvailable() const {
+	return context != nullptr && program->getID() != 0 && !palettes.empty();
+}
+
+
+double GpuKernel::render(const viewState& view, const bool& detectInterior) {
+	if (view.width != width || view.height != height) {
+		width = view.width;
+		height = view.height;
+
+		glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffer);
+		glViewport(0, 0, width, height);
+		pixelState->resize(width, height);
+	}
+	else
+		pixelState->reset();
+
+	program->use();
+	program->setValues(width, height, view.off.x, view.off.y, view.zoom, view.maxIterations);
+	// No bound per frame, the iterations and the Newton passes of the interior checks all fit in the single draw
+	program->setUInt("iterationsPerFrame", UINT32_MAX);
+	program->setUInt("interiorDetection", detectInterior ? 1 : 0);
+	palettes.front()->bind(0);
+	program->setColoring(0, DEFAULT_PALETTE_CYCLE, 0);
+	glBindVertexArray(VAO);
+	glFinish();
+
+	auto start = std::chrono::steady_clock::now();
+	glDrawArrays(GL_TRIANGLES, 0, 6);
+	glFinish();
+
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+void GpuKernel::readIterations(std::vector<uint32_t>& iterations, std::vector<bool>* escaped) {
+	std::vector<unsigned char> states((size_t)width * height * PIXEL_STATE_SIZE);
+
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, pixelState->getID());
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, (GLsizeiptr)states.size(), states.data());
+
+	// The pixel states are stored from the bottom row up
+
+	iterations.resize((size_t)width * height);
+	if (escaped != nullptr)
+		escaped->resize(iterations.size());
+
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			const unsigned char* state = states.data() + ((size_t)y * width + x) * PIXEL_STATE_SIZE;
+			size_t pixel = (size_t)(height - 1 - y) * width + x;
+			std::copy(state + PIXEL_STATE_ITERATION_OFFSET, state + PIXEL_STATE_ITERATION_OFFSET + 4, (unsigned char*)&iterations[pixel]);
+
+			if (escaped != nullptr) {
+				uint32_t flag;
+				std::copy(state + PIXEL_STATE_ESCAPED_OFFSET, state + PIXEL_STATE_ESCAPED_OFFSET + 4, (unsigned char*)&flag);
+				(*escaped)[pixel] = flag != 0;
+			}
+		}
+	}
+}
+
+
+std::vector<std::string> splitList(const std::string& list) {
+	std::vector<std::string> items;
+	size_t start = 0;
+
+	while (start <= list.size()) {
+		size_t end = std::min(list.find(',', start), list.size());
+		if (end > start)
+			items.push_back(list.substr(start, end - start));
+		start = end + 1;
+	}
+
+	return items;
+}
+
+
+bool contains(const std::vector<std::string>& items, const std::string& item) {
+	return std::find(items.begin(), items.end(), item) != items.end();
+}
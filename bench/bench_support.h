@@ -0,0 +1,88 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include "helpers.h"
+#include "shader.h"
+#include "pixel_state.h"
+#include "palette.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+
+// Views, resolutions and the GPU kernel shared by mandel_bench and mandel_golden
+// Both are run from the repository root, the GPU kernel uses the shaders and palettes of the interactive renderer
+
+
+// Set the paths to the shaders and palettes
+extern const char* BENCH_VERTEX_SHADER_PATH;
+extern const char* BENCH_FRAGMENT_SHADER_PATH;
+extern const char* BENCH_PALETTES_PATH;
+
+
+// A view of the catalogue and the iteration counts it is run with
+
+struct benchView {
+	const char* name;
+	coord center;
+	double zoom;
+	std::vector<int> iterations;
+};
+
+extern const std::vector<benchView> BENCH_VIEWS;
+
+struct benchResolution {
+	int width, height;
+};
+
+extern const std::vector<benchResolution> BENCH_RESOLUTIONS;
+
+
+// Renders views with the fragment shader of the interactive renderer into an offscreen framebuffer,
+// with enough iterations per frame that a single draw finishes every pixel
+
+class GpuKernel {
+private:
+
+	GLFWwindow* context;
+	Shader* program;
+	PixelStateBuffer* pixelState;
+	std::vector<std::unique_ptr<Palette>> palettes;
+	GLuint VAO, VBO, cdfSSBO, framebuffer, renderbuffer;
+	int width, height;
+
+public:
+
+	// Constructor that creates a headless context, check isAvailable before rendering
+
+	GpuKernel();
+
+	// Destructor
+
+	~GpuKernel();
+
+	GpuKernel(const GpuKernel&) = delete;
+	GpuKernel& operator=(const GpuKernel&) = delete;
+
+	bool isAvailable() const;
+
+	// Seconds taken by one complete render of the view, the pixel states are reset outside of the measured time
+	// With detectInterior the pixels proven to be inside the set stop early, like in the interactive renderer
+
+	double render(const viewState& view, const bool& detectInterior = false);
+
+	// Iteration count of every pixel of the last render, rows from top to bottom like the CPU kernels
+	// The escaped flags are read too if escaped is not null, with interior detection they tell the interior pixels apart
+
+	void readIterations(std::vector<uint32_t>& iterations, std::vector<bool>* escaped = nullptr);
+};
+
+
+// Split a comma separated list
+
+std::vector<std::string> splitList(const std::string& list);
+
+bool contains(const std::vector<std::string>& items, const std::string& item);
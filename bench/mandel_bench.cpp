@@ -0,0 +1,208 @@
+#include "bench_support.h"
+#include "mandelbrot.h"
+#include "json_writer.h"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <cmath>
+
+
+// Renders a fixed catalogue of views with every available kernel and reports the throughput as JSON
+// Run it from the repository root, the GPU kernel uses the shaders and palettes of the interactive renderer
+//
+// mandel_bench [--repeats N] [--views name,...] [--kernels scalar,threaded,interior,gpu,gpu-interior] [--threads N] [--quick] [--output file]
+// The interior kernels stop the pixels proven to be inside the set early, so they report fewer iterations for the same image
+
+
+// Number of timed runs of every combination, after one untimed warm up run
+constexpr int BENCH_REPEATS = 5;
+
+
+int main(int argc, char** argv) {
+	std::vector<std::string> args(argv + 1, argv + argc);
+	auto option = [&](const std::string& name, std::string& value) {
+		auto found = std::find(args.begin(), args.end(), name);
+		if (found == args.end() || found + 1 == args.end())
+			return false;
+		value = *(found + 1);
+		return true;
+	};
+
+	int repeats = BENCH_REPEATS;
+	unsigned threads = std::max(std::thread::hardware_concurrency(), 1u);
+	std::vector<std::string> views, kernels = { "scalar", "threaded", "interior", "gpu", "gpu-interior" };
+	std::string value, outputPath;
+
+	try {
+		if (option("--repeats", value)) repeats = std::stoi(value);
+		if (option("--threads", value)) threads = (unsigned)std::stoul(value);
+	}
+	catch (const std::exception&) {
+		std::cerr << "ERROR:INVALID_OPTION_VALUE " << value << '\n';
+		return -1;
+	}
+	if (option("--views", value))
+		views = splitList(value);
+	if (option("--kernels", value))
+		kernels = splitList(value);
+	option("--output", outputPath);
+	bool quick = std::find(args.begin(), args.end(), "--quick") != args.end();
+
+	if (repeats <= 0 || threads == 0) {
+		std::cerr << "ERROR:INVALID_OPTION_VALUE\n";
+		return -1;
+	}
+
+	// Only the kernels that exist in this build are run, a GPU without double precision shaders simply has no GPU kernel
+
+	GpuKernel* gpu = nullptr;
+	if (contains(kernels, "gpu") || contains(kernels, "gpu-interior")) {
+		gpu = new GpuKernel();
+		if (!gpu->isAvailable()) {
+			std::cerr << "The GPU kernel is not available, skipping it\n";
+			delete gpu;
+			gpu = nullptr;
+		}
+	}
+
+	std::ofstream file;
+	if (!outputPath.empty()) {
+		file.open(outputPath);
+		if (!file) {
+			std::cerr << "ERROR:REPORT_COULD_NOT_BE_WRITTEN " << outputPath << '\n';
+			delete gpu;
+			return 1;
+		}
+	}
+	std::ostream& out = outputPath.empty() ? std::cout : file;
+
+	JsonWriter json(out);
+	json.beginObject();
+	json.key("threads");
+	json.value(threads);
+	json.key("repeats");
+	json.value(repeats);
+	json.key("gpu");
+	if (gpu != nullptr)
+		json.value((const char*)glGetString(GL_RENDERER));
+	else
+		json.null();
+
+	json.key("results");
+	json.beginArray();
+
+	for (const benchView& catalogueView : BENCH_VIEWS) {
+		if (!views.empty() && !contains(views, catalogueView.name))
+			continue;
+
+		for (const benchResolution& resolution : BENCH_RESOLUTIONS) {
+			for (int iterations : catalogueView.iterations) {
+				viewState view{ catalogueView.center, catalogueView.zoom, iterations, resolution.width, resolution.height };
+
+				std::vector<pixelEscape> escapes;
+				std::vector<uint32_t> gpuIterations;
+
+				// Iterations done by the last render of a kernel, with interior detection the interior pixels count the iterations
+				// before their cycle was found
+
+				auto countIterations = [&](const std::string& kernel) {
+					uint64_t total = 0;
+					if (kernel == "gpu" || kernel == "gpu-interior") {
+						gpu->readIterations(gpuIterations);
+						for (uint32_t iteration : gpuIterations)
+							total += iteration;
+					}
+					else
+						for (const pixelEscape& escape : escapes)
+							total += escape.iteration;
+					return total;
+				};
+
+				std::vector<std::pair<std::string, std::function<double()>>> runs;
+				auto timeCpu = [&](const unsigned& kernelThreads, const bool& detectInterior) {
+					auto start = std::chrono::steady_clock::now();
+					renderEscapes(view, escapes, kernelThreads, detectInterior);
+					return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				};
+
+				if (contains(kernels, "scalar"))
+					runs.push_back({ "scalar", [&]() { return timeCpu(1, false); } });
+				if (contains(kernels, "threaded"))
+					runs.push_back({ "threaded", [&]() { return timeCpu(threads, false); } });
+				if (contains(kernels, "interior"))
+					runs.push_back({ "interior", [&]() { return timeCpu(threads, true); } });
+				if (gpu != nullptr && contains(kernels, "gpu"))
+					runs.push_back({ "gpu", [&]() { return gpu->render(view); } });
+				if (gpu != nullptr && contains(kernels, "gpu-interior"))
+					runs.push_back({ "gpu-interior", [&]() { return gpu->render(view, true); } });
+
+				for (auto& [kernel, run] : runs) {
+					std::cerr << catalogueView.name << ' ' << resolution.width << 'x' << resolution.height << ' ' << iterations
+						<< " iterations, " << kernel << '\n';
+
+					run();
+					uint64_t totalIterations = countIterations(kernel);
+
+					std::vector<double> seconds;
+					for (int i = 0; i < repeats; ++i)
+						seconds.push_back(run());
+
+					// Throughput of every run, so that the variance describes the rate and not the time
+
+					double pixels = (double)view.width * view.height, meanRate = 0.0, variance = 0.0, meanSeconds = 0.0;
+					for (double time : seconds) {
+						meanRate += pixels / time / 1e6 / repeats;
+						meanSeconds += time / repeats;
+					}
+					for (double time : seconds)
+						variance += std::pow(pixels / time / 1e6 - meanRate, 2) / std::max(repeats - 1, 1);
+
+					json.beginObject();
+					json.key("view");
+					json.value(catalogueView.name);
+					json.key("kernel");
+					json.value(kernel);
+					json.key("width");
+					json.value(view.width);
+					json.key("height");
+					json.value(view.height);
+					json.key("max_iterations");
+					json.value(iterations);
+					json.key("iterations");
+					json.value(totalIterations);
+					json.key("seconds_mean");
+					json.value(meanSeconds);
+					json.key("seconds_min");
+					json.value(*std::min_element(seconds.begin(), seconds.end()));
+					json.key("mpixels_per_second");
+					json.value(meanRate);
+					json.key("mpixels_per_second_variance");
+					json.value(variance);
+					json.key("iterations_per_second");
+					json.value(totalIterations / meanSeconds);
+					json.endObject();
+				}
+
+				if (quick)
+					break;
+			}
+
+			if (quick)
+				break;
+		}
+	}
+
+	json.endArray();
+	json.endObject();
+	out << '\n';
+
+	delete gpu;
+
+	return 0;
+}
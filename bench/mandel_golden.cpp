@@ -0,0 +1,376 @@
+#include "bench_support.h"
+#include "mandelbrot.h"
+
+#include <zlib.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <cstring>
+
+
+// Renders the views of the benchmark catalogue with every available kernel and compares the iteration count of
+// every pixel against the stored golden images, and with --timing compares the timings against a baseline of this machine
+// Exits with 1 if any kernel differs from the goldens beyond the tolerance or got slower than allowed
+// Run it from the repository root, headless like mandel_bench
+//
+// mandel_golden [--record] [--timing] [--record-baseline] [--directory D] [--views name,...]
+//               [--kernels scalar,threaded,interior,gpu,gpu-interior] [--threads N] [--repeats N] [--pixel-tolerance F]
+//               [--iteration-tolerance N] [--slowdown F]
+//
+// --pixel-tolerance replaces the fraction of differing pixels allowed for every kernel, the escaped pixels of the interior
+// kernels and the pixels they stop as interior are checked without tolerance
+//
+// --record writes the goldens from the scalar kernel, --record-baseline writes the timings of this run as the baseline
+// Timings are only measured with --timing or --record-baseline, they are too noisy for the default test
+
+
+// Directory of the goldens (one file per view) and name of the timing baseline inside it
+const char* GOLDEN_DIRECTORY = "./bench/golden";
+const char* GOLDEN_BASELINE_FILE = "baseline.txt";
+
+constexpr char GOLDEN_MAGIC[8] = { 'M', 'B', 'G', 'O', 'L', 'D', '\0', '\0' };
+constexpr uint32_t GOLDEN_VERSION = 2;
+
+// Timed runs of every combination, their median is compared against the baseline
+constexpr int GOLDEN_REPEATS = 9;
+
+// Pixels may differ by this many iterations, and a fraction of the pixels (per kernel) may differ by more
+// Pixels next to the boundary are chaotic, the last bit of a multiplication can change their escape: the CPU kernels
+// run the same code as the goldens, but the GPU computes the coordinates in another order and may fuse multiply-adds
+constexpr uint32_t GOLDEN_ITERATION_TOLERANCE = 0;
+constexpr double GOLDEN_CPU_PIXEL_TOLERANCE = 0.001;
+constexpr double GOLDEN_GPU_PIXEL_TOLERANCE = 0.05;
+
+// Allowed slowdown against the baseline (0.25 = 25% slower), renders faster than the minimum are too noisy to compare
+constexpr double GOLDEN_SLOWDOWN = 0.25;
+constexpr double GOLDEN_MIN_TIMED_SECONDS = 0.05;
+
+
+// Header of a golden file, followed by the zlib compressed iteration counts (32-bit, rows from top to bottom) and escaped
+// flags (one byte per pixel): a pixel can escape at the last iteration, so the count alone does not tell
+
+struct goldenHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t width, height, maxIterations;
+	double x, y, zoom;
+};
+
+
+static std::string goldenPath(const std::string& directory, const benchView& view) {
+	return (std::filesystem::path(directory) / (std::string(view.name) + ".mbgold")).string();
+}
+
+
+static goldenHeader makeHeader(const viewState& view) {
+	goldenHeader header{};
+	std::memcpy(header.magic, GOLDEN_MAGIC, sizeof(GOLDEN_MAGIC));
+	header.version = GOLDEN_VERSION;
+	header.width = (uint32_t)view.width;
+	header.height = (uint32_t)view.height;
+	header.maxIterations = (uint32_t)view.maxIterations;
+	header.x = view.off.x;
+	header.y = view.off.y;
+	header.zoom = view.zoom;
+	return header;
+}
+
+
+static bool writeGolden(const std::string& path, const viewState& view, const std::vector<uint32_t>& iterations, const std::vector<unsigned char>& escaped) {
+	std::vector<unsigned char> data(iterations.size() * sizeof(uint32_t));
+	std::memcpy(data.data(), iterations.data(), data.size());
+	data.insert(data.end(), escaped.begin(), escaped.end());
+
+	uLongf compressedSize = compressBound((uLong)data.size());
+	std::vector<unsigned char> compressed(compressedSize);
+	if (compress2(compressed.data(), &compressedSize, data.data(), (uLong)data.size(), 9) != Z_OK)
+		return false;
+
+	goldenHeader header = makeHeader(view);
+	std::ofstream out(path, std::ios::binary);
+	out.write((const char*)&header, sizeof(header));
+	out.write((const char*)compressed.data(), compressedSize);
+	return (bool)out;
+}
+
+
+// Read the golden of the view, reports an error and returns false if it is missing or was recorded for other settings
+
+static bool readGolden(const std::string& path, const viewState& view, std::vector<uint32_t>& iterations, std::vector<unsigned char>& escaped) {
+	std::ifstream in(path, std::ios::binary);
+	if (!in) {
+		std::cout << "ERROR:GOLDEN_NOT_FOUND " << path << '\n';
+		return false;
+	}
+
+	goldenHeader header{}, expected = makeHeader(view);
+	in.read((char*)&header, sizeof(header));
+	if (!in || std::memcmp(&header, &expected, sizeof(header)) != 0) {
+		std::cout << "ERROR:GOLDEN_OUTDATED " << path << '\n';
+		return false;
+	}
+
+	std::vector<unsigned char> compressed((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	size_t pixels = (size_t)view.width * view.height;
+	std::vector<unsigned char> data(pixels * (sizeof(uint32_t) + 1));
+	uLongf size = (uLongf)data.size();
+	if (uncompress(data.data(), &size, compressed.data(), (uLong)compressed.size()) != Z_OK || size != data.size()) {
+		std::cout << "ERROR:GOLDEN_CORRUPTED " << path << '\n';
+		return false;
+	}
+
+	iterations.resize(pixels);
+	std::memcpy(iterations.data(), data.data(), pixels * sizeof(uint32_t));
+	escaped.assign(data.begin() + pixels * sizeof(uint32_t), data.end());
+	return true;
+}
+
+
+// Baseline: one "<view> <kernel> <seconds>" line per combination
+
+static std::map<std::string, double> readBaseline(const std::string& path) {
+	std::map<std::string, double> baseline;
+	std::ifstream in(path);
+	std::string line;
+
+	while (std::getline(in, line)) {
+		std::istringstream fields(line);
+		std::string view, kernel;
+		double seconds;
+		if (line.empty() || line[0] == '#' || !(fields >> view >> kernel >> seconds))
+			continue;
+		baseline[view + ' ' + kernel] = seconds;
+	}
+
+	return baseline;
+}
+
+
+int main(int argc, char** argv) {
+	std::vector<std::string> args(argv + 1, argv + argc);
+	auto option = [&](const std::string& name, std::string& value) {
+		auto found = std::find(args.begin(), args.end(), name);
+		if (found == args.end() || found + 1 == args.end())
+			return false;
+		value = *(found + 1);
+		return true;
+	};
+	auto flag = [&](const std::string& name) {
+		return std::find(args.begin(), args.end(), name) != args.end();
+	};
+
+	int repeats = GOLDEN_REPEATS;
+	unsigned threads = std::max(std::thread::hardware_concurrency(), 1u);
+	uint32_t iterationTolerance = GOLDEN_ITERATION_TOLERANCE;
+	double pixelTolerance = -1.0, slowdown = GOLDEN_SLOWDOWN; // Negative: the tolerance of each kernel
+	std::vector<std::string> views, kernels = { "scalar", "threaded", "interior", "gpu", "gpu-interior" };
+	std::string value, directory = GOLDEN_DIRECTORY;
+
+	try {
+		if (option("--repeats", value)) repeats = std::stoi(value);
+		if (option("--threads", value)) threads = (unsigned)std::stoul(value);
+		if (option("--iteration-tolerance", value)) iterationTolerance = (uint32_t)std::stoul(value);
+		if (option("--pixel-tolerance", value)) pixelTolerance = std::stod(value);
+		if (option("--slowdown", value)) slowdown = std::stod(value);
+	}
+	catch (const std::exception&) {
+		std::cerr << "ERROR:INVALID_OPTION_VALUE " << value << '\n';
+		return -1;
+	}
+	if (option("--views", value))
+		views = splitList(value);
+	if (option("--kernels", value))
+		kernels = splitList(value);
+	option("--directory", directory);
+	bool record = flag("--record"), recordBaseline = flag("--record-baseline"), timing = flag("--timing") || recordBaseline;
+
+	if (repeats <= 0 || threads == 0 || slowdown < 0.0 || (flag("--pixel-tolerance") && pixelTolerance < 0.0)) {
+		std::cerr << "ERROR:INVALID_OPTION_VALUE\n";
+		return -1;
+	}
+
+	GpuKernel* gpu = nullptr;
+	if (contains(kernels, "gpu") || contains(kernels, "gpu-interior")) {
+		gpu = new GpuKernel();
+		if (!gpu->isAvailable()) {
+			std::cerr << "The GPU kernel is not available, skipping it\n";
+			delete gpu;
+			gpu = nullptr;
+		}
+	}
+
+	std::string baselinePath = (std::filesystem::path(directory) / GOLDEN_BASELINE_FILE).string();
+	std::map<std::string, double> baseline = readBaseline(baselinePath), measured;
+	if (timing && baseline.empty() && !recordBaseline)
+		std::cout << "No timing baseline in " << baselinePath << ", only the images are compared (record one with --record-baseline)\n";
+
+	int checks = 0, failures = 0;
+
+	// Every view of the catalogue at the smaller resolution and the lower iteration count
+
+	for (const benchView& catalogueView : BENCH_VIEWS) {
+		if (!views.empty() && !contains(views, catalogueView.name))
+			continue;
+
+		viewState view{ catalogueView.center, catalogueView.zoom, catalogueView.iterations.front(),
+			BENCH_RESOLUTIONS.front().width, BENCH_RESOLUTIONS.front().height };
+		std::string path = goldenPath(directory, catalogueView);
+		std::vector<pixelEscape> escapes;
+		std::vector<uint32_t> golden, iterations;
+		std::vector<unsigned char> goldenEscaped;
+		std::vector<bool> escaped;
+
+		// The scalar kernel is the reference
+
+		if (record) {
+			renderEscapes(view, escapes, 1);
+			golden.resize(escapes.size());
+			goldenEscaped.resize(escapes.size());
+			std::transform(escapes.begin(), escapes.end(), golden.begin(), [](const pixelEscape& escape) { return escape.iteration; });
+			std::transform(escapes.begin(), escapes.end(), goldenEscaped.begin(), [](const pixelEscape& escape) { return (unsigned char)escape.escaped; });
+
+			std::filesystem::create_directories(directory);
+			if (!writeGolden(path, view, golden, goldenEscaped)) {
+				std::cout << "ERROR:GOLDEN_COULD_NOT_BE_WRITTEN " << path << '\n';
+				delete gpu;
+				return 1;
+			}
+			std::cout << "Recorded " << path << '\n';
+		}
+		else if (!readGolden(path, view, golden, goldenEscaped)) {
+			++checks;
+			++failures;
+			continue;
+		}
+
+		// Each kernel returns the time of a render and leaves its iteration counts and escaped flags in iterations and escaped
+
+		auto runCpu = [&](const unsigned& kernelThreads, const bool& detectInterior) {
+			auto start = std::chrono::steady_clock::now();
+			renderEscapes(view, escapes, kernelThreads, detectInterior);
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			iterations.resize(escapes.size());
+			escaped.resize(escapes.size());
+			std::transform(escapes.begin(), escapes.end(), iterations.begin(), [](const pixelEscape& escape) { return escape.iteration; });
+			std::transform(escapes.begin(), escapes.end(), escaped.begin(), [](const pixelEscape& escape) { return escape.escaped; });
+			return seconds;
+		};
+		auto runGpu = [&](const bool& detectInterior) {
+			double seconds = gpu->render(view, detectInterior);
+			gpu->readIterations(iterations, &escaped);
+			return seconds;
+		};
+
+		std::vector<std::pair<std::string, std::function<double()>>> runs;
+		if (contains(kernels, "scalar"))
+			runs.push_back({ "scalar", [&]() { return runCpu(1, false); } });
+		if (contains(kernels, "threaded"))
+			runs.push_back({ "threaded", [&]() { return runCpu(threads, false); } });
+		if (contains(kernels, "interior"))
+			runs.push_back({ "interior", [&]() { return runCpu(threads, true); } });
+		if (gpu != nullptr && contains(kernels, "gpu"))
+			runs.push_back({ "gpu", [&]() { return runGpu(false); } });
+		if (gpu != nullptr && contains(kernels, "gpu-interior"))
+			runs.push_back({ "gpu-interior", [&]() { return runGpu(true); } });
+
+		for (auto& [kernel, run] : runs) {
+			++checks;
+
+			// The interior kernels must escape exactly where the same kernel without interior detection does, at the same
+			// iteration: the goldens for the CPU, a render without it for the GPU, whose chaotic pixels differ from the goldens
+
+			bool interior = kernel == "interior" || kernel == "gpu-interior", onGpu = kernel == "gpu" || kernel == "gpu-interior";
+			std::vector<uint32_t> referenceIterations(golden);
+			std::vector<bool> referenceEscaped(goldenEscaped.begin(), goldenEscaped.end());
+			if (kernel == "gpu-interior") {
+				runGpu(false);
+				referenceIterations = iterations;
+				referenceEscaped = escaped;
+			}
+
+			// Pixels, the pixels stopped as interior are not compared by iteration count but must not escape in the golden
+
+			run();
+			size_t differing = 0, escapesDiffering = 0, falseInterior = 0;
+			uint32_t maxDifference = 0;
+			for (size_t i = 0; i < golden.size(); ++i) {
+				bool stoppedInside = interior && !escaped[i] && iterations[i] < (uint32_t)view.maxIterations;
+				if (stoppedInside) {
+					if (goldenEscaped[i])
+						++falseInterior;
+					continue;
+				}
+
+				if (interior && (escaped[i] != referenceEscaped[i] || (escaped[i] && iterations[i] != referenceIterations[i])))
+					++escapesDiffering;
+
+				uint32_t difference = (golden[i] > iterations[i]) ? golden[i] - iterations[i] : iterations[i] - golden[i];
+				maxDifference = std::max(maxDifference, difference);
+				if (difference > iterationTolerance)
+					++differing;
+			}
+			double allowed = (pixelTolerance >= 0.0) ? pixelTolerance : onGpu ? GOLDEN_GPU_PIXEL_TOLERANCE : GOLDEN_CPU_PIXEL_TOLERANCE;
+			bool pixelsPass = differing <= allowed * golden.size() && escapesDiffering == 0 && falseInterior == 0;
+
+			std::cout << (pixelsPass ? "ok   " : "FAIL ") << catalogueView.name << ' ' << kernel << ": "
+				<< differing << " of " << golden.size() << " pixels differ (at most " << maxDifference << " iterations)";
+			if (interior)
+				std::cout << ", " << escapesDiffering << " escape differently than without interior detection, "
+					<< falseInterior << " stopped as interior escape in the golden";
+			std::cout << '\n';
+
+			// Timing, the median resists the odd slow run that the fastest or the mean would let through or fail on
+
+			bool timingPass = true;
+			if (timing) {
+				std::vector<double> times;
+				for (int i = 0; i < repeats; ++i)
+					times.push_back(run());
+				std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+				double seconds = times[times.size() / 2];
+
+				std::string key = std::string(catalogueView.name) + ' ' + kernel;
+				measured[key] = seconds;
+				auto reference = baseline.find(key);
+				timingPass = reference == baseline.end() || reference->second < GOLDEN_MIN_TIMED_SECONDS || seconds <= reference->second * (1.0 + slowdown);
+
+				std::cout << (timingPass ? "ok   " : "FAIL ") << catalogueView.name << ' ' << kernel << " timing: " << seconds << " s";
+				if (reference != baseline.end())
+					std::cout << " against " << reference->second << " s (" << (seconds / reference->second - 1.0) * 100.0 << "%)";
+				std::cout << '\n';
+			}
+
+			if (!pixelsPass || !timingPass)
+				++failures;
+		}
+	}
+
+	delete gpu;
+
+	if (recordBaseline) {
+		std::filesystem::create_directories(directory);
+		std::ofstream out(baselinePath);
+		out << "# view kernel seconds, median of " << repeats << " runs on the machine that recorded it\n";
+		for (const auto& [key, seconds] : measured)
+			out << key << ' ' << seconds << '\n';
+		if (!out) {
+			std::cout << "ERROR:BASELINE_COULD_NOT_BE_WRITTEN " << baselinePath << '\n';
+			return 1;
+		}
+		std::cout << "Recorded " << baselinePath << '\n';
+	}
+
+	std::cout << checks - failures << " of " << checks << " checks passed\n";
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,213 @@
+#include "png_writer.h"
+
+#include <zlib.h>
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+
+
+// Writes PNG files with PngWriter, whole and resumed after a flush, reads them back and checks the CRC of every chunk,
+// the order of the chunks and the decoded pixels, as a strict decoder (libpng, pngcheck) would
+// Exits with 1 on any failure
+//
+// png_check [--directory D]
+
+
+constexpr uint32_t CHECK_WIDTH = 301;
+constexpr uint32_t CHECK_HEIGHT = 97;
+
+
+static uint32_t loadBigEndian(const unsigned char* source) {
+	return (uint32_t)source[0] << 24 | (uint32_t)source[1] << 16 | (uint32_t)source[2] << 8 | source[3];
+}
+
+
+// Deterministic test image with smooth areas and noise, so that the compressor emits several kinds of blocks
+
+static std::vector<unsigned char> makeImage() {
+	std::vector<unsigned char> rgb((size_t)CHECK_WIDTH * CHECK_HEIGHT * 3);
+	uint32_t state = 12345;
+
+	for (uint32_t y = 0; y < CHECK_HEIGHT; ++y)
+		for (uint32_t x = 0; x < CHECK_WIDTH; ++x) {
+			unsigned char* pixel = &rgb[((size_t)y * CHECK_WIDTH + x) * 3];
+			state = state * 1664525 + 1013904223;
+			pixel[0] = (unsigned char)(x * 255 / CHECK_WIDTH);
+			pixel[1] = (unsigned char)(y * 255 / CHECK_HEIGHT);
+			pixel[2] = (x / 16 + y / 16) % 2 ? (unsigned char)(state >> 24) : 0;
+		}
+
+	return rgb;
+}
+
+
+// Undo the filter of every scanline into rgb, returns false on an unknown filter type
+
+static bool unfilterRows(std::vector<unsigned char>& data, const uint32_t& width, const uint32_t& height, std::vector<unsigned char>& rgb) {
+	const size_t rowSize = (size_t)width * 3;
+	rgb.assign(rowSize * height, 0);
+
+	for (uint32_t y = 0; y < height; ++y) {
+		const unsigned char* filtered = &data[y * (rowSize + 1)];
+		unsigned char* row = &rgb[y * rowSize];
+		const unsigned char* previous = y > 0 ? row - rowSize : nullptr;
+
+		for (size_t i = 0; i < rowSize; ++i) {
+			int left = i >= 3 ? row[i - 3] : 0;
+			int up = previous != nullptr ? previous[i] : 0;
+			int upLeft = previous != nullptr && i >= 3 ? previous[i - 3] : 0;
+
+			int predictor;
+			switch (filtered[0]) {
+			case 0: predictor = 0; break;
+			case 1: predictor = left; break;
+			case 2: predictor = up; break;
+			case 3: predictor = (left + up) / 2; break;
+			case 4: {
+				int estimate = left + up - upLeft;
+				int distanceLeft = std::abs(estimate - left), distanceUp = std::abs(estimate - up), distanceUpLeft = std::abs(estimate - upLeft);
+				predictor = (distanceLeft <= distanceUp && distanceLeft <= distanceUpLeft) ? left : (distanceUp <= distanceUpLeft ? up : upLeft);
+				break;
+			}
+			default: return false;
+			}
+
+			row[i] = (unsigned char)(filtered[1 + i] + predictor);
+		}
+	}
+
+	return true;
+}
+
+
+// Read a PNG file written by PngWriter and compare its pixels to rgb, prints the first problem found
+
+static bool checkPng(const std::string& path, const std::vector<unsigned char>& rgb) {
+	std::ifstream in(path, std::ios::binary);
+	std::vector<unsigned char> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+	const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	if (file.size() < 8 || std::memcmp(file.data(), signature, 8) != 0) {
+		std::cout << "FAIL " << path << ": missing PNG signature\n";
+		return false;
+	}
+
+	uint32_t width = 0, height = 0;
+	std::vector<unsigned char> compressed;
+	std::vector<std::string> types;
+	size_t position = 8;
+
+	while (position + 12 <= file.size()) {
+		uint32_t length = loadBigEndian(&file[position]);
+		if (position + 12 + (size_t)length > file.size()) {
+			std::cout << "FAIL " << path << ": chunk at " << position << " runs past the end of the file\n";
+			return false;
+		}
+
+		const unsigned char* type = &file[position + 4];
+		const unsigned char* data = type + 4;
+		std::string name((const char*)type, 4);
+		types.push_back(name);
+
+		// The CRC covers the type and the data
+		uLong crc = crc32(crc32(0L, type, 4), data, length);
+		uint32_t stored = loadBigEndian(data + length);
+		if (stored != (uint32_t)crc) {
+			std::cout << "FAIL " << path << ": " << name << " chunk at " << position << " has CRC " << std::hex << stored
+				<< " instead of " << crc << std::dec << '\n';
+			return false;
+		}
+
+		if (name == "IHDR" && length == 13) {
+			width = loadBigEndian(data);
+			height = loadBigEndian(data + 4);
+		}
+		else if (name == "IDAT")
+			compressed.insert(compressed.end(), data, data + length);
+
+		position += 12 + (size_t)length;
+	}
+
+	if (position != file.size() || types.size() < 3 || types.front() != "IHDR" || types.back() != "IEND") {
+		std::cout << "FAIL " << path << ": the file does not start with IHDR and end with IEND\n";
+		return false;
+	}
+
+	if (width != CHECK_WIDTH || height != CHECK_HEIGHT) {
+		std::cout << "FAIL " << path << ": size " << width << " x " << height << '\n';
+		return false;
+	}
+
+	// uncompress also checks the zlib header and the Adler-32 checksum of the filtered rows
+
+	std::vector<unsigned char> filtered(((size_t)width * 3 + 1) * height);
+	uLongf filteredSize = (uLongf)filtered.size();
+	std::vector<unsigned char> decoded;
+	if (uncompress(filtered.data(), &filteredSize, compressed.data(), (uLong)compressed.size()) != Z_OK || filteredSize != filtered.size()
+		|| !unfilterRows(filtered, width, height, decoded)) {
+		std::cout << "FAIL " << path << ": the image data does not decompress\n";
+		return false;
+	}
+
+	if (decoded != rgb) {
+		std::cout << "FAIL " << path << ": the pixels differ from the image written\n";
+		return false;
+	}
+
+	std::cout << "ok   " << path << ": " << types.size() << " chunks\n";
+	return true;
+}
+
+
+int main(int argc, char* argv[]) {
+	std::string directory = std::filesystem::temp_directory_path().string();
+
+	for (int i = 1; i < argc; ++i) {
+		std::string argument = argv[i];
+		if (argument == "--directory" && i + 1 < argc)
+			directory = argv[++i];
+		else {
+			std::cout << "ERROR:INVALID_ARGUMENT " << argument << '\n';
+			return 1;
+		}
+	}
+
+	std::vector<unsigned char> rgb = makeImage();
+	const size_t rowSize = (size_t)CHECK_WIDTH * 3;
+	bool passed = true;
+
+	// Whole image at once
+
+	std::string wholePath = directory + "/png_check_whole.png";
+	passed &= writePng(wholePath.c_str(), rgb.data(), CHECK_WIDTH, CHECK_HEIGHT) && checkPng(wholePath, rgb);
+
+	// Written in two parts: the first writer flushes and is abandoned, a second one continues from the resume point
+
+	std::string resumedPath = directory + "/png_check_resumed.png";
+	pngResumePoint resumePoint{};
+	bool flushed;
+	{
+		PngWriter writer(resumedPath.c_str(), CHECK_WIDTH, CHECK_HEIGHT, 1);
+		writer.writeRows(rgb.data(), CHECK_HEIGHT / 2);
+		flushed = writer.flush(resumePoint);
+		writer.writeRows(rgb.data() + (CHECK_HEIGHT / 2) * rowSize, 3);
+	}
+
+	if (flushed) {
+		PngWriter writer(resumedPath.c_str(), CHECK_WIDTH, CHECK_HEIGHT, 1, resumePoint);
+		writer.writeRows(rgb.data() + (size_t)resumePoint.rowsWritten * rowSize, CHECK_HEIGHT - resumePoint.rowsWritten);
+		flushed = writer.finish();
+	}
+	passed &= flushed && checkPng(resumedPath, rgb);
+
+	std::filesystem::remove(wholePath);
+	std::filesystem::remove(resumedPath);
+
+	std::cout << (passed ? "PNG files are valid\n" : "PNG files are invalid\n");
+	return passed ? 0 : 1;
+}
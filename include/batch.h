@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "helpers.h"
+
+
+// One view of a job file: center, zoom, iteration count, resolution, palette and output image
+// A job file has one job per line, fields separated by whitespace, lines starting with '#' are comments:
+// x y zoom maxIterations width height palette output.png [paletteCycle]
+
+struct batchJob {
+	int line;
+	viewState view;
+	std::string palette;
+	std::string output;
+	float paletteCycle;
+};
+
+
+// Read the jobs of a job file, invalid lines are reported and skipped
+
+bool readBatchJobs(const char* path, std::vector<batchJob>& jobs);
+
+// Render every job of a job file headlessly into image files and write a manifest with the timings
+
+int runBatch(const std::vector<std::string>& args);
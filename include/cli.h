@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+
+// Command line modes that run without opening the window
+// Returns true if the arguments selected such a mode, exitCode then holds the result of the mode
+
+bool runCommandLineMode(int argc, char** argv, int& exitCode);
+
+// Path the program was started with (argv[0]), for modes that start more processes of it
+
+const std::string& getExecutablePath();
+
+// Options given before the mode, empty if absent
+
+struct globalOptions {
+	std::string tracePath;         // --trace, Chrome trace of the run
+	std::string statisticsLogPath; // --stats-log, escape statistics of every frame
+	std::string recordInputPath;   // --record-input, input session of the window
+	std::string replayInputPath;   // --replay, input session replayed in a hidden window
+	std::string latencyLogPath;    // --latency-log, input to present latency of the window
+	std::string memoryBudget;      // --memory-budget, CPU memory budget in MB
+	std::string gpuMemoryBudget;   // --gpu-memory-budget, GPU memory budget in MB
+};
+
+const globalOptions& getGlobalOptions();
+
+// Arguments before the first option (options start with "--")
+
+std::vector<std::string> getPositional(const std::vector<std::string>& args);
+
+// Value following an option ("--threads 4"), returns false if the option is not present
+
+bool getOption(const std::vector<std::string>& args, const std::string& name, std::string& value);
+
+// Presence of an option that takes no value
+
+bool hasFlag(const std::vector<std::string>& args, const std::string& name);
+
+// Value of the "--threads" option, or the number of hardware threads
+
+unsigned getThreadCount(const std::vector<std::string>& args);
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+// Distributed rendering: a coordinator splits an export into bands of rows or a zoom video into frames,
+// and hands them out to worker processes connected over TCP, which stream the pixels back
+// Workers send heartbeats while rendering, the task of a worker that goes silent or disconnects is given to another one
+
+constexpr uint32_t DISTRIBUTED_PROTOCOL_VERSION = 1;
+
+
+// Every message is a header followed by length bytes of payload
+
+enum messageType : uint32_t {
+	MESSAGE_HELLO = 1,		// worker -> coordinator, payload: protocol version
+	MESSAGE_TASK,			// coordinator -> worker, payload: renderTask
+	MESSAGE_RESULT,			// worker -> coordinator, payload: task id, then rowCount * width RGB pixels
+	MESSAGE_HEARTBEAT,		// worker -> coordinator while rendering, no payload
+	MESSAGE_FAILED,			// worker -> coordinator, payload: task id
+	MESSAGE_SHUTDOWN		// coordinator -> worker, no payload
+};
+
+struct messageHeader {
+	uint32_t type;
+	uint32_t length;
+};
+
+
+// Rows [firstRow, firstRow + rowCount) of a view, colored with a palette known to the workers by name
+
+struct renderTask {
+	uint64_t id;
+	double x, y, zoom;
+	uint32_t maxIterations;
+	uint32_t width, height;
+	uint32_t firstRow, rowCount;
+	float paletteCycle;
+	char palette[64];
+};
+
+static_assert(sizeof(renderTask) == 120, "the task layout is part of the protocol");
+
+
+// Split an export or a zoom video into tasks and collect the results from the workers
+
+int runCoordinator(const std::vector<std::string>& args);
+
+// Connect to a coordinator and render tasks until it shuts the worker down
+
+int runWorker(const std::vector<std::string>& args);
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "mandelbrot.h"
+#include "json_writer.h"
+
+#include <array>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+
+
+// Escape counts are binned by quarter octaves: the bins of an octave split [2^k, 2^(k+1)) of (iteration + 1)
+// into four equal parts, so the bins are exact integers on the CPU and the GPU (must match shaders/escape_stats_compute.glsl)
+
+constexpr size_t ESCAPE_HISTOGRAM_BINS = 128;
+
+
+// Statistics of the iteration counts of a frame
+// Escaped pixels are binned by their escape count, pixels that reached maxIterations without escaping (or were proven to be
+// interior before) are counted apart, and on the GPU the pixels that are still iterating are neither (pixels - escapedPixels - maxedPixels)
+
+struct escapeStatistics {
+	uint32_t maxIterations = 0;
+	uint64_t pixels = 0;
+	uint64_t escapedPixels = 0;
+	uint64_t maxedPixels = 0;
+	uint64_t totalIterations = 0;
+	uint32_t lowestIteration = UINT32_MAX;
+	uint32_t highestIteration = 0;
+	std::array<uint64_t, ESCAPE_HISTOGRAM_BINS> histogram{};
+
+	// Count a pixel, maxIterations must be set
+
+	void add(const pixelEscape& escape);
+
+	// Add the pixels counted by other (a part of the same frame)
+
+	void merge(const escapeStatistics& other);
+
+	double meanIterations() const;
+
+	// Fraction of the pixels that reached maxIterations
+
+	double maxedFraction() const;
+};
+
+
+// Bin of an escape count, and the lowest escape count of a bin
+
+size_t escapeHistogramBin(const uint32_t& iteration);
+
+uint32_t escapeHistogramBinStart(const size_t& bin);
+
+// Parallel reduction over the pixels of a frame rendered by renderEscapes
+
+escapeStatistics computeEscapeStatistics(const std::vector<pixelEscape>& escapes, const uint32_t& maxIterations, const unsigned& threads);
+
+
+// Log with one record per frame, CSV unless the path ends in ".json"
+// CSV rows hold the histogram as a single space separated column, the JSON log is an array of objects completed on close
+
+class EscapeStatisticsLog {
+private:
+
+	std::ofstream out;
+	JsonWriter* json;
+
+public:
+
+	// Constructor that creates the file and writes the CSV header or opens the JSON array
+
+	EscapeStatisticsLog(const std::string& path);
+
+	// Destructor, completes the JSON array
+
+	~EscapeStatisticsLog();
+
+	EscapeStatisticsLog(const EscapeStatisticsLog&) = delete;
+	EscapeStatisticsLog& operator=(const EscapeStatisticsLog&) = delete;
+
+	bool isOpen() const;
+
+	void write(const uint64_t& frame, const escapeStatistics& statistics);
+};
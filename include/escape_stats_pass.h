@@ -0,0 +1,73 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <array>
+#include <cstdint>
+
+#include "shader.h"
+#include "escape_stats.h"
+#include "memory_registry.h"
+
+
+// Number of statistics buffers that can be in flight, the statistics of a frame arrive a few frames later
+
+constexpr size_t ESCAPE_STATS_RING_SIZE = 3;
+
+// Binding point of the statistics buffer written by the compute shader (must match shaders/escape_stats_compute.glsl)
+
+constexpr GLuint ESCAPE_STATS_BINDING = 5;
+
+
+// Escape statistics of the pixel states of every frame, reduced on the GPU by a compute shader
+// The results are read back once their fence has signaled, so the render loop never waits for them
+// The pixel states are resumed from frame to frame, so the statistics of a frame include the pixels that are still iterating
+
+class EscapeStatisticsPass {
+private:
+
+	struct statisticsSlot {
+		GLuint SSBO;
+		GLsync fence;
+		uint64_t frame;
+		uint32_t pixels, maxIterations;
+	};
+
+	std::array<statisticsSlot, ESCAPE_STATS_RING_SIZE> slots;
+	size_t nextSlot;
+
+	Shader program;
+	EscapeStatisticsLog* log;
+	TrackedMemory memory;
+
+	bool hasLatest;
+	uint64_t latestFrame;
+	escapeStatistics latest;
+
+	// Read the finished slots from the oldest to the newest, waiting only for waitSlot
+
+	void collect(const size_t& waitSlot);
+
+public:
+
+	// Constructor that builds the compute program and the buffers, the statistics are written to the log if it is not null
+
+	EscapeStatisticsPass(const char* computeShaderPath, EscapeStatisticsLog* log);
+
+	// Destructor, reads the statistics still in flight
+
+	~EscapeStatisticsPass();
+
+	EscapeStatisticsPass(const EscapeStatisticsPass&) = delete;
+	EscapeStatisticsPass& operator=(const EscapeStatisticsPass&) = delete;
+
+	// Reduce the current pixel states (bound to binding point 0) as the statistics of the frame
+
+	void update(const uint64_t& frame, const GLuint& pixelCount, const GLuint& maxIterations);
+
+	// Statistics of the newest frame read back so far, returns false before the first one
+
+	bool getLatest(uint64_t& frame, escapeStatistics& statistics) const;
+
+	Shader& getProgram();
+};
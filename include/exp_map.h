@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+
+
+// Exponential map (log-polar strip) of a zoom path towards a fixed center
+// Column j samples the angle (j + 0.5) / width * 2pi, row i the radius exp(logOuterRadius - (i + 0.5) * logStep),
+// with logStep = 2pi / width so that the samples are square in log-polar space
+// Every frame of a zoom towards the center is a cheap reprojection of a band of rows
+
+constexpr char EXP_MAP_MAGIC[8] = { 'M', 'B', 'E', 'X', 'P', 'M', 'A', 'P' };
+constexpr uint32_t EXP_MAP_VERSION = 1;
+
+// Value stored for samples inside the set
+
+constexpr float EXP_MAP_INTERIOR = -1.0f;
+
+
+// File header, followed by width * height little endian floats (continuous iteration counts), row by row
+// frameWidth and frameHeight are the size of the frames the strip was rendered for (they set its resolution)
+
+struct expMapHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t width, height;
+	uint32_t maxIterations;
+	uint32_t frameWidth, frameHeight;
+	double centerX, centerY;
+	double startZoom, endZoom;
+	double logOuterRadius, logStep;
+};
+
+static_assert(sizeof(expMapHeader) == 80, "the header layout is part of the file format");
+
+
+// Read access to a strip file that keeps only a window of rows in memory
+
+class ExpMapStrip {
+private:
+
+	std::ifstream in;
+	expMapHeader header;
+	std::vector<float> rows;
+	uint32_t firstRow, rowCount;
+
+public:
+
+	// Constructor that opens the file and reads the header
+
+	ExpMapStrip(const char* path);
+
+	bool isOpen() const;
+
+	const expMapHeader& getHeader() const;
+
+	// Make the rows [first, first + count) available (clamped to the strip), reading them if necessary
+
+	void loadRows(const uint32_t& first, const uint32_t& count);
+
+	// Rows from getFirstRow() on, as loaded by the last call to loadRows
+
+	const float* getRows() const;
+	uint32_t getFirstRow() const;
+	uint32_t getRowCount() const;
+
+	// Bilinearly interpolated continuous iteration count at a (fractional) column and row of the strip
+	// The row must be inside the loaded window, the columns wrap around
+	// Interior samples win over exterior ones so that the boundary of the set stays sharp
+
+	float sample(const double& column, const double& row) const;
+};
+
+
+// Zoom of frame index of count frames (exponential between the start and end zoom of the strip)
+
+double expMapFrameZoom(const expMapHeader& header, const size_t& index, const size_t& count);
+
+// Range of strip rows a frame of the given size and zoom needs
+
+void expMapFrameRows(const expMapHeader& header, const int& width, const int& height, const double& zoom, uint32_t& first, uint32_t& last);
+
+// Render a strip or reconstruct the frames of a zoom from one
+
+int runExpMap(const std::vector<std::string>& args);
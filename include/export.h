@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+
+// Render a single view of any size (e.g. 100000 x 100000 for prints) into a PNG file
+// The image is computed in bands of tiles that are compressed while the next band is computed,
+// so that the memory used only depends on the band size and not on the size of the image
+
+int runExport(const std::vector<std::string>& args);
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <array>
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "memory_registry.h"
+
+
+// Number of pixel buffer objects the frames are read back into
+// A frame is usually available two frames after its readback was started
+
+constexpr size_t CAPTURE_RING_SIZE = 3;
+
+// Number of read back frames that may wait for the encoder before the render loop has to wait for it
+
+constexpr size_t MAX_QUEUED_FRAMES = 32;
+
+
+// Asynchronous capture of the rendered frames for screenshots and recordings
+// The default framebuffer is copied into a ring of pixel buffer objects guarded by fences,
+// and the finished copies are handed to a background thread that encodes them as PNG files
+
+class FrameCapture {
+private:
+
+	struct captureSlot {
+		GLuint PBO;
+		GLsync fence;
+		GLsizeiptr size;
+		int width, height;
+		std::string path;
+		int compressionLevel;
+	};
+
+	struct capturedFrame {
+		std::vector<unsigned char> pixels;
+		int width, height;
+		std::string path;
+		int compressionLevel;
+	};
+
+	std::array<captureSlot, CAPTURE_RING_SIZE> slots;
+	size_t nextSlot;
+	TrackedMemory bufferMemory;
+
+	std::string outputDirectory;
+	bool screenshotRequested;
+	bool recording;
+	std::string recordingDirectory;
+	unsigned recordedFrames;
+
+	// Frames waiting to be encoded, shared with the encoder thread
+
+	std::deque<capturedFrame> queue;
+	std::mutex queueMutex;
+	std::condition_variable queueChanged;
+	TrackedMemory queueMemory; // Frames queued or being encoded, updated under queueMutex
+	bool stopping;
+	std::thread encoder;
+
+	// Copy the finished readbacks out of the pixel buffer objects from the oldest to the newest, waiting only for waitSlot
+	// (for none if it is CAPTURE_RING_SIZE)
+
+	void collect(const size_t& waitSlot);
+
+	// Start reading the current frame back into the next slot
+
+	void startReadback(const int& width, const int& height, const std::string& path, const int& compressionLevel);
+
+	// Body of the encoder thread
+
+	void encodeFrames();
+
+public:
+
+	// Constructor that creates the pixel buffer objects and starts the encoder thread
+
+	FrameCapture(const char* outputDirectory);
+
+	// Destructor, waits until every captured frame has been written
+
+	~FrameCapture();
+
+	FrameCapture(const FrameCapture&) = delete;
+	FrameCapture& operator=(const FrameCapture&) = delete;
+
+	// Capture the next frame as a screenshot
+
+	void requestScreenshot();
+
+	// Start / stop capturing every frame into a new directory
+
+	void setRecording(const bool& enabled);
+
+	bool isRecording() const;
+
+	// Called once per frame after drawing and before swapping the buffers
+
+	void update(const int& width, const int& height);
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <streambuf>
+
+
+// Pixel layouts of the raw frames (the names are the ones ffmpeg uses for -pix_fmt)
+
+enum class rawPixelFormat {
+	RGB24,
+	YUV420P
+};
+
+
+// Parse "rgb24" or "yuv420p", returns false for anything else
+
+bool parsePixelFormat(const std::string& name, rawPixelFormat& format);
+
+const char* pixelFormatName(const rawPixelFormat& format);
+
+
+// Convert a tightly packed RGB image to planar YUV 4:2:0 (BT.601, limited range), width and height must be even
+
+void rgbToYuv420(const unsigned char* rgb, const int& width, const int& height, unsigned char* yuv);
+
+
+// Writes frames as headerless raw video to a file, a named pipe or stdout ("-")
+// A frame is converted and written on a separate thread while the caller renders the next one,
+// so there are two frame buffers: the one being rendered and the one being written
+
+class FrameStream {
+private:
+
+	std::FILE* out;
+	std::string target;
+	int width, height;
+	rawPixelFormat format;
+
+	// While the frames go to stdout, std::cout is redirected to stderr (until the destructor) so that messages do not end up in the video
+
+	std::streambuf* redirectedOutput;
+
+	std::vector<unsigned char> pending, converted;
+	bool hasPending, stopping, failed;
+	std::mutex frameMutex;
+	std::condition_variable frameChanged;
+	std::thread writer;
+
+	void writeFrames();
+
+public:
+
+	FrameStream(const std::string& target, const int& width, const int& height, const rawPixelFormat& format);
+
+	// Destructor, finishes the stream if finish was not called
+
+	~FrameStream();
+
+	FrameStream(const FrameStream&) = delete;
+	FrameStream& operator=(const FrameStream&) = delete;
+
+	// Queue a tightly packed RGB frame, waits while the previous frame is still being written
+	// Returns false once a write failed (e.g. the reading end of the pipe was closed)
+
+	bool write(const std::vector<unsigned char>& rgb);
+
+	// Write the last frame and close the output, returns false if anything failed
+
+	bool finish();
+
+	bool isOpen() const;
+
+	// Size in bytes of a single frame in the output format
+
+	size_t getFrameSize() const;
+};
@@ -6,12 +6,66 @@
 
 struct coord{
 	double x, y;
+
+	bool operator==(const coord&) const = default;
+};
+
+// Everything that determines the image on the screen
+struct viewState{
+	coord off;
+	double zoom;
+	int maxIterations;
+	int width, height;
+
+	bool operator==(const viewState&) const = default;
+};
+
+// Settings that only change the colors of the image, not the iteration
+struct coloringState{
+	int paletteIndex;
+	bool histogramColoring;
+	float paletteCycle;
+	int samplePatternIndex;
+	bool distanceEstimation; // Also changes the iteration, which must start over to track dz/dc
+	bool interiorDetection; // Also changes the iteration, which must start over to track the atom domains
+	bool periodColoring;
+
+	bool operator==(const coloringState&) const = default;
+};
+
+// Cursor position (window coordinates) and left mouse button sampled once per frame while an input session is
+// recorded or replayed, so that every use of them during the frame sees the same values
+struct frameInput{
+	bool active;
+	double cursorX, cursorY;
+	bool leftButton;
 };
 
+// Input event that changes the image, waiting for the frame that reflects it (for the latency measurement)
+// time comes from glfwGetTime and is negative while no event is waiting
+struct inputStamp{
+	double time;
+	const char* source; // "key", "scroll" or "pan"
+};
+
+// Bounds of the iteration count that can be set from the keyboard
+constexpr int MIN_ITERATIONS = 50, MAX_ITERATIONS = 10000000;
+
 extern coord off;
 extern double zoom;
 extern int currentWidth, currentHeight;
 extern int maxIterations;
+extern int paletteIndex;
+extern bool histogramColoring;
+extern float paletteCycle;
+extern int samplePatternIndex;
+extern bool distanceEstimation;
+extern bool interiorDetection;
+extern bool periodColoring;
+extern bool takeScreenshot, recordFrames;
+extern bool showHud;
+extern frameInput sessionInput;
+extern inputStamp pendingInput;
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void cursor_position_callback(GLFWwindow* window, double xpos, double ypos);
@@ -20,4 +74,10 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 void zoomOnPoint(GLFWwindow* window, bool mode); // Function used when zooming in/out on a specific point that changes the coordinates of the screen center accordingly
 void normalizeCoord(double& x, double& y);  // Function that takes window coordinates and transforms them into real coordinates
 void setWindowCallbacks(GLFWwindow* window); // Set all the callbacks for the window
-void getMouseCoordinates(GLFWwindow* window, double& xMousePos, double& yMousePos); // Transform the window coordinates of the mouse to real coordinates
\ No newline at end of file
+void getMouseCoordinates(GLFWwindow* window, double& xMousePos, double& yMousePos); // Transform the window coordinates of the mouse to real coordinates
+bool isLeftButtonPressed(GLFWwindow* window); // State of the left mouse button, from the input session if one is active
+void stampInput(const char* source); // Remember the time of an input event, unless an older one is still waiting for its frame
+viewState getCurrentView(); // Snapshot of the current view
+coloringState getCurrentColoring(); // Snapshot of the current coloring settings
+GLFWwindow* createSharedContext(GLFWwindow* window); // Create an invisible window whose context shares objects with the given window (main thread only)
+GLFWwindow* createHeadlessContext(); // Initialize GLFW and GLAD with the context of an invisible window made current, returns nullptr on failure
\ No newline at end of file
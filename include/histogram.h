@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "shader.h"
+#include "memory_registry.h"
+
+
+// Number of bins of the iteration histogram (must match the shaders)
+
+constexpr GLuint HISTOGRAM_BINS = 8192;
+
+
+// Histogram of the continuous iteration counts of the escaped pixels, used for histogram equalized coloring
+// The bins are filled on the GPU with atomics and turned into a cumulative distribution with a parallel prefix sum
+
+class IterationHistogram {
+private:
+
+	GLuint histogramSSBO, cdfSSBO;
+	Shader histogramProgram, prefixSumProgram;
+	TrackedMemory memory;
+
+public:
+
+	// Constructor that builds both compute programs and allocates the buffers
+
+	IterationHistogram(const char* histogramShaderPath, const char* prefixSumShaderPath);
+
+	// Destructor
+
+	~IterationHistogram();
+
+	// Programs of the two passes
+
+	Shader& getHistogramProgram();
+	Shader& getPrefixSumProgram();
+
+	// Rebuild the cumulative distribution from the current pixel states (bound to binding point 0)
+
+	void update(const GLuint& pixelCount);
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "helpers.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+// Input sessions of the window, recorded frame by frame and replayed in a hidden window at one recorded frame per
+// rendered frame, so that the replay goes through the same sequence of views whatever its frame rate
+// While a session is active the cursor and the left button are sampled once per frame (sessionInput), the key and
+// scroll events are dispatched in the frame they arrived in
+//
+// Text file, one line per frame followed by the events of the frame and the view it ended with:
+//   frame <time> <framebuffer width> <height> <cursor x> <cursor y> <left button>
+//   key <time> <key> <scancode> <action> <mods>
+//   scroll <time> <x offset> <y offset>
+//   view <x> <y> <zoom> <max iterations>
+
+
+// Event delivered to key_callback or scroll_callback
+
+struct inputEvent {
+	bool isKey;
+	double time;
+	int key, scancode, action, mods;
+	double xoffset, yoffset;
+};
+
+struct inputFrame {
+	double time;
+	int width, height;
+	double cursorX, cursorY;
+	bool leftButton;
+	std::vector<inputEvent> events;
+	viewState view;
+};
+
+
+class InputRecorder {
+private:
+
+	std::ofstream out;
+	GLFWwindow* window;
+	double startTime;
+
+	// Callbacks that write the event before passing it on to the callbacks of the window
+
+	static void recordKey(GLFWwindow* window, int key, int scancode, int action, int mods);
+	static void recordScroll(GLFWwindow* window, double xoffset, double yoffset);
+
+public:
+
+	// Constructor that creates the file and puts the recording callbacks in place of those of the window
+
+	InputRecorder(const std::string& path, GLFWwindow* window);
+
+	// Destructor that restores the callbacks of the window
+
+	~InputRecorder();
+
+	InputRecorder(const InputRecorder&) = delete;
+	InputRecorder& operator=(const InputRecorder&) = delete;
+
+	bool isOpen() const;
+
+	// Sample the input of the frame into sessionInput and record it, call it before the input is used
+
+	void beginFrame();
+
+	// Record the view the frame ended with, call it after the events were polled
+
+	void endFrame(const viewState& view);
+};
+
+
+class InputReplayer {
+private:
+
+	std::vector<inputFrame> frames;
+	size_t current;
+	unsigned divergedFrames;
+	bool loaded;
+
+public:
+
+	// Constructor that reads the whole session, reports an error if it cannot be read
+
+	InputReplayer(const std::string& path);
+
+	bool isLoaded() const;
+
+	// Framebuffer size of the first frame, to create the window with
+
+	void getInitialSize(int& width, int& height) const;
+
+	// Set up the next frame: the recorded cursor and button in sessionInput and the recorded size of the window
+	// Returns false once every frame has been replayed
+
+	bool beginFrame(GLFWwindow* window);
+
+	// Pass the events of the frame to the callbacks of the window, call it instead of polling the real events
+
+	void dispatchEvents(GLFWwindow* window);
+
+	// Compare the view the frame ended with against the recording
+
+	void endFrame(const viewState& view);
+
+	size_t getFrameCount() const;
+
+	// Frames whose view differs from the recording
+
+	unsigned getDivergedFrames() const;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+// Minimal streaming JSON writer used for manifests and reports
+// Values written directly inside an object must be preceded by key()
+
+class JsonWriter {
+private:
+
+	std::ostream& out;
+
+	// One entry per open object / array: true until its first element has been written
+
+	std::vector<bool> firstElement;
+	bool afterKey;
+
+	// Write the separator and indentation that precede a new element
+
+	void beginElement();
+
+	void indent();
+
+	// Write a quoted and escaped string
+
+	void writeString(const std::string& text);
+
+public:
+
+	JsonWriter(std::ostream& out);
+
+	void beginObject();
+	void endObject();
+	void beginArray();
+	void endArray();
+
+	void key(const std::string& name);
+
+	void value(const std::string& text);
+	void value(const char* text);
+	void value(const double& number);
+	void value(const int64_t& number);
+	void value(const uint64_t& number);
+	void value(const int& number);
+	void value(const unsigned& number);
+	void value(const bool& flag);
+	void null();
+};
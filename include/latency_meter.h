@@ -0,0 +1,122 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <array>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+
+#include "helpers.h"
+#include "json_writer.h"
+
+
+// Number of frames whose presentation timestamps can be in flight, only frames that carry an input use one
+
+constexpr size_t LATENCY_QUERY_RING_SIZE = 8;
+
+// Number of the most recent measurements the overlay percentiles are computed over
+
+constexpr size_t LATENCY_RECENT_SAMPLES = 256;
+
+// Time after which the offset between the GPU and the CPU clocks is measured again, to follow their drift
+
+constexpr double LATENCY_CALIBRATION_INTERVAL = 1.0;
+
+
+// Latency of an input event: from the callback that received it to the submission (glfwSwapBuffers returned)
+// and to the presentation (the GPU reached the end of the frame) of the first frame that reflects it
+
+struct latencySample {
+	uint64_t frame;
+	const char* source;
+	double inputTime;
+	double submitMilliseconds, presentMilliseconds;
+};
+
+// Nearest rank percentiles of a set of latencies, in milliseconds
+
+struct latencyPercentiles {
+	size_t count = 0;
+	double p50 = 0.0, p90 = 0.0, p99 = 0.0, p999 = 0.0, max = 0.0;
+};
+
+latencyPercentiles computeLatencyPercentiles(std::vector<double> milliseconds);
+
+
+// Input to photon latency of the window
+// The callbacks of helpers.cpp stamp the oldest input that has not reached a frame yet (pendingInput), the next frame
+// takes it and queries a GL_TIMESTAMP right after its swap. The timestamp is read back frames later, without waiting,
+// and converted to the clock of glfwGetTime. The presentation measured this way does not include the scanout of the display,
+// nor the time an event waited in the queue of the system while the previous frame was rendered
+
+class LatencyMeter {
+private:
+
+	struct latencySlot {
+		GLuint query;
+		bool pending;
+		uint64_t frame;
+		inputStamp input;
+		double submitTime;
+	};
+
+	std::array<latencySlot, LATENCY_QUERY_RING_SIZE> slots;
+	size_t nextSlot;
+
+	uint64_t frame;
+	inputStamp frameInput;
+
+	// CPU time of GPU time 0 in seconds, and when it was measured
+
+	double gpuClockOffset;
+	double lastCalibration;
+
+	std::vector<latencySample> samples;
+
+	std::ofstream out;
+	JsonWriter* json;
+
+	// Read the finished timestamps from the oldest to the newest, waiting only for waitSlot (for none if it is
+	// LATENCY_QUERY_RING_SIZE)
+
+	void collect(const size_t& waitSlot);
+
+	void calibrate();
+
+	void write(const latencySample& sample);
+
+public:
+
+	// Constructor, the measurements are also written to the log at logPath (CSV unless it ends in ".json") if it is not empty
+
+	LatencyMeter(const std::string& logPath);
+
+	// Destructor, reads the timestamps still in flight and completes the log
+
+	~LatencyMeter();
+
+	LatencyMeter(const LatencyMeter&) = delete;
+	LatencyMeter& operator=(const LatencyMeter&) = delete;
+
+	bool isOpen() const;
+
+	// Take the input the frame reflects, call it before the input is used
+
+	void beginFrame();
+
+	// Query the presentation of the frame if it carries an input, call it right after glfwSwapBuffers
+
+	void endFrame();
+
+	// Percentiles of the most recent measurements and of every measurement of a source (nullptr for all of them)
+
+	latencyPercentiles getRecentPercentiles() const;
+
+	latencyPercentiles getPercentiles(const char* source, const bool& present = true) const;
+
+	// Print the percentiles of the whole run per source, once the timestamps still in flight have been read
+
+	void printSummary();
+};
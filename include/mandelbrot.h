@@ -0,0 +1,114 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <functional>
+
+#include "helpers.h"
+#include "palette.h"
+
+
+// CPU implementation of the iteration and coloring done by the shaders, used for headless rendering
+// The constants and formulas must match shaders/fragment_shader.glsl
+
+constexpr double ESCAPE_RADIUS_SQUARED = 256.0;
+
+// Number of iterations after which the palette repeats unless a view sets its own cycle
+
+constexpr float DEFAULT_PALETTE_CYCLE = 256.0f;
+
+// Distance to the boundary, in pixels, below which distance coloring darkens an escaped pixel
+
+constexpr double DISTANCE_SHADING_PIXELS = 2.0;
+
+// Interior detection: Newton steps spent looking for an attracting cycle, and the contraction (squared derivative of the orbit
+// since the last check) below which the orbit is checked again without reaching a new atom domain
+
+constexpr int INTERIOR_NEWTON_STEPS = 8;
+constexpr double INTERIOR_CONTRACTION = 1e-4;
+
+// Squared multiplier above which Newton's method gives up on a cycle
+
+constexpr double INTERIOR_REPELLING = 4.0;
+
+// Interior distance, relative to |c|, below which a cycle is not trusted (a few hundred times the precision of a double)
+
+constexpr double INTERIOR_PRECISION = 1e-13;
+
+// Step between the palette positions of successive periods (the golden ratio spreads them evenly)
+
+constexpr float PERIOD_PALETTE_STEP = 0.618034f;
+
+
+// Final state of the iteration of one point
+// period is the period of the attracting cycle of a point proven to be inside the set, 0 if it was not
+// distance is the exterior distance estimate of an escaped point or the interior distance estimate of a point with a period,
+// negative when it is not known
+
+struct pixelEscape {
+	double zx, zy;
+	uint32_t iteration;
+	bool escaped;
+	uint32_t period = 0;
+	float distance = -1.0f;
+};
+
+
+// Iterate z = z^2 + c from z = 0 until |z| exceeds the escape radius or maxIterations is reached
+
+pixelEscape iterateMandelbrot(const double& cx, const double& cy, const uint32_t& maxIterations);
+
+// Same iteration with the derivative analysis of the orbit
+// trackDistance: the derivative dz/dc is tracked to estimate the distance of an escaped point to the set
+// detectInterior: the orbit is checked for an attracting cycle, using the iteration of its smallest |z| (its atom domain) as the
+// period, whenever it reaches a new atom domain while contracting or contracts by INTERIOR_CONTRACTION, so that points proven to be
+// inside the set stop long before maxIterations with their period and interior distance estimate
+
+pixelEscape iterateMandelbrotAnalyzed(const double& cx, const double& cy, const uint32_t& maxIterations, const bool& trackDistance, const bool& detectInterior);
+
+// Continuous (normalized) iteration count of an escaped point
+
+float smoothIteration(const pixelEscape& escape);
+
+// Real coordinates of a position in the image of a view (pixel (0, 0) is the top left corner, .5 is the pixel center)
+
+coord imageToCoord(const viewState& view, const double& x, const double& y);
+
+// Position in the image of a view of the given real coordinates (inverse of imageToCoord)
+
+void coordToImage(const viewState& view, const coord& c, double& x, double& y);
+
+// Size of a pixel of a view in real coordinates
+
+double pixelSize(const viewState& view);
+
+// Call rowFunction for every row, the rows are handed out one at a time to the given number of threads
+
+void parallelRows(const int& height, const unsigned& threads, const std::function<void(int)>& rowFunction);
+
+// Iterate every pixel of a view (rows from top to bottom), the rows are distributed over the given number of threads
+// With detectInterior the pixels proven to be inside the set stop early, the colors stay the same but not the iteration counts
+
+void renderEscapes(const viewState& view, std::vector<pixelEscape>& escapes, const unsigned& threads, const bool& detectInterior = false);
+
+// Color of a pixel: the palette repeats every paletteCycle iterations, the interior is black
+
+std::array<unsigned char, 3> map_to_color(const Palette& palette, const pixelEscape& escape, const float& paletteCycle);
+
+// Color of a continuous iteration count (negative for interior pixels)
+
+std::array<unsigned char, 3> map_to_color(const Palette& palette, const float& iteration, const float& paletteCycle);
+
+// Darken the color of a pixel that is closer to the set than DISTANCE_SHADING_PIXELS (distance in pixels, negative inside the set)
+// Filaments thinner than a pixel, which the iteration count alone misses at low iteration counts, show up as dark lines
+
+std::array<unsigned char, 3> shadeDistance(const std::array<unsigned char, 3>& color, const double& distancePixels);
+
+// Color of an interior point proven to have an attracting cycle of the given period
+
+std::array<unsigned char, 3> periodColor(const Palette& palette, const uint32_t& period);
+
+// Color every pixel into tightly packed RGB rows
+
+void colorEscapes(const std::vector<pixelEscape>& escapes, const Palette& palette, const float& paletteCycle, std::vector<unsigned char>& rgb);
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "json_writer.h"
+
+
+// Accounting of the memory held by every subsystem, on the CPU and on the GPU
+// Subsystems hold a TrackedMemory per allocation (or group of allocations) and update it as the allocation changes size.
+// The totals of a domain can be given a budget: caches shrink to stay within it, and an allocation that cannot
+// shrink and exceeds it is reported once (ERROR:MEMORY_BUDGET_EXCEEDED) until the domain is back within its budget
+
+
+enum class memoryDomain {
+	cpu,
+	gpu
+};
+
+// Bytes held by a subsystem in a domain, "total" for the sum of a domain
+
+struct memoryUsage {
+	const char* subsystem;
+	memoryDomain domain;
+	int64_t current, peak;
+};
+
+
+const char* memoryDomainName(const memoryDomain& domain);
+
+// Budget of a domain in bytes, 0 for no budget (set from --memory-budget and --gpu-memory-budget)
+
+void setMemoryBudget(const memoryDomain& domain, const int64_t& bytes);
+
+int64_t getMemoryBudget(const memoryDomain& domain);
+
+// Bytes that can still be allocated in a domain without exceeding its budget, INT64_MAX without budget
+
+int64_t getAvailableMemory(const memoryDomain& domain);
+
+// Usage of every subsystem that has held memory, CPU before GPU and in the order they first allocated
+
+std::vector<memoryUsage> getMemoryUsage();
+
+memoryUsage getTotalMemoryUsage(const memoryDomain& domain);
+
+// Write the usage as a JSON object: budget and totals per domain, and the list of subsystems
+
+void writeMemoryUsage(JsonWriter& json);
+
+
+// Memory held by a subsystem, released when the object is destroyed
+// An object must not be updated by two threads at once, the totals can be read from any thread
+
+class TrackedMemory {
+private:
+
+	struct memoryEntry* entry;
+	int64_t bytes;
+
+public:
+
+	// Constructor, the subsystem name must outlive the program (a string literal)
+
+	TrackedMemory(const char* subsystem, const memoryDomain& domain);
+
+	~TrackedMemory();
+
+	TrackedMemory(const TrackedMemory&) = delete;
+	TrackedMemory& operator=(const TrackedMemory&) = delete;
+
+	// Change the size of the allocation
+
+	void set(const int64_t& bytes);
+
+	// Whether the allocation can grow (or shrink) to the given size without exceeding the budget of its domain
+
+	bool fits(const int64_t& bytes) const;
+
+	int64_t get() const;
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET socketHandle;
+#else
+typedef int socketHandle;
+#endif
+
+
+// Thin wrapper over BSD sockets / Winsock for the TCP connections of the server and distributed modes
+
+constexpr socketHandle NO_SOCKET = (socketHandle)-1;
+
+
+// Initialize the socket library (needed once on Windows), returns false on failure
+
+bool initializeSockets();
+
+// Listen on a port (0 picks a free one, returned in boundPort), on the loopback interface unless anyInterface is set
+
+socketHandle listenOn(const uint16_t& port, const bool& anyInterface, uint16_t& boundPort);
+
+// Accept the next connection, returns NO_SOCKET on failure
+
+socketHandle acceptConnection(const socketHandle& listener);
+
+// Connect to host:port, returns NO_SOCKET on failure
+
+socketHandle connectTo(const std::string& host, const uint16_t& port);
+
+// Send all bytes, returns false if the connection failed
+
+bool sendAll(const socketHandle& socket, const void* data, const size_t& size);
+
+// Receive exactly size bytes, returns false if the connection was closed or failed first
+
+bool receiveAll(const socketHandle& socket, void* data, const size_t& size);
+
+// Receive up to size bytes, returns the number of bytes (0 if the peer closed the connection, negative on failure)
+
+long receiveSome(const socketHandle& socket, void* data, const size_t& size);
+
+// Wait up to timeoutMilliseconds for data (or the end of the connection) to arrive
+
+bool waitReadable(const socketHandle& socket, const int& timeoutMilliseconds);
+
+// Check without blocking whether the peer has closed the connection (pending data is left in place)
+
+bool peerClosed(const socketHandle& socket);
+
+void closeSocket(const socketHandle& socket);
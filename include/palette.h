@@ -0,0 +1,71 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <array>
+#include <memory>
+
+#include "memory_registry.h"
+
+
+// Color palette used to map the (continuous) iteration counts to colors
+// The colors are read from a text file with one "red green blue" triple (0 - 255) per line
+
+class Palette {
+private:
+
+	std::string name;
+	std::vector<std::array<float, 3>> colors;
+	GLuint texture;
+	TrackedMemory memory;
+
+public:
+
+	// Constructor that creates the default palette (the polynomial that was originally hardcoded in the shader)
+
+	Palette();
+
+	// Constructor that reads the palette from a file
+
+	Palette(const char* path);
+
+	// Destructor
+
+	~Palette();
+
+	Palette(const Palette&) = delete;
+	Palette& operator=(const Palette&) = delete;
+
+	// Returns false if the file could not be read or did not contain any color
+
+	bool isValid() const;
+
+	const std::string& getName() const;
+
+	// Number of colors, the interpolation between them is linear
+
+	size_t getSize() const;
+
+	// Color at position t, interpolated and mirrored like the texture lookup in the shaders
+
+	std::array<float, 3> sample(const float& t) const;
+
+	// Upload the colors to a 1D texture (on first use) and bind it to the given texture unit
+
+	void bind(const GLuint& textureUnit);
+};
+
+
+// Load every palette in the given directory, sorted by name (the default palette is used if none can be loaded)
+// The palettes are released with the vector, before the OpenGL context if their textures were used
+
+std::vector<std::unique_ptr<Palette>> loadPalettes(const char* directory);
+
+// Find a palette by name (the file name without extension), returns nullptr if there is none
+
+Palette* findPalette(const std::vector<std::unique_ptr<Palette>>& palettes, const std::string& name);
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <array>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "shader.h"
+#include "helpers.h"
+#include "memory_registry.h"
+
+
+// Number of frames whose GPU timer queries and iteration counters can be in flight
+// A frame is usually measured two or three frames after it was submitted
+
+constexpr size_t HUD_QUERY_RING_SIZE = 4;
+
+// Binding point of the iteration counter written by the fragment shader (must match shaders/fragment_shader.glsl)
+
+constexpr GLuint HUD_COUNTER_BINDING = 4;
+
+// Time over which the measurements are averaged before the displayed values change
+
+constexpr double HUD_UPDATE_INTERVAL = 0.5;
+
+
+// Overlay in the top left corner of the window with the frame time, the GPU time of the iteration pass,
+// the iterations per second, the precision and the current view
+// The GPU time comes from GL_TIME_ELAPSED queries and the iteration count from a counter incremented by
+// the fragment shader, both are read back frames later once the GPU has finished them so the render loop never waits
+
+class PerformanceHud {
+private:
+
+	struct measurementSlot {
+		GLuint query;
+		GLuint counterSSBO;
+		bool pending;
+	};
+
+	std::array<measurementSlot, HUD_QUERY_RING_SIZE> slots;
+	size_t currentSlot;
+	bool measuring;
+
+	Shader program;
+	GLuint fontTexture, textTexture;
+	TrackedMemory memory;
+	int64_t fontBytes;
+
+	// Size the text texture was allocated with (it only grows) and the text last uploaded to it
+
+	size_t textureColumns, textureLines;
+	std::vector<unsigned char> uploadedText;
+
+	// Measurements gathered since the displayed values were last updated
+
+	std::chrono::steady_clock::time_point lastFrame;
+	double windowSeconds, windowGpuSeconds;
+	uint64_t windowIterations;
+	unsigned windowFrames, windowGpuFrames;
+
+	// Displayed values
+
+	double frameMilliseconds, gpuMilliseconds, iterationsPerSecond;
+	double latencyMedian, latency99; // Input to present, negative before the first input was measured
+
+	// Read the results of the finished frames, waiting for the given slot if it is still pending
+
+	void collect(const size_t& waitSlot);
+
+public:
+
+	// Constructor that builds the overlay program (drawn over a full screen quad) and the font texture
+
+	PerformanceHud(const char* vertexShaderPath, const char* fragmentShaderPath);
+
+	// Destructor
+
+	~PerformanceHud();
+
+	PerformanceHud(const PerformanceHud&) = delete;
+	PerformanceHud& operator=(const PerformanceHud&) = delete;
+
+	// Start a frame: measure the time since the previous one and, if measureGpu is set, reset the iteration
+	// counter of the frame, bind it and start its timer query
+
+	void beginFrame(const bool& measureGpu);
+
+	// End the timer query of the frame, call it after the passes that should be measured
+
+	void endFrame();
+
+	// Input to present latency shown by the overlay (median and 99th percentile, in milliseconds)
+
+	void setInputLatency(const double& medianMilliseconds, const double& p99Milliseconds);
+
+	// Draw the overlay, the vertex array of the full screen quad (two indexed triangles) must be bound
+
+	void draw(const viewState& view, const char* precision);
+
+	Shader& getProgram();
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "memory_registry.h"
+
+
+// Size in bytes of one pixel state in the shader storage buffer
+// std430 layout of struct { dvec2 z; dvec2 dz; uint iteration; uint escaped; uint supersampleGeneration; uint supersampledColor;
+// uint period; uint atomPeriod; float atomMagnitude; float contraction; }, the supersampled color is packed with packUnorm4x8
+
+constexpr GLsizeiptr PIXEL_STATE_SIZE = 64;
+
+// Offset in bytes of the iteration count and of the escaped flag in a pixel state
+
+constexpr GLsizeiptr PIXEL_STATE_ITERATION_OFFSET = 32;
+constexpr GLsizeiptr PIXEL_STATE_ESCAPED_OFFSET = 36;
+
+
+// Shader storage buffer that keeps the iteration state (z, dz/dc while distance estimation is on, iteration count, escaped flag,
+// atom domain and period of the interior detection) of every pixel,
+// so that the fragment shader can continue the iteration where the previous frame stopped
+// Edge pixels additionally cache their supersampled color, tagged with the generation of the coloring settings
+
+class PixelStateBuffer {
+private:
+
+	GLuint SSBO;
+	GLuint binding;
+	GLuint width, height;
+	TrackedMemory memory;
+
+public:
+
+	// Constructor that creates the buffer and attaches it to the given binding point
+
+	PixelStateBuffer(const GLuint& binding);
+
+	// Destructor
+
+	~PixelStateBuffer();
+
+	// Reallocate the buffer for a new resolution (the state of all pixels is reset)
+
+	void resize(const GLuint& width, const GLuint& height);
+
+	// Restart the iteration of all pixels from z = 0
+
+	void reset();
+
+	// Bind the buffer to its binding point
+
+	void bind();
+
+	GLuint getID();
+	GLuint getWidth();
+	GLuint getHeight();
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <zlib.h>
+
+#include <fstream>
+#include <vector>
+#include <cstdint>
+
+
+// Position in a partially written PNG file from which another writer can continue it
+// (e.g. after the process was killed), see PngWriter::flush
+
+struct pngResumePoint {
+	uint64_t fileSize;
+	uint32_t rowsWritten;
+	uint32_t adler;
+};
+
+
+// Streaming PNG encoder for 8 bit RGB images
+// Rows are filtered, compressed and written to the file as they arrive (top to bottom),
+// so the whole image never has to be kept in memory
+// The zlib wrapper is written by hand around a raw deflate stream, so that a flushed file can be
+// continued by a new compressor that only knows the checksum of the rows before
+
+class PngWriter {
+private:
+
+	std::fstream out;
+	z_stream stream;
+	std::vector<unsigned char> compressed;
+	std::vector<unsigned char> filteredRow;
+	size_t compressedSize;
+	uint32_t width, height, rowsWritten;
+	uLong adler;
+	bool failed, finished;
+
+	// Set up the raw deflate stream
+
+	bool initializeCompressor(const int& compressionLevel);
+
+	// Write a complete chunk (length, type, data and CRC)
+
+	void writeChunk(const char* type, const unsigned char* data, const uint32_t& length);
+
+	// Filter a single row and pass it to the compressor
+
+	void compressRow(const unsigned char* rgb);
+
+	// Run the compressor over the pending input, full buffers of compressed data are written as IDAT chunks
+
+	void deflateRows(const int& flush);
+
+	// Write the compressed data gathered so far as an IDAT chunk
+
+	void writeCompressed();
+
+public:
+
+	// Constructor that opens the file and writes the header
+	// compressionLevel follows zlib (1 = fastest, 9 = smallest)
+
+	PngWriter(const char* path, const uint32_t& width, const uint32_t& height, const int& compressionLevel = Z_DEFAULT_COMPRESSION);
+
+	// Constructor that continues a file written by a previous writer, the file is cut back to the resume point
+
+	PngWriter(const char* path, const uint32_t& width, const uint32_t& height, const int& compressionLevel, const pngResumePoint& resumePoint);
+
+	// Destructor, finishes the file if finish was not called
+
+	~PngWriter();
+
+	PngWriter(const PngWriter&) = delete;
+	PngWriter& operator=(const PngWriter&) = delete;
+
+	// Append rows of tightly packed RGB pixels
+
+	void writeRows(const unsigned char* rgb, const uint32_t& rowCount);
+
+	// Write out everything compressed so far, ending on a byte boundary with no references to earlier data
+	// Returns false if anything failed, otherwise the file can be continued from the returned resume point
+
+	bool flush(pngResumePoint& resumePoint);
+
+	// Flush the compressor and write the end of the file, returns false if anything failed
+
+	bool finish();
+
+	bool isOpen() const;
+};
+
+
+// Write a whole RGB image at once (rows from top to bottom)
+
+bool writePng(const char* path, const unsigned char* rgb, const uint32_t& width, const uint32_t& height, const int& compressionLevel = Z_DEFAULT_COMPRESSION);
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+
+#include "helpers.h"
+#include "mandelbrot.h"
+
+
+// Raw per pixel escape data of a render, so that it can be recolored without iterating again
+// The file is a header followed by the samples of every pixel, rows from top to bottom
+// A sample is a run of little endian floats: the continuous iteration count (negative inside the set),
+// followed by the channels listed in the header in the order of their flags
+
+constexpr char RAW_ITERATIONS_MAGIC[8] = { 'M', 'B', 'R', 'A', 'W', 'I', 'T', '\0' };
+constexpr uint32_t RAW_ITERATIONS_VERSION = 1;
+
+// Optional channels of a sample
+
+constexpr uint32_t RAW_CHANNEL_MAGNITUDE = 1;		// |z| when the iteration stopped
+constexpr uint32_t RAW_CHANNEL_DISTANCE = 2;		// distance estimate to the set, in units of the pixel size
+constexpr uint32_t RAW_CHANNEL_PERIOD = 4;			// period of the attracting cycle of an interior pixel, 0 if it is not known
+
+
+// headerSize is the offset of the first sample, readers skip fields added by later versions
+
+struct rawIterationHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize;
+	uint32_t width, height;
+	uint32_t maxIterations;
+	uint32_t channels;
+	uint32_t sampleSize;
+	uint32_t reserved;
+	double centerX, centerY, zoom;
+	double escapeRadiusSquared;
+};
+
+static_assert(sizeof(rawIterationHeader) == 72, "the header layout is part of the file format");
+
+
+// Number of floats in a sample with the given channels
+
+uint32_t rawSampleFloats(const uint32_t& channels);
+
+// Store the escape data of a pixel as a sample with the given channels, the distance is divided by the pixel size of the render
+
+void storeRawSample(const pixelEscape& escape, const uint32_t& channels, const double& pixelSize, float* sample);
+
+
+// Writes the samples of a render row by row as they are computed
+
+class RawIterationWriter {
+private:
+
+	std::fstream out;
+	rawIterationHeader header;
+	uint32_t rowsWritten;
+	bool finished;
+
+	void fillHeader(const viewState& view, const uint32_t& channels);
+
+public:
+
+	// Constructor that opens the file and writes the header of a render of the view
+
+	RawIterationWriter(const char* path, const viewState& view, const uint32_t& channels);
+
+	// Constructor that continues a file of the same render after its first rows, later rows are dropped
+
+	RawIterationWriter(const char* path, const viewState& view, const uint32_t& channels, const uint32_t& resumeRows);
+
+	// Destructor, finishes the file if finish was not called
+
+	~RawIterationWriter();
+
+	RawIterationWriter(const RawIterationWriter&) = delete;
+	RawIterationWriter& operator=(const RawIterationWriter&) = delete;
+
+	// Append rows of tightly packed samples
+
+	void writeRows(const float* samples, const uint32_t& rowCount);
+
+	// Pass the rows written so far to the file, returns false if anything failed
+
+	bool flush();
+
+	// Fill the missing rows with interior samples and close the file, returns false if anything failed
+
+	bool finish();
+
+	bool isOpen() const;
+};
+
+
+// Read only memory mapping of a raw iteration file, the samples are used in place
+
+class RawIterationFile {
+private:
+
+	const unsigned char* data;
+	size_t size;
+	rawIterationHeader header;
+
+	// Release the mapping
+
+	void unmap();
+
+public:
+
+	// Constructor that maps the file and checks the header
+
+	RawIterationFile(const char* path);
+
+	// Destructor, unmaps the file
+
+	~RawIterationFile();
+
+	RawIterationFile(const RawIterationFile&) = delete;
+	RawIterationFile& operator=(const RawIterationFile&) = delete;
+
+	bool isOpen() const;
+
+	const rawIterationHeader& getHeader() const;
+
+	// View the data was rendered with
+
+	viewState getView() const;
+
+	// First float of the sample of a pixel, and the position of a channel in it (-1 if the file does not have it)
+
+	const float* getSample(const uint32_t& x, const uint32_t& y) const;
+	int getChannelOffset(const uint32_t& channel) const;
+};
+
+
+// Color the rows of a raw iteration file into a PNG file
+
+int runRecolor(const std::vector<std::string>& args);
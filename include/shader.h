@@ -6,6 +6,15 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <vector>
+
+
+// Source file and type of one stage of a shader program
+
+struct shaderStage {
+	std::string path;
+	GLenum type;
+};
 
 
 class Shader {
@@ -13,19 +22,36 @@ private:
 
 	GLuint* ID;
 
-	// Utility funtion that loads the shader source code and creates a shader
+	// Source files the program was built from, kept so that it can be rebuilt when they change
+
+	std::vector<shaderStage> stages;
 
-	void loadShader(const char* shaderPath, const GLenum& shaderType, GLuint& shader);
+	// Utility funtion that loads the shader source code and creates a shader, returns false if compilation failed
+
+	static bool loadShader(const char* shaderPath, const GLenum& shaderType, GLuint& shader);
 
 	// Function that reads the source code and returns a string
 
-	const std::string readFileToString(const char* path);
+	static const std::string readFileToString(const char* path);
+
+	// Check the link status of the program and print the log on failure
+
+	static bool checkLinking(const GLuint& program);
 
 public:
+
+	// Compile and link a program from its stages, returns 0 if any stage fails to compile or the program fails to link
+	// Only needs a current context, so it can also run on a thread with a shared context
+
+	static GLuint buildProgram(const std::vector<shaderStage>& stages);
 	
 	// Constructor that reads and builds the shader program
 
 	Shader(const char* vertexShaderPath, const char* fragmentShaderPath);
+
+	// Constructor that reads and builds a compute shader program
+
+	Shader(const char* computeShaderPath);
 	
 	// Destructor
 
@@ -35,10 +61,28 @@ public:
 
 	GLuint getID();
 
+	// Source files of the program
+
+	const std::vector<shaderStage>& getStages();
+
+	// Replace the program by one rebuilt from the same stages (the old program is deleted)
+
+	void swapProgram(const GLuint& program);
+
 	// Bind all the CPU values to the GPU values
 
 	void setValues(const GLuint& width, const GLuint& height, const GLdouble& x, const GLdouble& y, const GLdouble& zoom, const GLuint& maxIterations);
 
+	// Bind the palette texture unit and the coloring settings
+
+	void setColoring(const GLint& paletteUnit, const GLfloat& paletteCycle, const GLuint& coloringMode);
+
+	// Set a single uniform of the shader program by name
+
+	void setUInt(const char* name, const GLuint& value);
+	void setInt(const char* name, const GLint& value);
+	void setFloat(const char* name, const GLfloat& value);
+
 	// Activate the shader program;
 	
 	void use();
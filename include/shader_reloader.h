@@ -0,0 +1,72 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+#include "shader.h"
+
+
+// Watches the shader sources and rebuilds the programs that use a changed file on a worker thread
+// The worker owns an invisible context that shares objects with the window, so compiling never blocks the render loop
+// A rebuilt program replaces the old one only after it linked successfully and the worker's commands have completed
+
+class ShaderReloader {
+private:
+
+	struct rebuiltProgram {
+		Shader* shader;
+		GLuint program;
+		GLsync fence;
+	};
+
+	std::string directory;
+	std::vector<Shader*> shaders;
+
+	GLFWwindow* workerContext;
+	std::thread worker;
+	std::atomic<bool> stopping;
+
+	// Programs built by the worker and waiting to be swapped in by the render loop
+
+	std::vector<rebuiltProgram> rebuilt;
+	std::mutex rebuiltMutex;
+
+	// Body of the worker thread: wait for changes and rebuild the programs using the changed files
+
+	void watchFiles();
+
+	// Rebuild every watched program that has one of the given files as a stage
+
+	void rebuild(const std::vector<std::string>& changedFiles);
+
+public:
+
+	// Constructor that creates the shared context (must be called on the main thread)
+
+	ShaderReloader(GLFWwindow* window, const char* directory);
+
+	// Destructor, stops the worker and deletes the programs that were never swapped in
+
+	~ShaderReloader();
+
+	ShaderReloader(const ShaderReloader&) = delete;
+	ShaderReloader& operator=(const ShaderReloader&) = delete;
+
+	// Rebuild the given program when its sources change (all programs must be added before start)
+
+	void watch(Shader& shader);
+
+	// Start the worker thread
+
+	void start();
+
+	// Swap in the programs whose rebuild has completed, called by the render loop once per frame
+
+	void update();
+};
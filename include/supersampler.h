@@ -0,0 +1,62 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <array>
+
+#include "shader.h"
+#include "memory_registry.h"
+
+
+// Sub-pixel sample positions (offsets in pixels from the pixel center) used when supersampling an edge pixel
+
+struct samplePattern {
+	const char* name;
+	std::vector<std::array<GLfloat, 2>> offsets;
+};
+
+// Patterns that can be cycled through, the first one disables supersampling
+
+extern const std::vector<samplePattern> SAMPLE_PATTERNS;
+
+// Size in bytes of the supersampling progress of one pixel (SampleState of shaders/supersample_fragment.glsl, std430)
+
+constexpr GLsizeiptr SAMPLE_STATE_SIZE = 64;
+
+
+// Post-pass that supersamples only the pixels whose iteration count varies strongly against their neighbors
+// The pass runs once the image has converged and caches the resulting colors in the pixel states
+// The samples of a pixel are iterated over several frames like the pixels themselves, their progress is kept in a buffer of its own
+
+class EdgeSupersampler {
+private:
+
+	Shader program;
+	GLuint costSSBO, sampleSSBO;
+	TrackedMemory memory;
+
+public:
+
+	// Constructor that builds the post-pass program and the buffer counting the work done per frame
+
+	EdgeSupersampler(const char* vertexShaderPath, const char* fragmentShaderPath);
+
+	// Destructor
+
+	~EdgeSupersampler();
+
+	// Program of the post-pass, used to pass the view and coloring values
+
+	Shader& getProgram();
+
+	// Reallocate the progress of the samples for a new resolution
+
+	void resize(const GLuint& width, const GLuint& height);
+
+	// Activate the post-pass for the next draw of the screen quad
+	// generation identifies the coloring settings and the view (the progress of the samples is only resumed within the same
+	// generation), costBudget limits the work of one frame (in thousands of iterations)
+
+	void prepare(const samplePattern& pattern, const GLuint& generation, const GLuint& costBudget, const GLfloat& edgeThreshold);
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+#include <cstdint>
+
+#include "helpers.h"
+#include "palette.h"
+
+
+// Square region covered by the root tile of a pyramid, the root view of the window is 4 / zoom high
+
+struct pyramidRoot {
+	coord center;
+	double zoom;
+};
+
+
+// View of tile (x, y) of a zoom level (2^level x 2^level tiles, y = 0 is the top row as in XYZ web maps)
+
+viewState tileView(const pyramidRoot& root, const int& level, const int& x, const int& y, const int& tileSize, const int& maxIterations);
+
+// Decide from the border of a tile whether every pixel of it has the same color, without iterating the inside:
+// - if the whole border is inside the set, so is the tile, as the set has no holes
+// - if the whole border escapes and the tile cannot contain the whole (connected) set, the tile does not touch the set
+//   and the continuous iteration count inside stays between its extremes on the border
+// Returns true and the color if the tile is uniform
+
+bool uniformTileColor(const viewState& view, const Palette& palette, const float& paletteCycle, std::array<unsigned char, 3>& color);
+
+// Render the tiles of every level below the root into <directory>/<level>/<x>/<y>.png
+// Uniform tiles are written once and linked into the pyramid
+
+int runTilePyramid(const std::vector<std::string>& args);
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+
+#include "memory_registry.h"
+
+
+// Encoded tile shared between the cache and the connections sending it
+
+typedef std::shared_ptr<const std::vector<unsigned char>> tileData;
+
+
+// In memory least recently used cache of encoded tiles, bounded by the total size of the tiles
+
+class TileCache {
+private:
+
+	typedef std::list<std::pair<std::string, tileData>> entryList;
+
+	entryList entries;
+	std::unordered_map<std::string, entryList::iterator> index;
+	size_t capacity, size;
+	std::mutex mutex;
+	TrackedMemory memory;
+
+public:
+
+	// Constructor, capacity in bytes
+
+	TileCache(const size_t& capacity);
+
+	// Tile stored under the key (marked as the most recently used one), nullptr if it is not cached
+
+	tileData get(const std::string& key);
+
+	// Store a tile, evicting the least recently used tiles until the cache fits its capacity and the CPU memory budget again
+
+	void put(const std::string& key, const tileData& data);
+};
+
+
+// Serve the tiles of a pyramid (see --tiles) over HTTP on the loopback interface: GET /<level>/<x>/<y>.png
+// Tiles are looked up in memory, then on disk, and rendered otherwise. Concurrent requests for the same tile
+// share one rendering, which is cancelled once every client waiting for it has disconnected
+
+int runTileServer(const std::vector<std::string>& args);
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+
+// Scoped timing markers written as a Chrome trace (JSON, opened with chrome://tracing or ui.perfetto.dev)
+// Every thread appends its events to its own buffer without locking, the buffers are only read when the trace
+// is written. While tracing is disabled a marker costs a single relaxed atomic load.
+
+extern std::atomic<bool> traceEnabled;
+
+
+// Start recording, the trace is written to the path by stopTracing or when the program exits
+
+void startTracing(const char* path);
+
+// Stop recording and write the trace, returns false if it could not be written
+
+bool stopTracing();
+
+// Name shown for the calling thread in the trace (e.g. "main", "encoder")
+
+void setTraceThreadName(const char* name);
+
+// Nanoseconds since the trace was started
+
+int64_t traceNow();
+
+// Append a complete event to the buffer of the calling thread, the name must outlive the trace (a string literal)
+
+void recordTraceEvent(const char* name, const int64_t& start, const int64_t& end);
+
+
+// Records the time between its construction and destruction as an event
+
+class TraceScope {
+private:
+
+	const char* name;
+	int64_t start;
+
+public:
+
+	explicit TraceScope(const char* name) : name(name), start(traceEnabled.load(std::memory_order_relaxed) ? traceNow() : -1) {}
+
+	~TraceScope() {
+		if (start >= 0)
+			recordTraceEvent(name, start, traceNow());
+	}
+
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+};
+
+
+#define TRACE_CONCATENATE_(a, b) a##b
+#define TRACE_CONCATENATE(a, b) TRACE_CONCATENATE_(a, b)
+
+// Mark the rest of the enclosing scope, e.g. TRACE_SCOPE("draw")
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCATENATE(traceScope, __LINE__)(name)
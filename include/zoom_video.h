@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "helpers.h"
+
+
+// Point of a zoom path: the view at the given time (seconds)
+// A keyframe file has one keyframe per line, sorted by time, lines starting with '#' are comments:
+// time x y zoom [maxIterations]
+
+struct zoomKeyframe {
+	double time;
+	coord center;
+	double zoom;
+	int maxIterations;
+};
+
+
+// Read the keyframes of a keyframe file, keyframes without an iteration count use defaultIterations
+
+bool readKeyframes(const char* path, const int& defaultIterations, std::vector<zoomKeyframe>& keyframes);
+
+// View at a time of the path: the zoom is interpolated exponentially and the center so that it moves
+// at a constant speed on the screen, the iteration count is interpolated geometrically
+
+viewState interpolateKeyframes(const std::vector<zoomKeyframe>& keyframes, const double& time, const int& width, const int& height);
+
+// Render the frame sequence of a keyframe file, reusing pixels of deeper frames wherever they cover a frame
+
+int runZoomVideo(const std::vector<std::string>& args);
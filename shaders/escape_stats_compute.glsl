@@ -0,0 +1,108 @@
+#version 460 core
+
+layout(local_size_x = 256) in;
+
+// Quarter octave bins of (iteration + 1) (must match src/escape_stats.cpp)
+const uint ESCAPE_HISTOGRAM_BINS = 128;
+
+uniform uint pixelCount;
+uniform uint maxIterations;
+
+struct PixelState {
+	dvec2 z;
+	dvec2 dz;
+	uint iteration;
+	uint escaped;
+	uint supersampleGeneration;
+	uint supersampledColor;
+	uint period;
+	uint atomPeriod;
+	float atomMagnitude;
+	float contraction;
+};
+
+layout(std430, binding = 0) readonly buffer PixelStates {
+	PixelState pixels[];
+};
+
+// Reset by the CPU before every frame (lowestIteration to 0xFFFFFFFF, everything else to 0)
+layout(std430, binding = 5) buffer EscapeStatistics {
+	uint totalLow;
+	uint totalHigh;
+	uint escapedPixels;
+	uint maxedPixels;
+	uint lowestIteration;
+	uint highestIteration;
+	uint bins[ESCAPE_HISTOGRAM_BINS];
+};
+
+// Every work group reduces its pixels in shared memory, then adds them to the buffer with a few atomics
+shared uint localTotalLow;
+shared uint localTotalHigh;
+shared uint localEscaped;
+shared uint localMaxed;
+shared uint localLowest;
+shared uint localHighest;
+shared uint localBins[ESCAPE_HISTOGRAM_BINS];
+
+
+uint escapeHistogramBin(uint iteration){
+	uint value = min(iteration, 0xFFFFFFFEu) + 1;
+	int octave = findMSB(value);
+	uint quarter = (octave >= 2) ? (value >> (octave - 2)) & 3u : (value << (2 - octave)) & 3u;
+	return uint(octave) * 4 + quarter;
+}
+
+
+// Add to a 64-bit count kept as two words
+void addTotal(uint iterations){
+	uint low = atomicAdd(localTotalLow, iterations);
+	if(low > 0xFFFFFFFFu - iterations)
+		atomicAdd(localTotalHigh, 1u);
+}
+
+
+void main(){
+	uint local = gl_LocalInvocationID.x;
+	if(local < ESCAPE_HISTOGRAM_BINS)
+		localBins[local] = 0;
+	if(local == 0){
+		localTotalLow = 0;
+		localTotalHigh = 0;
+		localEscaped = 0;
+		localMaxed = 0;
+		localLowest = 0xFFFFFFFFu;
+		localHighest = 0;
+	}
+	barrier();
+
+	uint index = gl_GlobalInvocationID.x;
+	if(index < pixelCount){
+		uint iteration = pixels[index].iteration;
+		addTotal(iteration);
+		atomicMin(localLowest, iteration);
+		atomicMax(localHighest, iteration);
+
+		if(pixels[index].escaped != 0){
+			atomicAdd(localEscaped, 1u);
+			atomicAdd(localBins[escapeHistogramBin(iteration)], 1u);
+		}
+		// Pixels proven to be interior stopped early, they count as maxed like the pixels that reached the limit
+		else if(iteration >= maxIterations || pixels[index].period != 0)
+			atomicAdd(localMaxed, 1u);
+	}
+	barrier();
+
+	if(local < ESCAPE_HISTOGRAM_BINS && localBins[local] != 0)
+		atomicAdd(bins[local], localBins[local]);
+	if(local == 0){
+		uint low = atomicAdd(totalLow, localTotalLow);
+		if(low > 0xFFFFFFFFu - localTotalLow)
+			atomicAdd(totalHigh, 1u);
+		atomicAdd(totalHigh, localTotalHigh);
+		atomicAdd(escapedPixels, localEscaped);
+		atomicAdd(maxedPixels, localMaxed);
+		atomicMin(lowestIteration, localLowest);
+		atomicMax(highestIteration, localHighest);
+	}
+}
@@ -0,0 +1,90 @@
+#version 460 core
+
+// Reprojection of a frame of a zoom from the exponential map strip:
+// every pixel looks up the strip at its angle and the logarithm of its distance to the zoom center
+
+out vec4 FragColor;
+in vec4 gl_FragCoord;
+
+uniform uvec2 windowResolution;
+
+// Natural logarithm of the zoom of the frame (the zoom itself can exceed the range of a float)
+uniform float logZoom;
+
+uniform float logOuterRadius;
+uniform float logStep;
+uniform uint stripWidth;
+uniform uint stripHeight;
+
+// The strip is uploaded in layers of layerRows rows, a layer is kept in slot (layer % ringSize)
+uniform sampler2DArray strip;
+uniform uint layerRows;
+uniform uint ringSize;
+
+uniform sampler1D palette;
+uniform float paletteCycle;
+
+const float PI = 3.14159265358979;
+
+
+float stripValue(int column, int row){
+	column = (column + int(stripWidth)) % int(stripWidth);
+	row = clamp(row, 0, int(stripHeight) - 1);
+	uint layer = uint(row) / layerRows;
+	return texelFetch(strip, ivec3(column, uint(row) % layerRows, layer % ringSize), 0).r;
+}
+
+
+// Bilinear interpolation of the continuous iteration count, interior samples win over exterior ones
+float sampleStrip(vec2 position){
+	ivec2 base = ivec2(floor(position));
+	vec2 fraction = position - vec2(base);
+
+	float values[4] = float[4](
+		stripValue(base.x, base.y), stripValue(base.x + 1, base.y),
+		stripValue(base.x, base.y + 1), stripValue(base.x + 1, base.y + 1)
+	);
+
+	float weights[4] = float[4](
+		(1 - fraction.x) * (1 - fraction.y), fraction.x * (1 - fraction.y),
+		(1 - fraction.x) * fraction.y, fraction.x * fraction.y
+	);
+
+	float interiorWeight = 0.0, sum = 0.0;
+	for(int i = 0; i < 4; ++i){
+		if(values[i] < 0)
+			interiorWeight += weights[i];
+		else
+			sum += weights[i] * values[i];
+	}
+
+	return (interiorWeight >= 0.5) ? -1.0 : sum / (1 - interiorWeight);
+}
+
+
+vec4 map_to_color(float t) {
+	return vec4(texture(palette, t).rgb, 1.0);
+}
+
+
+void main(){
+	float aspectRatio = float(windowResolution.x) / windowResolution.y;
+
+	// Offset from the zoom center before dividing by the zoom, the division happens in log space
+	vec2 offset = (gl_FragCoord.xy / vec2(windowResolution) - 0.5) * vec2(4 * aspectRatio, 4);
+
+	float logRadius = log(max(length(offset), 1e-30)) - logZoom;
+	float angle = atan(offset.y, offset.x);
+	if(angle < 0)
+		angle += 2 * PI;
+
+	vec2 position = vec2(angle / (2 * PI) * stripWidth, (logOuterRadius - logRadius) / logStep) - 0.5;
+
+	if(position.y < -0.5){
+		FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+		return;
+	}
+
+	float iteration = sampleStrip(position);
+	FragColor = (iteration < 0) ? vec4(0.0, 0.0, 0.0, 1.0) : map_to_color(iteration / paletteCycle);
+}
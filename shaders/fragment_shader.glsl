@@ -1,5 +1,8 @@
 #version 460 core
 
+// Subgroup sums cut the atomics of the iteration counter to one per subgroup where the driver supports them
+#extension GL_KHR_shader_subgroup_arithmetic : enable
+
 out vec4 FragColor;
 in vec4 gl_FragCoord;
 
@@ -7,20 +10,221 @@ uniform uvec2 windowResolution;
 uniform dvec2 off;
 uniform double zoom;
 uniform uint maxIterations;
+uniform uint iterationsPerFrame;
+
+// Coloring: 0 -> the palette repeats every paletteCycle iterations, 1 -> histogram equalized
+uniform sampler1D palette;
+uniform float paletteCycle;
+uniform uint coloringMode;
+
+// Distance estimation: 1 -> the derivative dz/dc is tracked and escaped pixels near the boundary are darkened
+// The pixel states must be reset when it changes, the derivative of a resumed iteration is only valid if it was tracked from the start
+uniform uint distanceEstimation;
+
+// Interior detection: 1 -> pixels proven to be inside the set stop iterating and keep the period of their attracting cycle
+// Period coloring: 1 -> those pixels are colored by their period instead of black
+uniform uint interiorDetection;
+uniform uint periodColoring;
+
+// A large escape radius makes the continuous iteration count smooth
+const double ESCAPE_RADIUS_SQUARED = 256.0;
+
+// Logarithmic binning of the histogram (must match the histogram compute shader)
+const uint HISTOGRAM_BINS = 8192;
+const float BINS_PER_OCTAVE = 256.0;
+
+// Distance to the boundary in pixels below which distance coloring darkens a pixel (DISTANCE_SHADING_PIXELS of mandelbrot.h)
+const float DISTANCE_SHADING_PIXELS = 2.0;
+
+// Interior detection and period coloring (the INTERIOR_ constants and PERIOD_PALETTE_STEP of mandelbrot.h)
+const uint INTERIOR_NEWTON_STEPS = 8;
+const double INTERIOR_CONTRACTION = 1e-4;
+const double INTERIOR_REPELLING = 4.0;
+const double INTERIOR_PRECISION = 1e-13;
+const float PERIOD_PALETTE_STEP = 0.618034;
+
+// Returned by attractingCycle when its next pass over the cycle does not fit in the iterations left in the frame
+const double INTERIOR_DEFERRED = -2.0;
+
+
+// Iteration state of a pixel, kept between frames so that high iteration counts can be spread over several frames
+// dz holds dz/dc while iterating with distance estimation, and the interior distance estimate in x once the pixel has a period
+// atomPeriod and atomMagnitude are the iteration and |z|^2 of the smallest |z| so far (the atom domain), contraction
+// is |d z / d z|^2 since the last interior check
+struct PixelState {
+	dvec2 z;
+	dvec2 dz;
+	uint iteration;
+	uint escaped;
+	uint supersampleGeneration;
+	uint supersampledColor;
+	uint period;
+	uint atomPeriod;
+	float atomMagnitude;
+	float contraction;
+};
+
+layout(std430, binding = 0) buffer PixelStates {
+	PixelState pixels[];
+};
+
+// Cumulative distribution of the continuous iteration counts, computed after the previous frame
+layout(std430, binding = 2) readonly buffer HistogramCdf {
+	uint cdf[HISTOGRAM_BINS];
+};
+
+// Iterations done during the frame for the performance overlay, a 64 bit count stored as two words
+// Only updated when countIterations is set, so that the atomics cost nothing while the overlay is hidden (the default)
+uniform uint countIterations;
+
+layout(std430, binding = 4) buffer IterationCounter {
+	uint iterationsLow;
+	uint iterationsHigh;
+};
 
 
 // dvec2(x, y) are the coordinates -> x + y * i is the complex representation 
-int iterateMandelbrot(dvec2 coords){
-	dvec2 z1 = dvec2(0);
-	dvec2 z2 = dvec2(0);
-	int iteration = 0;
-	while(dot(z1, z1) <= 4 && iteration < maxIterations){
+// Resume the iteration from the stored state and advance it by at most iterationsPerFrame steps
+void iterateMandelbrot(dvec2 coords, inout PixelState state){
+	dvec2 z1 = state.z;
+	dvec2 z2 = z1 * z1;
+	uint iteration = state.iteration;
+	uint frameLimit = iteration + min(maxIterations - iteration, iterationsPerFrame);
+	while(z2.x + z2.y <= ESCAPE_RADIUS_SQUARED && iteration < frameLimit){
 		z1.y = 2 * z1.x * z1.y + coords.y;
 		z1.x = z2.x - z2.y + coords.x;
 		z2 = z1 * z1;
 		++iteration;
 	}
-	return iteration;
+	state.z = z1;
+	state.iteration = iteration;
+	state.escaped = uint(z2.x + z2.y > ESCAPE_RADIUS_SQUARED);
+}
+
+
+dvec2 complexMultiply(dvec2 a, dvec2 b){
+	return dvec2(a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
+}
+
+
+dvec2 complexDivide(dvec2 a, dvec2 b){
+	return dvec2(a.x * b.x + a.y * b.y, a.y * b.x - a.x * b.y) / dot(b, b);
+}
+
+
+// Look for an attracting cycle of the given period near the orbit point w (attractingCycle of mandelbrot.cpp): Newton's method
+// solves f^period(w) = w, and the cycle attracts if the derivative of f^period at w is smaller than 1
+// Returns the interior distance estimate and sets period to the exact period of the cycle, or returns -1 if there is no such cycle
+// Every pass over the cycle costs period iterations, taken from budget, and is only started if it fits
+double attractingCycle(dvec2 c, dvec2 w, inout uint period, inout uint budget){
+	bool converged = false;
+	for(uint step = 0; step < INTERIOR_NEWTON_STEPS && !converged; ++step){
+		if(period > budget)
+			return INTERIOR_DEFERRED;
+		budget -= period;
+
+		dvec2 z = w, dz = dvec2(1, 0);
+		for(uint i = 0; i < period; ++i){
+			dz = 2 * complexMultiply(z, dz);
+			z = complexMultiply(z, z) + c;
+		}
+
+		if(dot(dz, dz) > INTERIOR_REPELLING)
+			return -1.0;
+
+		dvec2 delta = complexDivide(z - w, dz - dvec2(1, 0));
+		w -= delta;
+		converged = dot(delta, delta) <= 1e-26 * dot(w, w);
+		if(!(dot(w, w) <= ESCAPE_RADIUS_SQUARED))
+			return -1.0;
+	}
+	if(!converged)
+		return -1.0;
+	if(period > budget)
+		return INTERIOR_DEFERRED;
+	budget -= period;
+
+	dvec2 z = w, dz = dvec2(1, 0), dc = dvec2(0), dzdz = dvec2(0), dcdz = dvec2(0);
+	uint exactPeriod = 0;
+	for(uint i = 0; i < period; ++i){
+		dcdz = 2 * (complexMultiply(z, dcdz) + complexMultiply(dc, dz));
+		dzdz = 2 * (complexMultiply(dz, dz) + complexMultiply(z, dzdz));
+		dc = 2 * complexMultiply(z, dc) + dvec2(1, 0);
+		dz = 2 * complexMultiply(z, dz);
+		z = complexMultiply(z, z) + c;
+
+		if(exactPeriod == 0 && dot(z - w, z - w) <= 1e-12 * dot(w, w))
+			exactPeriod = i + 1;
+	}
+
+	if(!(dot(dz, dz) < 1.0))
+		return -1.0;
+
+	double distance = (1.0 - dot(dz, dz)) / length(dcdz + complexDivide(complexMultiply(dzdz, dc), dvec2(1, 0) - dz));
+	if(!(distance > INTERIOR_PRECISION * length(c)))
+		return -1.0;
+
+	if(exactPeriod != 0)
+		period = exactPeriod;
+	return distance;
+}
+
+
+// Same iteration with the derivative analysis: dz/dc = 2 z dz/dc + 1 with distance estimation, and the interior checks
+// of iterateMandelbrotAnalyzed in mandelbrot.cpp with interior detection
+// The iterations and the Newton passes of the checks share the iterationsPerFrame budget: a check that does not fit in what
+// is left of the frame is left pending, the state before it makes the next frame start with it, and a check that does not
+// even fit in a whole frame is given up like a check that found no cycle
+void iterateMandelbrotAnalyzed(dvec2 coords, inout PixelState state){
+	dvec2 z1 = state.z;
+	dvec2 z2 = z1 * z1;
+	dvec2 dz = state.dz;
+	double contraction = state.contraction;
+	uint iteration = state.iteration;
+	uint budget = iterationsPerFrame;
+	bool checkDue = interiorDetection != 0 && iteration > 0;
+	while(true){
+		if(checkDue){
+			bool newDomain = state.atomPeriod == 0 || z2.x + z2.y < double(state.atomMagnitude);
+			if(newDomain || contraction < INTERIOR_CONTRACTION){
+				uint period = newDomain ? iteration : state.atomPeriod;
+				bool wholeFrame = budget == iterationsPerFrame;
+				double distance = (contraction < 1.0) ? attractingCycle(coords, z1, period, budget) : -1.0;
+				if(distance == INTERIOR_DEFERRED && !wholeFrame)
+					break;
+				if(distance >= 0.0){
+					state.period = period;
+					dz = dvec2(distance, 0);
+					break;
+				}
+
+				contraction = 1.0;
+				if(newDomain){
+					state.atomPeriod = iteration;
+					state.atomMagnitude = float(z2.x + z2.y);
+				}
+			}
+		}
+
+		if(!(z2.x + z2.y <= ESCAPE_RADIUS_SQUARED && iteration < maxIterations && budget > 0))
+			break;
+
+		if(distanceEstimation != 0)
+			dz = 2 * complexMultiply(z1, dz) + dvec2(1, 0);
+		if(interiorDetection != 0)
+			contraction *= 4 * (z2.x + z2.y);
+		z1.y = 2 * z1.x * z1.y + coords.y;
+		z1.x = z2.x - z2.y + coords.x;
+		z2 = z1 * z1;
+		++iteration;
+		--budget;
+		checkDue = interiorDetection != 0;
+	}
+	state.z = z1;
+	state.dz = dz;
+	state.contraction = float(min(contraction, 1e30));
+	state.iteration = iteration;
+	state.escaped = uint(z2.x + z2.y > ESCAPE_RADIUS_SQUARED);
 }
 
 
@@ -32,12 +236,37 @@ dvec2 fragNormalizeCoords(dvec2 fragCoords, dvec2 initialAxisLen){
 }
 
 
+// Continuous (normalized) iteration count of an escaped pixel, independent of the iteration budget
+float smoothIteration(PixelState state){
+	float logZn = log(float(dot(state.z, state.z))) / 2;
+	return max(float(state.iteration) + 1 - log2(logZn / log(2.0)), 0.0);
+}
+
+
+// Fraction of the escaped pixels with a lower continuous iteration count, interpolated inside the bin
+float equalizedPosition(float iteration){
+	float position = log2(iteration + 1) * BINS_PER_OCTAVE;
+	uint bin = min(uint(position), HISTOGRAM_BINS - 1);
+	float below = (bin > 0) ? float(cdf[bin - 1]) : 0.0;
+	float fraction = (bin < HISTOGRAM_BINS - 1) ? fract(position) : 1.0;
+	return (below + fraction * (float(cdf[bin]) - below)) / max(float(cdf[HISTOGRAM_BINS - 1]), 1.0);
+}
+
+
 vec4 map_to_color(float t) {
-    float r = 9.0 * (1.0 - t) * t * t * t;
-    float g = 15.0 * (1.0 - t) * (1.0 - t) * t * t;
-    float b = 8.5 * (1.0 - t) * (1.0 - t) * (1.0 - t) * t;
+	return vec4(texture(palette, t).rgb, 1.0);
+}
+
+
+// Distance estimate of a pixel in pixels: |z| log|z| / |dz/dc| divided by the pixel size for an escaped pixel,
+// the interior distance for a pixel with a period
+float distancePixels(PixelState state){
+	double pixelSize = 4.0 / zoom / windowResolution.y;
+	if(state.period != 0)
+		return float(state.dz.x / pixelSize);
 
-    return vec4(r, g, b, 1.0);
+	double magnitude = length(state.z);
+	return float(magnitude * log(float(magnitude)) / (length(state.dz) * pixelSize));
 }
 
 
@@ -47,9 +276,55 @@ void main(){
 	
 	dvec2 fragNormalizedCoords = fragNormalizeCoords(gl_FragCoord.xy, dvec2(4 * aspectRatio, 4));
 
-	int iterations = iterateMandelbrot(fragNormalizedCoords);
+	uint index = uint(gl_FragCoord.y) * windowResolution.x + uint(gl_FragCoord.x);
+	PixelState state = pixels[index];
+
+	if(state.escaped == 0 && state.period == 0 && state.iteration < maxIterations){
+		uint previousIteration = state.iteration;
+		if(distanceEstimation != 0 || interiorDetection != 0)
+			iterateMandelbrotAnalyzed(fragNormalizedCoords, state);
+		else
+			iterateMandelbrot(fragNormalizedCoords, state);
+		pixels[index] = state;
+
+		// Helper invocations are left out, their writes to the counter would be discarded
+		if(countIterations != 0 && !gl_HelperInvocation){
+			uint done = state.iteration - previousIteration;
+			uint carry = 0;
+#ifdef GL_KHR_shader_subgroup_arithmetic
+			// The sum of the subgroup as a double, which holds it exactly whatever the subgroup size, split into the two words
+			double subgroupDone = subgroupAdd(double(done));
+			done = uint(mod(subgroupDone, 4294967296.0));
+			carry = uint(floor(subgroupDone / 4294967296.0));
+			if(subgroupElect())
+#endif
+			{
+				uint low = atomicAdd(iterationsLow, done);
+				if(low > 0xFFFFFFFFu - done)
+					++carry;
+				if(carry != 0)
+					atomicAdd(iterationsHigh, carry);
+			}
+		}
+	}
 	
-	float ratio = float(iterations) / maxIterations;
+	// Pixels that are still iterating are drawn like the interior of the set until they escape
+	if(state.escaped == 0 && (state.period == 0 || periodColoring == 0)){
+		FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+		return;
+	}
+
+	if(state.escaped == 0){
+		FragColor = map_to_color(fract(float(state.period) * PERIOD_PALETTE_STEP));
+		if(distanceEstimation != 0)
+			FragColor.rgb *= sqrt(clamp(distancePixels(state) / DISTANCE_SHADING_PIXELS, 0.0, 1.0));
+		return;
+	}
+
+	float iteration = smoothIteration(state);
+	float t = (coloringMode == 1) ? equalizedPosition(iteration) : iteration / paletteCycle;
 	
-	FragColor = map_to_color(ratio);
+	FragColor = map_to_color(t);
+	if(distanceEstimation != 0)
+		FragColor.rgb *= sqrt(clamp(distancePixels(state) / DISTANCE_SHADING_PIXELS, 0.0, 1.0));
 }
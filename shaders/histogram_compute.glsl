@@ -0,0 +1,48 @@
+#version 460 core
+
+layout(local_size_x = 256) in;
+
+// Continuous iteration counts are binned logarithmically so that the same number of bins
+// covers both shallow views and budgets in the millions (must match the fragment shader)
+const uint HISTOGRAM_BINS = 8192;
+const float BINS_PER_OCTAVE = 256.0;
+const double ESCAPE_RADIUS_SQUARED = 256.0;
+
+uniform uint pixelCount;
+
+struct PixelState {
+	dvec2 z;
+	dvec2 dz;
+	uint iteration;
+	uint escaped;
+	uint supersampleGeneration;
+	uint supersampledColor;
+	uint period;
+	uint atomPeriod;
+	float atomMagnitude;
+	float contraction;
+};
+
+layout(std430, binding = 0) readonly buffer PixelStates {
+	PixelState pixels[];
+};
+
+layout(std430, binding = 1) buffer Histogram {
+	uint bins[HISTOGRAM_BINS];
+};
+
+
+float smoothIteration(PixelState state){
+	float logZn = log(float(dot(state.z, state.z))) / 2;
+	return max(float(state.iteration) + 1 - log2(logZn / log(2.0)), 0.0);
+}
+
+
+void main(){
+	uint index = gl_GlobalInvocationID.x;
+	if(index >= pixelCount || pixels[index].escaped == 0)
+		return;
+
+	float position = log2(smoothIteration(pixels[index]) + 1) * BINS_PER_OCTAVE;
+	atomicAdd(bins[min(uint(position), HISTOGRAM_BINS - 1)], 1);
+}
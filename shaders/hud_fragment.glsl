@@ -0,0 +1,45 @@
+#version 460 core
+
+out vec4 FragColor;
+in vec4 gl_FragCoord;
+
+uniform uint windowHeight;
+
+// Size of the text in characters and screen pixels per font pixel
+uniform uint columns;
+uniform uint lines;
+uniform uint scale;
+
+// Glyph index of every character (one texel per character, first line at the top) and the glyphs side by side
+uniform usampler2D text;
+uniform sampler2D font;
+
+// Glyph size and the cell it is drawn in, in font pixels (the glyph size must match src/performance_hud.cpp)
+const ivec2 GLYPH_SIZE = ivec2(5, 7);
+const ivec2 CELL_SIZE = ivec2(6, 9);
+const int MARGIN = 3;
+
+const vec4 BACKGROUND_COLOR = vec4(0.0, 0.0, 0.0, 0.6);
+const vec4 TEXT_COLOR = vec4(1.0, 1.0, 1.0, 1.0);
+
+
+void main(){
+	// Position in font pixels from the top left corner of the window
+	ivec2 position = ivec2(int(gl_FragCoord.x), int(windowHeight) - 1 - int(gl_FragCoord.y)) / int(max(scale, 1u));
+
+	ivec2 panelSize = ivec2(columns, lines) * CELL_SIZE + 2 * MARGIN;
+	if(any(greaterThanEqual(position, panelSize)))
+		discard;
+
+	ivec2 inside = position - MARGIN;
+	ivec2 cell = inside / CELL_SIZE;
+	ivec2 glyphPixel = inside - cell * CELL_SIZE;
+
+	float ink = 0.0;
+	if(all(greaterThanEqual(inside, ivec2(0))) && all(lessThan(cell, ivec2(columns, lines))) && all(lessThan(glyphPixel, GLYPH_SIZE))){
+		uint glyph = texelFetch(text, cell, 0).r;
+		ink = texelFetch(font, ivec2(int(glyph) * GLYPH_SIZE.x + glyphPixel.x, glyphPixel.y), 0).r;
+	}
+
+	FragColor = mix(BACKGROUND_COLOR, TEXT_COLOR, ink);
+}
@@ -0,0 +1,47 @@
+#version 460 core
+
+// A single work group scans the whole histogram, every invocation owns BINS_PER_INVOCATION consecutive bins
+layout(local_size_x = 1024) in;
+
+const uint HISTOGRAM_BINS = 8192;
+const uint BINS_PER_INVOCATION = HISTOGRAM_BINS / 1024;
+
+layout(std430, binding = 1) readonly buffer Histogram {
+	uint bins[HISTOGRAM_BINS];
+};
+
+layout(std430, binding = 2) writeonly buffer HistogramCdf {
+	uint cdf[HISTOGRAM_BINS];
+};
+
+shared uint partialSums[1024];
+
+
+void main(){
+	uint invocation = gl_LocalInvocationID.x;
+	uint first = invocation * BINS_PER_INVOCATION;
+
+	// Sequential scan over the bins owned by this invocation
+
+	uint localSums[BINS_PER_INVOCATION];
+	uint sum = 0;
+	for(uint i = 0; i < BINS_PER_INVOCATION; ++i){
+		sum += bins[first + i];
+		localSums[i] = sum;
+	}
+	partialSums[invocation] = sum;
+	barrier();
+
+	// Inclusive Hillis-Steele scan over the per invocation totals
+
+	for(uint offset = 1; offset < 1024; offset *= 2){
+		uint value = (invocation >= offset) ? partialSums[invocation - offset] : 0;
+		barrier();
+		partialSums[invocation] += value;
+		barrier();
+	}
+
+	uint before = (invocation > 0) ? partialSums[invocation - 1] : 0;
+	for(uint i = 0; i < BINS_PER_INVOCATION; ++i)
+		cdf[first + i] = before + localSums[i];
+}
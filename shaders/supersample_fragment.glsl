@@ -0,0 +1,392 @@
+#version 460 core
+
+// Post-pass drawn over the image once it has converged: pixels whose continuous iteration count varies strongly
+// against their neighbors are supersampled with the configured pattern, all other pixels are discarded
+// The samples of a pixel are iterated one after the other and resumed from frame to frame like the pixels of the fragment
+// shader, so no pixel iterates more than iterationsPerFrame times in a frame; it keeps its single sample until all are done
+// With distance estimation the escaped pixels are chosen by their distance to the boundary instead: the pixels far from it
+// keep their single sample and the pixels close to it, where the filaments are, take the whole pattern
+
+out vec4 FragColor;
+in vec4 gl_FragCoord;
+
+uniform uvec2 windowResolution;
+uniform dvec2 off;
+uniform double zoom;
+uniform uint maxIterations;
+uniform uint iterationsPerFrame;
+
+uniform sampler1D palette;
+uniform float paletteCycle;
+uniform uint coloringMode;
+
+// Distance estimation: 1 -> the samples are darkened near the boundary and the escaped pixels are chosen by their distance
+uniform uint distanceEstimation;
+
+// Interior detection and period coloring of the fragment shader, for the samples and the interior pixels
+uniform uint interiorDetection;
+uniform uint periodColoring;
+
+// Sample offsets in pixels relative to the pixel center
+uniform vec2 sampleOffsets[16];
+uniform uint sampleCount;
+
+// Variance of log2(continuous iteration count + 1) in the 3x3 neighborhood above which a pixel is an edge
+uniform float edgeThreshold;
+
+// Supersampled colors are only reused if they were computed with the current coloring settings
+uniform uint supersampleGeneration;
+
+// Maximum amount of work (in thousands of iterations) spent on supersampling per frame, a pixel is charged for what it may
+// iterate in the frame before it starts
+uniform uint costBudget;
+
+const double ESCAPE_RADIUS_SQUARED = 256.0;
+
+const uint HISTOGRAM_BINS = 8192;
+const float BINS_PER_OCTAVE = 256.0;
+
+// Value used for interior pixels when comparing neighbors
+const float INTERIOR = -1.0;
+
+// Distance to the boundary in pixels below which distance coloring darkens a sample and an escaped pixel is supersampled
+const float DISTANCE_SHADING_PIXELS = 2.0;
+
+const uint INTERIOR_NEWTON_STEPS = 8;
+const double INTERIOR_CONTRACTION = 1e-4;
+const double INTERIOR_REPELLING = 4.0;
+const double INTERIOR_PRECISION = 1e-13;
+const float PERIOD_PALETTE_STEP = 0.618034;
+const double INTERIOR_DEFERRED = -2.0;
+
+
+struct PixelState {
+	dvec2 z;
+	dvec2 dz;
+	uint iteration;
+	uint escaped;
+	uint supersampleGeneration;
+	uint supersampledColor;
+	uint period;
+	uint atomPeriod;
+	float atomMagnitude;
+	float contraction;
+};
+
+layout(std430, binding = 0) buffer PixelStates {
+	PixelState pixels[];
+};
+
+layout(std430, binding = 2) readonly buffer HistogramCdf {
+	uint cdf[HISTOGRAM_BINS];
+};
+
+layout(std430, binding = 3) buffer SupersampleCost {
+	uint spentCost;
+};
+
+// Progress of the supersampling of a pixel: the iteration state of the sample being iterated (as in PixelState), the index
+// of that sample and the sums of the colors of the samples done so far, 16 bits per channel
+// Only valid if generation is the current supersampleGeneration, which changes with the coloring settings and the view
+struct SampleState {
+	dvec2 z;
+	dvec2 dz;
+	uint iteration;
+	uint sampleIndex;
+	uint generation;
+	uint atomPeriod;
+	float atomMagnitude;
+	float contraction;
+	uint colorSum[2];
+};
+
+layout(std430, binding = 6) buffer SampleStates {
+	SampleState samples[];
+};
+
+
+dvec2 complexMultiply(dvec2 a, dvec2 b){
+	return dvec2(a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
+}
+
+
+dvec2 complexDivide(dvec2 a, dvec2 b){
+	return dvec2(a.x * b.x + a.y * b.y, a.y * b.x - a.x * b.y) / dot(b, b);
+}
+
+
+// Attracting cycle of the given period near w, same as in the fragment shader with the same budget
+double attractingCycle(dvec2 c, dvec2 w, inout uint period, inout uint budget){
+	bool converged = false;
+	for(uint step = 0; step < INTERIOR_NEWTON_STEPS && !converged; ++step){
+		if(period > budget)
+			return INTERIOR_DEFERRED;
+		budget -= period;
+
+		dvec2 z = w, dz = dvec2(1, 0);
+		for(uint i = 0; i < period; ++i){
+			dz = 2 * complexMultiply(z, dz);
+			z = complexMultiply(z, z) + c;
+		}
+
+		if(dot(dz, dz) > INTERIOR_REPELLING)
+			return -1.0;
+
+		dvec2 delta = complexDivide(z - w, dz - dvec2(1, 0));
+		w -= delta;
+		converged = dot(delta, delta) <= 1e-26 * dot(w, w);
+		if(!(dot(w, w) <= ESCAPE_RADIUS_SQUARED))
+			return -1.0;
+	}
+	if(!converged)
+		return -1.0;
+	if(period > budget)
+		return INTERIOR_DEFERRED;
+	budget -= period;
+
+	dvec2 z = w, dz = dvec2(1, 0), dc = dvec2(0), dzdz = dvec2(0), dcdz = dvec2(0);
+	uint exactPeriod = 0;
+	for(uint i = 0; i < period; ++i){
+		dcdz = 2 * (complexMultiply(z, dcdz) + complexMultiply(dc, dz));
+		dzdz = 2 * (complexMultiply(dz, dz) + complexMultiply(z, dzdz));
+		dc = 2 * complexMultiply(z, dc) + dvec2(1, 0);
+		dz = 2 * complexMultiply(z, dz);
+		z = complexMultiply(z, z) + c;
+
+		if(exactPeriod == 0 && dot(z - w, z - w) <= 1e-12 * dot(w, w))
+			exactPeriod = i + 1;
+	}
+
+	if(!(dot(dz, dz) < 1.0))
+		return -1.0;
+
+	double distance = (1.0 - dot(dz, dz)) / length(dcdz + complexDivide(complexMultiply(dzdz, dc), dvec2(1, 0) - dz));
+	if(!(distance > INTERIOR_PRECISION * length(c)))
+		return -1.0;
+
+	if(exactPeriod != 0)
+		period = exactPeriod;
+	return distance;
+}
+
+
+// Resume the iteration of a sample with the derivative analysis of the fragment shader, the iterations and the interior checks
+// take from budget like in iterateMandelbrotAnalyzed, returns true once the sample is done: escaped, at maxIterations or with
+// a period; dz holds dz/dc with distance estimation, and the interior distance in x for a sample with a period
+bool iterateSample(dvec2 coords, inout SampleState state, inout uint budget, out uint period){
+	dvec2 z1 = state.z;
+	dvec2 z2 = z1 * z1;
+	dvec2 dz = state.dz;
+	uint iteration = state.iteration;
+	period = 0;
+
+	uint atomPeriod = state.atomPeriod;
+	double atomMagnitude = state.atomMagnitude, contraction = state.contraction;
+
+	bool checkDue = interiorDetection != 0 && iteration > 0;
+	while(true){
+		if(checkDue){
+			bool newDomain = atomPeriod == 0 || z2.x + z2.y < atomMagnitude;
+			if(newDomain || contraction < INTERIOR_CONTRACTION){
+				uint cyclePeriod = newDomain ? iteration : atomPeriod;
+				bool wholeFrame = budget == iterationsPerFrame;
+				double distance = (contraction < 1.0) ? attractingCycle(coords, z1, cyclePeriod, budget) : -1.0;
+				if(distance == INTERIOR_DEFERRED && !wholeFrame){
+					budget = 0;
+					break;
+				}
+				if(distance >= 0.0){
+					period = cyclePeriod;
+					dz = dvec2(distance, 0);
+					break;
+				}
+
+				contraction = 1.0;
+				if(newDomain){
+					atomPeriod = iteration;
+					atomMagnitude = z2.x + z2.y;
+				}
+			}
+		}
+
+		if(!(z2.x + z2.y <= ESCAPE_RADIUS_SQUARED && iteration < maxIterations && budget > 0))
+			break;
+
+		if(distanceEstimation != 0)
+			dz = 2 * complexMultiply(z1, dz) + dvec2(1, 0);
+		if(interiorDetection != 0)
+			contraction *= 4 * (z2.x + z2.y);
+		z1.y = 2 * z1.x * z1.y + coords.y;
+		z1.x = z2.x - z2.y + coords.x;
+		z2 = z1 * z1;
+		++iteration;
+		--budget;
+		checkDue = interiorDetection != 0;
+	}
+
+	state.z = z1;
+	state.dz = dz;
+	state.iteration = iteration;
+	state.atomPeriod = atomPeriod;
+	state.atomMagnitude = float(atomMagnitude);
+	state.contraction = float(min(contraction, 1e30));
+	return z2.x + z2.y > ESCAPE_RADIUS_SQUARED || period != 0 || iteration >= maxIterations;
+}
+
+
+dvec2 fragNormalizeCoords(dvec2 fragCoords, dvec2 initialAxisLen){
+	return dvec2(
+		 (fragCoords.x / windowResolution.x - 0.5) * (initialAxisLen.x / zoom) + off.x,
+		 (fragCoords.y / windowResolution.y - 0.5) * (initialAxisLen.y / zoom) + off.y
+	);
+}
+
+
+float smoothIteration(dvec2 z, uint iteration){
+	float logZn = log(float(dot(z, z))) / 2;
+	return max(float(iteration) + 1 - log2(logZn / log(2.0)), 0.0);
+}
+
+
+float equalizedPosition(float iteration){
+	float position = log2(iteration + 1) * BINS_PER_OCTAVE;
+	uint bin = min(uint(position), HISTOGRAM_BINS - 1);
+	float below = (bin > 0) ? float(cdf[bin - 1]) : 0.0;
+	float fraction = (bin < HISTOGRAM_BINS - 1) ? fract(position) : 1.0;
+	return (below + fraction * (float(cdf[bin]) - below)) / max(float(cdf[HISTOGRAM_BINS - 1]), 1.0);
+}
+
+
+vec4 map_to_color(float t) {
+	return vec4(texture(palette, t).rgb, 1.0);
+}
+
+
+// Distance estimate in pixels (mandelbrot.cpp and the fragment shader use the same estimates), exterior for an escaped point
+// and interior (stored in dz.x) for a point with a period
+float distancePixels(dvec2 z, dvec2 dz, uint period){
+	double pixelSize = 4.0 / zoom / windowResolution.y;
+	if(period != 0)
+		return float(dz.x / pixelSize);
+
+	double magnitude = length(z);
+	return float(magnitude * log(float(magnitude)) / (length(dz) * pixelSize));
+}
+
+
+// Color of a finished sample
+vec4 sampleColor(SampleState state, uint period){
+	dvec2 z = state.z, dz = state.dz;
+	vec4 color;
+	if(dot(z, z) > ESCAPE_RADIUS_SQUARED){
+		float smoothed = smoothIteration(z, state.iteration);
+		color = map_to_color((coloringMode == 1) ? equalizedPosition(smoothed) : smoothed / paletteCycle);
+	}
+	else if(period != 0 && periodColoring != 0)
+		color = map_to_color(fract(float(period) * PERIOD_PALETTE_STEP));
+	else
+		return vec4(0.0, 0.0, 0.0, 1.0);
+
+	if(distanceEstimation != 0)
+		color.rgb *= sqrt(clamp(distancePixels(z, dz, period) / DISTANCE_SHADING_PIXELS, 0.0, 1.0));
+	return color;
+}
+
+
+// With period coloring the interior components of different periods have different colors, their values differ
+float neighborValue(ivec2 pixel){
+	pixel = clamp(pixel, ivec2(0), ivec2(windowResolution) - 1);
+	PixelState state = pixels[pixel.y * windowResolution.x + pixel.x];
+	if(state.escaped != 0)
+		return log2(smoothIteration(state.z, state.iteration) + 1);
+	return (periodColoring != 0) ? INTERIOR - float(state.period) : INTERIOR;
+}
+
+
+bool isEdge(ivec2 pixel){
+	// The distance estimate of a colored pixel tells directly whether the boundary is near
+	if(distanceEstimation != 0){
+		PixelState state = pixels[pixel.y * windowResolution.x + pixel.x];
+		if(state.escaped != 0 || (state.period != 0 && periodColoring != 0))
+			return distancePixels(state.z, state.dz, state.period) < DISTANCE_SHADING_PIXELS;
+	}
+
+	float values[9];
+	int interiorCount = 0;
+	float mean = 0.0;
+	for(int i = 0; i < 9; ++i){
+		values[i] = neighborValue(pixel + ivec2(i % 3 - 1, i / 3 - 1));
+		interiorCount += int(values[i] <= INTERIOR);
+		mean += values[i] / 9;
+	}
+
+	// The boundary between the interior and the exterior is always an edge, and so is the one between two periods
+	if(interiorCount != 0){
+		for(int i = 1; i < 9; ++i)
+			if(values[i] != values[0])
+				return true;
+		return false;
+	}
+
+	float variance = 0.0;
+	for(int i = 0; i < 9; ++i)
+		variance += (values[i] - mean) * (values[i] - mean) / 9;
+	return variance > edgeThreshold;
+}
+
+
+void main(){
+
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	uint index = pixel.y * windowResolution.x + pixel.x;
+	PixelState state = pixels[index];
+
+	// Reuse the color computed in a previous frame
+	if(state.supersampleGeneration == supersampleGeneration){
+		FragColor = unpackUnorm4x8(state.supersampledColor);
+		return;
+	}
+
+	if(!isEdge(pixel))
+		discard;
+
+	// Continue the samples where the previous frame stopped, or start with the first one
+	SampleState progress = samples[index];
+	if(progress.generation != supersampleGeneration)
+		progress = SampleState(dvec2(0), dvec2(0), 0, 0, supersampleGeneration, 0, 0.0, 1.0, uint[2](0, 0));
+
+	// Estimate the cost of the remaining samples from the iteration count of the pixel itself, at most what a frame may
+	// iterate, and charge it before starting: the pixel only goes ahead if the budget was not used up before it
+	uint remainingSamples = sampleCount - progress.sampleIndex;
+	uint perSample = (state.escaped != 0 || state.period != 0) ? state.iteration : maxIterations;
+	uint work = (perSample > iterationsPerFrame / remainingSamples) ? iterationsPerFrame : remainingSamples * perSample;
+	if(atomicAdd(spentCost, work / 1000 + 1) >= costBudget)
+		discard;
+
+	float aspectRatio = float(windowResolution.x) / windowResolution.y;
+	uint budget = iterationsPerFrame;
+	while(progress.sampleIndex < sampleCount && budget > 0){
+		dvec2 coords = fragNormalizeCoords(gl_FragCoord.xy + sampleOffsets[progress.sampleIndex], dvec2(4 * aspectRatio, 4));
+		uint period;
+		if(!iterateSample(coords, progress, budget, period))
+			break;
+
+		uvec4 channels = uvec4(round(sampleColor(progress, period) * 255.0));
+		progress.colorSum[0] += channels.r | (channels.g << 16);
+		progress.colorSum[1] += channels.b | (channels.a << 16);
+		progress = SampleState(dvec2(0), dvec2(0), 0, progress.sampleIndex + 1, supersampleGeneration, 0, 0.0, 1.0, progress.colorSum);
+	}
+
+	if(progress.sampleIndex < sampleCount){
+		samples[index] = progress;
+		discard;
+	}
+
+	vec4 color = vec4(progress.colorSum[0] & 0xFFFFu, progress.colorSum[0] >> 16, progress.colorSum[1] & 0xFFFFu, progress.colorSum[1] >> 16);
+	color /= 255.0 * sampleCount;
+
+	pixels[index].supersampleGeneration = supersampleGeneration;
+	pixels[index].supersampledColor = packUnorm4x8(color);
+
+	FragColor = color;
+}
@@ -0,0 +1,228 @@
+#include "batch.h"
+#include "cli.h"
+#include "mandelbrot.h"
+#include "png_writer.h"
+#include "json_writer.h"
+#include "memory_registry.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+
+// Set the default directory the palettes are loaded from and the default manifest
+const char* BATCH_PALETTES_PATH = "./palettes";
+const char* BATCH_MANIFEST_PATH = "./batch_manifest.json";
+
+
+// Outcome of one job, written to the manifest
+
+struct batchResult {
+	bool succeeded;
+	std::string error;
+	double renderSeconds, totalSeconds;
+};
+
+
+bool readBatchJobs(const char* path, std::vector<batchJob>& jobs) {
+	std::ifstream in(path);
+
+	if (!in) {
+		std::cout << "ERROR:BATCH_FILE_COULD_NOT_BE_READ " << path << '\n';
+		return false;
+	}
+
+	std::string line;
+	for (int number = 1; std::getline(in, line); ++number) {
+		// Skip comments and empty lines
+
+		size_t start = line.find_first_not_of(" \t\r");
+		if (start == std::string::npos || line[start] == '#')
+			continue;
+
+		std::istringstream fields(line);
+		batchJob job{ number, {}, {}, {}, DEFAULT_PALETTE_CYCLE };
+
+		if (!(fields >> job.view.off.x >> job.view.off.y >> job.view.zoom >> job.view.maxIterations
+			>> job.view.width >> job.view.height >> job.palette >> job.output)
+			|| job.view.zoom <= 0 || job.view.maxIterations <= 0 || job.view.width <= 0 || job.view.height <= 0) {
+			std::cout << "ERROR:BATCH_JOB_INVALID " << path << ':' << number << '\n';
+			continue;
+		}
+
+		// The palette cycle is optional
+
+		float cycle;
+		if (fields >> cycle && cycle > 0)
+			job.paletteCycle = cycle;
+
+		jobs.push_back(job);
+	}
+
+	return true;
+}
+
+
+static batchResult renderJob(const batchJob& job, const std::vector<std::unique_ptr<Palette>>& palettes, const unsigned& threads) {
+	auto start = std::chrono::steady_clock::now();
+
+	Palette* palette = findPalette(palettes, job.palette);
+	if (palette == nullptr)
+		return { false, "unknown palette " + job.palette, 0.0, 0.0 };
+
+	TrackedMemory memory("batch images", memoryDomain::cpu);
+
+	std::vector<pixelEscape> escapes;
+	renderEscapes(job.view, escapes, threads, true);
+	memory.set((int64_t)(escapes.size() * sizeof(pixelEscape)));
+	auto rendered = std::chrono::steady_clock::now();
+
+	std::vector<unsigned char> rgb;
+	colorEscapes(escapes, *palette, job.paletteCycle, rgb);
+	memory.set((int64_t)(escapes.size() * sizeof(pixelEscape) + rgb.size()));
+
+	std::error_code error;
+	std::filesystem::path parent = std::filesystem::path(job.output).parent_path();
+	if (!parent.empty())
+		std::filesystem::create_directories(parent, error);
+
+	bool written = writePng(job.output.c_str(), rgb.data(), job.view.width, job.view.height);
+	auto finished = std::chrono::steady_clock::now();
+
+	return {
+		written,
+		written ? "" : "image could not be written",
+		std::chrono::duration<double>(rendered - start).count(),
+		std::chrono::duration<double>(finished - start).count()
+	};
+}
+
+
+static void writeManifest(const char* path, const char* jobFile, const std::vector<batchJob>& jobs, const std::vector<batchResult>& results, const unsigned& threads, const double& wallSeconds) {
+	std::ofstream out(path);
+	if (!out) {
+		std::cout << "ERROR:MANIFEST_COULD_NOT_BE_WRITTEN " << path << '\n';
+		return;
+	}
+
+	JsonWriter json(out);
+	json.beginObject();
+	json.key("jobFile");
+	json.value(jobFile);
+	json.key("threads");
+	json.value(threads);
+	json.key("wallSeconds");
+	json.value(wallSeconds);
+
+	size_t failed = 0;
+	json.key("jobs");
+	json.beginArray();
+	for (size_t i = 0; i < jobs.size(); ++i) {
+		const batchJob& job = jobs[i];
+		const batchResult& result = results[i];
+		failed += !result.succeeded;
+
+		json.beginObject();
+		json.key("line");
+		json.value(job.line);
+		json.key("output");
+		json.value(job.output);
+		json.key("x");
+		json.value(job.view.off.x);
+		json.key("y");
+		json.value(job.view.off.y);
+		json.key("zoom");
+		json.value(job.view.zoom);
+		json.key("maxIterations");
+		json.value(job.view.maxIterations);
+		json.key("width");
+		json.value(job.view.width);
+		json.key("height");
+		json.value(job.view.height);
+		json.key("palette");
+		json.value(job.palette);
+		json.key("succeeded");
+		json.value(result.succeeded);
+		if (!result.succeeded) {
+			json.key("error");
+			json.value(result.error);
+		}
+		json.key("renderSeconds");
+		json.value(result.renderSeconds);
+		json.key("totalSeconds");
+		json.value(result.totalSeconds);
+		json.endObject();
+	}
+	json.endArray();
+
+	json.key("succeeded");
+	json.value((uint64_t)(jobs.size() - failed));
+	json.key("failed");
+	json.value((uint64_t)failed);
+	json.endObject();
+}
+
+
+int runBatch(const std::vector<std::string>& args) {
+	std::vector<std::string> positional = getPositional(args);
+	if (positional.size() != 1) {
+		std::cout << "Usage: --batch <job file> [--threads N] [--manifest file] [--palettes directory]\n";
+		return -1;
+	}
+
+	std::string manifestPath = BATCH_MANIFEST_PATH, palettesPath = BATCH_PALETTES_PATH;
+	getOption(args, "--manifest", manifestPath);
+	getOption(args, "--palettes", palettesPath);
+	unsigned threads = getThreadCount(args);
+
+	std::vector<batchJob> jobs;
+	if (!readBatchJobs(positional[0].c_str(), jobs))
+		return -1;
+
+	std::vector<std::unique_ptr<Palette>> palettes = loadPalettes(palettesPath.c_str());
+
+	// Many small jobs run side by side with one thread each, few large jobs split their rows over the threads
+
+	unsigned jobThreads = std::max(1u, threads / (unsigned)std::max<size_t>(jobs.size(), 1));
+	unsigned concurrentJobs = std::max(1u, threads / jobThreads);
+
+	std::vector<batchResult> results(jobs.size());
+	std::atomic<size_t> nextJob(0), finishedJobs(0);
+	std::mutex outputMutex;
+
+	auto start = std::chrono::steady_clock::now();
+
+	auto work = [&]() {
+		for (size_t i = nextJob++; i < jobs.size(); i = nextJob++) {
+			results[i] = renderJob(jobs[i], palettes, jobThreads);
+
+			std::lock_guard<std::mutex> lock(outputMutex);
+			std::cout << '[' << ++finishedJobs << '/' << jobs.size() << "] " << jobs[i].output;
+			if (results[i].succeeded)
+				std::cout << " (" << results[i].totalSeconds << " s)\n";
+			else
+				std::cout << " failed: " << results[i].error << '\n';
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (unsigned i = 1; i < concurrentJobs; ++i)
+		workers.emplace_back(work);
+	work();
+
+	for (std::thread& worker : workers)
+		worker.join();
+
+	double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	writeManifest(manifestPath.c_str(), positional[0].c_str(), jobs, results, threads, wallSeconds);
+
+	bool allSucceeded = std::all_of(results.begin(), results.end(), [](const batchResult& result) { return result.succeeded; });
+	std::cout << "Rendered " << jobs.size() << " jobs in " << wallSeconds << " s, manifest written to " << manifestPath << '\n';
+
+	return allSucceeded ? 0 : 1;
+}
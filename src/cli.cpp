@@ -0,0 +1,220 @@
+#include "cli.h"
+#include "batch.h"
+#include "zoom_video.h"
+#include "exp_map.h"
+#include "export.h"
+#include "raw_iterations.h"
+#include "tile_pyramid.h"
+#include "tile_server.h"
+#include "distributed.h"
+#include "trace.h"
+#include "memory_registry.h"
+
+#include <iostream>
+#include <thread>
+#include <algorithm>
+
+
+// A mode is selected by its name as the first argument, the remaining arguments are passed to it
+
+struct commandLineMode {
+	const char* name;
+	const char* usage;
+	int (*run)(const std::vector<std::string>& args);
+};
+
+static const commandLineMode MODES[] = {
+	{ "--batch", "--batch <job file> [--threads N] [--manifest file] [--palettes directory]", runBatch },
+	{ "--zoom-video", "--zoom-video <keyframe file> <output directory> [--width W] [--height H] [--fps F] [--max-iterations N]"
+		" [--palette name] [--palette-cycle C] [--reuse-ratio R] [--resume] [--threads N]\n"
+		"  --zoom-video <keyframe file> --stream <file | named pipe | -> [--pixel-format rgb24 | yuv420p] [...]", runZoomVideo },
+	{ "--exp-map", "--exp-map render <strip file> <x> <y> <start zoom> <end zoom> [--width W] [--frame-width W] [--frame-height H]"
+		" [--max-iterations N] [--threads N]\n"
+		"  --exp-map frames <strip file> <output directory> <frame count> [--frame-width W] [--frame-height H]"
+		" [--palette name] [--palette-cycle C] [--cpu] [--threads N]", runExpMap },
+	{ "--export", "--export <output.png> <x> <y> <zoom> <width> <height> [--max-iterations N] [--palette name]"
+		" [--palette-cycle C] [--band-memory MB] [--compression L] [--raw file] [--resume] [--threads N]", runExport },
+	{ "--recolor", "--recolor <raw file> <output.png> [--palette name] [--palette-cycle C] [--compression L] [--threads N]", runRecolor },
+	{ "--tiles", "--tiles <output directory> <x> <y> <zoom> <levels> [--tile-size S] [--max-iterations N] [--palette name]"
+		" [--palette-cycle C] [--threads N]", runTilePyramid },
+	{ "--serve", "--serve <x> <y> <zoom> [--port P] [--tile-size S] [--max-iterations N] [--palette name] [--palette-cycle C]"
+		" [--cache-memory MB] [--cache-directory directory] [--threads N]", runTileServer },
+	{ "--coordinate", "--coordinate export <output.png> <x> <y> <zoom> <width> <height> [--band-rows R] [options]\n"
+		"  --coordinate video <keyframe file> <output directory> [--width W] [--height H] [--fps F] [options]\n"
+		"      options: [--max-iterations N] [--palette name] [--palette-cycle C] [--port P] [--listen-all] [--local-workers N] [--threads N]", runCoordinator },
+	{ "--worker", "--worker <coordinator host> <port> [--threads N]", runWorker },
+};
+
+
+// Path the program was started with
+
+static std::string executablePath;
+
+// Options given before the mode
+
+static globalOptions options;
+
+struct globalOption {
+	const char* name;
+	std::string globalOptions::* value;
+};
+
+static const globalOption GLOBAL_OPTIONS[] = {
+	{ "--trace", &globalOptions::tracePath },
+	{ "--stats-log", &globalOptions::statisticsLogPath },
+	{ "--record-input", &globalOptions::recordInputPath },
+	{ "--replay", &globalOptions::replayInputPath },
+	{ "--latency-log", &globalOptions::latencyLogPath },
+	{ "--memory-budget", &globalOptions::memoryBudget },
+	{ "--gpu-memory-budget", &globalOptions::gpuMemoryBudget }
+};
+
+
+static void printUsage() {
+	std::cout << "Usage: mandelbrot-opengl [--trace <file.json>] [--stats-log <file.csv | file.json>] [--record-input <file> | --replay <file>] [--latency-log <file.csv | file.json>]\n"
+		<< "                          [--memory-budget MB] [--gpu-memory-budget MB] [mode]\n"
+		<< "Without a mode the interactive window is opened.\n"
+		<< "--trace records a Chrome trace of the run (any mode or the window) to the file.\n"
+		<< "--stats-log writes the escape statistics of every frame of the window or of --zoom-video to the file.\n"
+		<< "--record-input records the input of the window, --replay replays a recording headlessly frame by frame.\n"
+		<< "--latency-log writes the input to present latency of every input of the window to the file and prints its percentiles.\n"
+		<< "--memory-budget and --gpu-memory-budget bound the memory of the caches and report allocations beyond them.\n\n"
+		<< "Modes:\n";
+	for (const commandLineMode& mode : MODES)
+		std::cout << "  " << mode.usage << '\n';
+}
+
+
+bool runCommandLineMode(int argc, char** argv, int& exitCode) {
+	executablePath = argv[0];
+	std::vector<std::string> args(argv + 1, argv + argc);
+
+	// Options that apply to every mode (or to the window) are removed before the mode is selected
+
+	for (const globalOption& option : GLOBAL_OPTIONS) {
+		std::vector<std::string>::iterator found = std::find(args.begin(), args.end(), option.name);
+		if (found == args.end())
+			continue;
+
+		if (found + 1 == args.end()) {
+			std::cout << "ERROR:INVALID_OPTION_VALUE " << option.name << '\n';
+			exitCode = -1;
+			return true;
+		}
+
+		options.*option.value = *(found + 1);
+		args.erase(found, found + 2);
+	}
+
+	if (!options.tracePath.empty()) {
+		startTracing(options.tracePath.c_str());
+		setTraceThreadName("main");
+	}
+
+	// Budgets in MB, shared by every subsystem of the domain
+
+	const std::pair<const std::string*, memoryDomain> budgets[] = {
+		{ &options.memoryBudget, memoryDomain::cpu },
+		{ &options.gpuMemoryBudget, memoryDomain::gpu }
+	};
+	for (const auto& [value, domain] : budgets) {
+		if (value->empty())
+			continue;
+
+		double megabytes = -1.0;
+		try {
+			megabytes = std::stod(*value);
+		}
+		catch (const std::exception&) {}
+
+		if (megabytes <= 0.0) {
+			std::cout << "ERROR:INVALID_OPTION_VALUE " << (domain == memoryDomain::cpu ? "--memory-budget " : "--gpu-memory-budget ") << *value << '\n';
+			exitCode = -1;
+			return true;
+		}
+		setMemoryBudget(domain, (int64_t)(megabytes * 1024 * 1024));
+	}
+
+	if (!options.recordInputPath.empty() && !options.replayInputPath.empty()) {
+		std::cout << "ERROR:INVALID_OPTION_VALUE --record-input and --replay\n";
+		exitCode = -1;
+		return true;
+	}
+
+	if (args.empty())
+		return false;
+
+	std::string name = args.front();
+	args.erase(args.begin());
+
+	if (name == "--help" || name == "-h") {
+		printUsage();
+		exitCode = 0;
+		return true;
+	}
+
+	for (const commandLineMode& mode : MODES) {
+		if (name == mode.name) {
+			exitCode = mode.run(args);
+			return true;
+		}
+	}
+
+	std::cout << "Unknown mode " << name << "\n\n";
+	printUsage();
+	exitCode = -1;
+	return true;
+}
+
+
+const std::string& getExecutablePath() {
+	return executablePath;
+}
+
+
+const globalOptions& getGlobalOptions() {
+	return options;
+}
+
+
+std::vector<std::string> getPositional(const std::vector<std::string>& args) {
+	std::vector<std::string> positional;
+
+	for (const std::string& arg : args) {
+		if (arg.rfind("--", 0) == 0)
+			break;
+		positional.push_back(arg);
+	}
+
+	return positional;
+}
+
+
+bool getOption(const std::vector<std::string>& args, const std::string& name, std::string& value) {
+	auto option = std::find(args.begin(), args.end(), name);
+	if (option == args.end() || option + 1 == args.end())
+		return false;
+
+	value = *(option + 1);
+	return true;
+}
+
+
+bool hasFlag(const std::vector<std::string>& args, const std::string& name) {
+	return std::find(args.begin(), args.end(), name) != args.end();
+}
+
+
+unsigned getThreadCount(const std::vector<std::string>& args) {
+	std::string value;
+	if (getOption(args, "--threads", value)) {
+		try {
+			return (unsigned)std::max(std::stoi(value), 1);
+		}
+		catch (const std::exception&) {
+			std::cout << "ERROR:INVALID_THREAD_COUNT " << value << '\n';
+		}
+	}
+
+	return std::max(std::thread::hardware_concurrency(), 1u);
+}
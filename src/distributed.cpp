@@ -0,0 +1,525 @@
+#include "distributed.h"
+#include "cli.h"
+#include "mandelbrot.h"
+#include "png_writer.h"
+#include "zoom_video.h"
+#include "net.h"
+
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <set>
+#include <map>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+
+// Set the default port, iteration count, band height, video settings and palette directory
+constexpr uint16_t COORDINATOR_PORT = 9090;
+constexpr int DISTRIBUTED_ITERATIONS = 1000;
+constexpr int DISTRIBUTED_BAND_ROWS = 64;
+constexpr int DISTRIBUTED_VIDEO_WIDTH = 1280, DISTRIBUTED_VIDEO_HEIGHT = 720;
+constexpr double DISTRIBUTED_VIDEO_FPS = 30.0;
+const char* DISTRIBUTED_PALETTES_PATH = "./palettes";
+
+// A worker sends a heartbeat every interval while rendering and is considered lost after the timeout
+constexpr auto HEARTBEAT_INTERVAL = std::chrono::seconds(1);
+constexpr auto HEARTBEAT_TIMEOUT = std::chrono::seconds(5);
+
+// A task that was lost this many times fails the whole render
+constexpr int MAX_TASK_ATTEMPTS = 3;
+
+// The render fails if no worker is connected for this long (--worker-timeout, 0 waits forever)
+constexpr int DISTRIBUTED_WORKER_TIMEOUT = 60;
+
+// A worker retries connecting for a while, so that it can be started before the coordinator
+constexpr int WORKER_CONNECT_ATTEMPTS = 50;
+constexpr auto WORKER_CONNECT_DELAY = std::chrono::milliseconds(100);
+
+
+static bool sendMessage(const socketHandle& connection, const messageType& type, const void* payload = nullptr, const size_t& length = 0,
+	const void* extra = nullptr, const size_t& extraLength = 0) {
+	messageHeader header{ type, (uint32_t)(length + extraLength) };
+
+	return sendAll(connection, &header, sizeof(header)) && sendAll(connection, payload, length) && sendAll(connection, extra, extraLength);
+}
+
+
+// Tasks of a render and their results, shared by the connections to the workers
+
+struct coordinatorState {
+	std::vector<renderTask> tasks;
+	std::vector<int> attempts;
+
+	// Tasks waiting for a worker (lowest id first, so that lost bands are redone before later ones) and finished tasks not written yet
+
+	std::set<uint64_t> queued;
+	std::map<uint64_t, std::vector<unsigned char>> results;
+	size_t unfinished;
+	bool failed;
+
+	std::mutex mutex;
+	std::condition_variable changed;
+
+	std::atomic<bool> stopping;
+	std::atomic<unsigned> workers, connectedWorkers;
+	std::atomic<uint64_t> retries;
+};
+
+
+static bool takeTask(coordinatorState& state, renderTask& task) {
+	std::unique_lock<std::mutex> lock(state.mutex);
+	state.changed.wait(lock, [&]() { return !state.queued.empty() || state.unfinished == 0 || state.failed; });
+
+	if (state.queued.empty() || state.failed)
+		return false;
+
+	task = state.tasks[*state.queued.begin()];
+	state.queued.erase(state.queued.begin());
+	return true;
+}
+
+
+static void requeueTask(coordinatorState& state, const uint64_t& id) {
+	std::lock_guard<std::mutex> lock(state.mutex);
+
+	if (++state.attempts[id] >= MAX_TASK_ATTEMPTS) {
+		std::cout << "ERROR:TASK_FAILED " << id << " was lost " << MAX_TASK_ATTEMPTS << " times\n";
+		state.failed = true;
+	}
+	else
+		state.queued.insert(id);
+
+	++state.retries;
+	state.changed.notify_all();
+}
+
+
+// Hand out tasks to one worker until there are none left, a task is given back if the worker goes silent or disconnects
+
+static void serveWorker(coordinatorState& state, const socketHandle& connection) {
+	messageHeader header;
+	uint32_t version = 0;
+
+	if (!receiveAll(connection, &header, sizeof(header)) || header.type != MESSAGE_HELLO || header.length != sizeof(version)
+		|| !receiveAll(connection, &version, sizeof(version)) || version != DISTRIBUTED_PROTOCOL_VERSION) {
+		std::cout << "ERROR:WORKER_PROTOCOL_MISMATCH\n";
+		closeSocket(connection);
+		return;
+	}
+
+	std::cout << "Worker " << ++state.workers << " connected" << std::endl;
+	++state.connectedWorkers;
+
+	renderTask task;
+	while (takeTask(state, task)) {
+		bool finished = false;
+		auto lastHeard = std::chrono::steady_clock::now();
+
+		if (sendMessage(connection, MESSAGE_TASK, &task, sizeof(task))) {
+			while (!finished) {
+				if (!waitReadable(connection, 100)) {
+					if (std::chrono::steady_clock::now() - lastHeard > HEARTBEAT_TIMEOUT)
+						break;
+					continue;
+				}
+
+				if (!receiveAll(connection, &header, sizeof(header)))
+					break;
+				lastHeard = std::chrono::steady_clock::now();
+
+				if (header.type == MESSAGE_HEARTBEAT && header.length == 0)
+					continue;
+
+				// Anything but the result of the task (a failure included) ends the connection
+
+				uint64_t id;
+				std::vector<unsigned char> rgb((size_t)task.rowCount * task.width * 3);
+				if (header.type != MESSAGE_RESULT || header.length != sizeof(id) + rgb.size()
+					|| !receiveAll(connection, &id, sizeof(id)) || id != task.id || !receiveAll(connection, rgb.data(), rgb.size()))
+					break;
+
+				std::lock_guard<std::mutex> lock(state.mutex);
+				state.results[id] = std::move(rgb);
+				--state.unfinished;
+				state.changed.notify_all();
+				finished = true;
+			}
+		}
+
+		if (!finished) {
+			std::cout << "Lost a worker, task " << task.id << " goes back to the queue" << std::endl;
+			--state.connectedWorkers;
+			requeueTask(state, task.id);
+			closeSocket(connection);
+			return;
+		}
+	}
+
+	--state.connectedWorkers;
+	sendMessage(connection, MESSAGE_SHUTDOWN);
+	closeSocket(connection);
+}
+
+
+int runCoordinator(const std::vector<std::string>& args) {
+	std::vector<std::string> positional = getPositional(args);
+	bool isExport = positional.size() == 7 && positional[0] == "export";
+	bool isVideo = positional.size() == 3 && positional[0] == "video";
+
+	if (!isExport && !isVideo) {
+		std::cout << "Usage: --coordinate export <output.png> <x> <y> <zoom> <width> <height> [--band-rows R] [options]\n"
+			"       --coordinate video <keyframe file> <output directory> [--width W] [--height H] [--fps F] [options]\n"
+			"Options: [--max-iterations N] [--palette name] [--palette-cycle C] [--port P] [--listen-all] [--local-workers N] [--threads N]\n"
+			"         [--worker-timeout S]\n";
+		return -1;
+	}
+
+	int iterations = DISTRIBUTED_ITERATIONS, bandRows = DISTRIBUTED_BAND_ROWS, port = COORDINATOR_PORT, localWorkers = 0;
+	int workerTimeout = DISTRIBUTED_WORKER_TIMEOUT;
+	int width = DISTRIBUTED_VIDEO_WIDTH, height = DISTRIBUTED_VIDEO_HEIGHT;
+	double fps = DISTRIBUTED_VIDEO_FPS;
+	float paletteCycle = DEFAULT_PALETTE_CYCLE;
+	viewState view{};
+	std::string value, paletteName;
+
+	try {
+		if (isExport) {
+			view.off.x = std::stod(value = positional[2]);
+			view.off.y = std::stod(value = positional[3]);
+			view.zoom = std::stod(value = positional[4]);
+			width = std::stoi(value = positional[5]);
+			height = std::stoi(value = positional[6]);
+		}
+		if (getOption(args, "--width", value)) width = std::stoi(value);
+		if (getOption(args, "--height", value)) height = std::stoi(value);
+		if (getOption(args, "--fps", value)) fps = std::stod(value);
+		if (getOption(args, "--band-rows", value)) bandRows = std::stoi(value);
+		if (getOption(args, "--max-iterations", value)) iterations = std::stoi(value);
+		if (getOption(args, "--palette-cycle", value)) paletteCycle = std::stof(value);
+		if (getOption(args, "--port", value)) port = std::stoi(value);
+		if (getOption(args, "--local-workers", value)) localWorkers = std::stoi(value);
+		if (getOption(args, "--worker-timeout", value)) workerTimeout = std::stoi(value);
+	}
+	catch (const std::exception&) {
+		std::cout << "ERROR:INVALID_OPTION_VALUE " << value << '\n';
+		return -1;
+	}
+	getOption(args, "--palette", paletteName);
+	unsigned threads = getThreadCount(args);
+
+	if ((isExport && view.zoom <= 0) || width <= 0 || height <= 0 || fps <= 0 || bandRows <= 0 || iterations <= 0 || paletteCycle <= 0
+		|| port < 0 || port > 65535 || localWorkers < 0 || workerTimeout < 0 || paletteName.size() >= sizeof(renderTask::palette)) {
+		std::cout << "ERROR:INVALID_OPTION_VALUE\n";
+		return -1;
+	}
+
+	// The workers look the palette up by name, check that it exists here first
+
+	std::vector<std::unique_ptr<Palette>> palettes = loadPalettes(DISTRIBUTED_PALETTES_PATH);
+	Palette* palette = paletteName.empty() ? palettes.front().get() : findPalette(palettes, paletteName);
+	if (palette == nullptr) {
+		std::cout << "ERROR:UNKNOWN_PALETTE " << paletteName << '\n';
+		return -1;
+	}
+	paletteName = palette->getName();
+
+	// Split the work: bands of rows of the export, or whole frames of the video
+
+	coordinatorState state;
+
+	auto addTask = [&](const viewState& taskView, const uint32_t& firstRow, const uint32_t& rowCount) {
+		renderTask task{};
+		task.id = state.tasks.size();
+		task.x = taskView.off.x;
+		task.y = taskView.off.y;
+		task.zoom = taskView.zoom;
+		task.maxIterations = (uint32_t)taskView.maxIterations;
+		task.width = (uint32_t)taskView.width;
+		task.height = (uint32_t)taskView.height;
+		task.firstRow = firstRow;
+		task.rowCount = rowCount;
+		task.paletteCycle = paletteCycle;
+		std::strncpy(task.palette, paletteName.c_str(), sizeof(task.palette) - 1);
+		state.tasks.push_back(task);
+	};
+
+	if (isExport) {
+		view.maxIterations = iterations;
+		view.width = width;
+		view.height = height;
+		for (int first = 0; first < height; first += bandRows)
+			addTask(view, first, std::min(bandRows, height - first));
+	}
+	else {
+		std::vector<zoomKeyframe> keyframes;
+		if (!readKeyframes(positional[1].c_str(), iterations, keyframes))
+			return -1;
+
+		size_t frameCount = (size_t)std::floor((keyframes.back().time - keyframes.front().time) * fps) + 1;
+		for (size_t i = 0; i < frameCount; ++i)
+			addTask(interpolateKeyframes(keyframes, keyframes.front().time + i / fps, width, height), 0, height);
+	}
+
+	state.attempts.assign(state.tasks.size(), 0);
+	for (const renderTask& task : state.tasks)
+		state.queued.insert(task.id);
+	state.unfinished = state.tasks.size();
+	state.failed = false;
+	state.stopping = false;
+	state.workers = 0;
+	state.connectedWorkers = 0;
+	state.retries = 0;
+
+	// Open the output before any work is done
+
+	std::filesystem::path output(positional[isExport ? 1 : 2]);
+	if (isExport && output.has_parent_path())
+		std::filesystem::create_directories(output.parent_path());
+	if (isVideo)
+		std::filesystem::create_directories(output);
+
+	PngWriter* png = isExport ? new PngWriter(output.string().c_str(), width, height) : nullptr;
+	if (png != nullptr && !png->isOpen()) {
+		delete png;
+		return 1;
+	}
+
+	uint16_t boundPort;
+	socketHandle listener = initializeSockets() ? listenOn((uint16_t)port, hasFlag(args, "--listen-all"), boundPort) : NO_SOCKET;
+	if (listener == NO_SOCKET) {
+		delete png;
+		return 1;
+	}
+
+	std::cout << state.tasks.size() << " tasks, waiting for workers on port " << boundPort << std::endl;
+
+	// Accept workers until the render is over
+
+	std::vector<std::thread> connections;
+	std::thread acceptor([&]() {
+		while (!state.stopping) {
+			if (!waitReadable(listener, 100))
+				continue;
+
+			socketHandle connection = acceptConnection(listener);
+			if (connection != NO_SOCKET)
+				connections.emplace_back(serveWorker, std::ref(state), connection);
+		}
+	});
+
+	// Workers on this machine are started as processes of the same program, sharing the threads between them
+
+	std::vector<std::thread> localProcesses;
+	unsigned workerThreads = std::max(threads / std::max(localWorkers, 1), 1u);
+	for (int i = 0; i < localWorkers; ++i) {
+		std::string command = '"' + getExecutablePath() + "\" --worker 127.0.0.1 " + std::to_string(boundPort) + " --threads " + std::to_string(workerThreads);
+		localProcesses.emplace_back([command]() { std::system(command.c_str()); });
+	}
+
+	// Write the results as they arrive: bands in order into the image, frames in any order
+
+	auto start = std::chrono::steady_clock::now();
+	auto lastWorker = start;
+	bool written = true;
+
+	for (size_t done = 0; done < state.tasks.size(); ++done) {
+		std::vector<unsigned char> rgb;
+		uint64_t id;
+		{
+			// The tasks still queued have nobody to render them once every worker is gone, so the wait gives up after the timeout
+
+			std::unique_lock<std::mutex> lock(state.mutex);
+			auto ready = [&]() { return state.failed || (isExport ? state.results.count(done) > 0 : !state.results.empty()); };
+			while (!state.changed.wait_for(lock, std::chrono::milliseconds(500), ready)) {
+				auto now = std::chrono::steady_clock::now();
+				if (state.connectedWorkers > 0 || workerTimeout == 0)
+					lastWorker = now;
+				else if (now - lastWorker > std::chrono::seconds(workerTimeout)) {
+					std::cout << "ERROR:NO_WORKERS_LEFT none connected for " << workerTimeout << " s, " << state.unfinished << " tasks unfinished\n";
+					state.failed = true;
+				}
+			}
+			if (state.failed)
+				break;
+
+			auto result = isExport ? state.results.find(done) : state.results.begin();
+			id = result->first;
+			rgb = std::move(result->second);
+			state.results.erase(result);
+		}
+
+		const renderTask& task = state.tasks[id];
+		if (isExport)
+			png->writeRows(rgb.data(), task.rowCount);
+		else {
+			char name[32];
+			std::snprintf(name, sizeof(name), "frame_%06llu.png", (unsigned long long)id);
+			if (!writePng((output / name).string().c_str(), rgb.data(), task.width, task.height)) {
+				std::cout << "ERROR:FRAME_COULD_NOT_BE_WRITTEN " << (output / name).string() << '\n';
+				written = false;
+			}
+		}
+
+		std::cout << '[' << done + 1 << '/' << state.tasks.size() << "] task " << id << " done" << std::endl;
+	}
+
+	// Release the workers and wait for the local ones to exit
+
+	{
+		std::lock_guard<std::mutex> lock(state.mutex);
+		if (state.unfinished > 0)
+			state.failed = true;
+		state.changed.notify_all();
+	}
+
+	state.stopping = true;
+	acceptor.join();
+	for (std::thread& connection : connections)
+		connection.join();
+	for (std::thread& process : localProcesses)
+		process.join();
+	closeSocket(listener);
+
+	if (png != nullptr) {
+		written = png->finish() && written;
+		delete png;
+	}
+
+	if (state.failed || !written) {
+		std::cout << "ERROR:DISTRIBUTED_RENDER_FAILED\n";
+		return 1;
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "Rendered " << state.tasks.size() << " tasks on " << state.workers << " workers in " << seconds << " s, "
+		<< state.retries << " tasks were retried\n";
+
+	return 0;
+}
+
+
+int runWorker(const std::vector<std::string>& args) {
+	std::vector<std::string> positional = getPositional(args);
+	int port = 0;
+
+	try {
+		if (positional.size() == 2)
+			port = std::stoi(positional[1]);
+	}
+	catch (const std::exception&) {}
+
+	if (positional.size() != 2 || port <= 0 || port > 65535) {
+		std::cout << "Usage: --worker <coordinator host> <port> [--threads N]\n";
+		return -1;
+	}
+	unsigned threads = getThreadCount(args);
+
+	if (!initializeSockets())
+		return 1;
+
+	socketHandle connection = NO_SOCKET;
+	for (int attempt = 0; attempt < WORKER_CONNECT_ATTEMPTS && connection == NO_SOCKET; ++attempt) {
+		if (attempt > 0)
+			std::this_thread::sleep_for(WORKER_CONNECT_DELAY);
+		connection = connectTo(positional[0], (uint16_t)port);
+	}
+
+	if (connection == NO_SOCKET) {
+		std::cout << "ERROR:COORDINATOR_UNREACHABLE " << positional[0] << ':' << port << '\n';
+		return 1;
+	}
+
+	std::vector<std::unique_ptr<Palette>> palettes = loadPalettes(DISTRIBUTED_PALETTES_PATH);
+
+	// Heartbeats are sent from their own thread while a task renders, the connection is shared with the results
+
+	std::mutex sendMutex;
+	std::mutex heartbeatMutex;
+	std::condition_variable heartbeatChanged;
+	bool rendering = false, stopping = false;
+
+	std::thread heartbeat([&]() {
+		std::unique_lock<std::mutex> lock(heartbeatMutex);
+		while (!stopping) {
+			heartbeatChanged.wait_for(lock, HEARTBEAT_INTERVAL);
+			if (rendering && !stopping) {
+				std::lock_guard<std::mutex> sendLock(sendMutex);
+				sendMessage(connection, MESSAGE_HEARTBEAT);
+			}
+		}
+	});
+
+	uint32_t version = DISTRIBUTED_PROTOCOL_VERSION;
+	bool connected = sendMessage(connection, MESSAGE_HELLO, &version, sizeof(version));
+	bool shutdown = false;
+	size_t completed = 0;
+
+	while (connected && !shutdown) {
+		messageHeader header;
+		renderTask task;
+
+		if (!receiveAll(connection, &header, sizeof(header)))
+			break;
+
+		if (header.type == MESSAGE_SHUTDOWN) {
+			shutdown = true;
+			break;
+		}
+
+		if (header.type != MESSAGE_TASK || header.length != sizeof(task) || !receiveAll(connection, &task, sizeof(task)))
+			break;
+
+		task.palette[sizeof(task.palette) - 1] = '\0';
+		Palette* palette = findPalette(palettes, task.palette);
+		if (palette == nullptr) {
+			std::cout << "ERROR:UNKNOWN_PALETTE " << task.palette << '\n';
+			std::lock_guard<std::mutex> sendLock(sendMutex);
+			sendMessage(connection, MESSAGE_FAILED, &task.id, sizeof(task.id));
+			break;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(heartbeatMutex);
+			rendering = true;
+		}
+
+		viewState view{ { task.x, task.y }, task.zoom, (int)task.maxIterations, (int)task.width, (int)task.height };
+		std::vector<unsigned char> rgb((size_t)task.rowCount * task.width * 3);
+
+		parallelRows((int)task.rowCount, threads, [&](int row) {
+			unsigned char* pixel = rgb.data() + (size_t)row * task.width * 3;
+			for (int column = 0; column < view.width; ++column, pixel += 3) {
+				coord c = imageToCoord(view, column + 0.5, task.firstRow + row + 0.5);
+				std::array<unsigned char, 3> color = map_to_color(*palette, iterateMandelbrot(c.x, c.y, view.maxIterations), task.paletteCycle);
+				std::copy(color.begin(), color.end(), pixel);
+			}
+		});
+
+		{
+			std::lock_guard<std::mutex> lock(heartbeatMutex);
+			rendering = false;
+		}
+
+		std::lock_guard<std::mutex> sendLock(sendMutex);
+		connected = sendMessage(connection, MESSAGE_RESULT, &task.id, sizeof(task.id), rgb.data(), rgb.size());
+		++completed;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(heartbeatMutex);
+		stopping = true;
+	}
+	heartbeatChanged.notify_all();
+	heartbeat.join();
+	closeSocket(connection);
+
+	std::cout << "Worker rendered " << completed << " tasks" << (shutdown ? "" : ", lost the coordinator") << '\n';
+	return shutdown ? 0 : 1;
+}
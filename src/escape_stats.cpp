@@ -0,0 +1,164 @@
+#include "escape_stats.h"
+
+#include <iostream>
+#include <algorithm>
+#include <bit>
+
+
+// Number of pixels reduced by one task of the parallel reduction
+constexpr size_t ESCAPE_STATS_CHUNK = 16384;
+
+
+size_t escapeHistogramBin(const uint32_t& iteration) {
+	// Octave of (iteration + 1) and its next two bits
+
+	uint32_t value = std::min(iteration, UINT32_MAX - 1) + 1;
+	int octave = std::bit_width(value) - 1;
+	uint32_t quarter = (octave >= 2) ? (value >> (octave - 2)) & 3 : (value << (2 - octave)) & 3;
+
+	return (size_t)octave * 4 + quarter;
+}
+
+
+uint32_t escapeHistogramBinStart(const size_t& bin) {
+	int octave = (int)(bin / 4);
+	uint64_t value = (octave >= 2) ? (uint64_t)(4 + bin % 4) << (octave - 2) : (4 + bin % 4) >> (2 - octave);
+
+	// Some bins of the two lowest octaves hold no integer and stay empty
+	return (uint32_t)(value - 1);
+}
+
+
+void escapeStatistics::add(const pixelEscape& escape) {
+	++pixels;
+	totalIterations += escape.iteration;
+	lowestIteration = std::min(lowestIteration, escape.iteration);
+	highestIteration = std::max(highestIteration, escape.iteration);
+
+	if (escape.escaped) {
+		++escapedPixels;
+		++histogram[escapeHistogramBin(escape.iteration)];
+	}
+	else if (escape.iteration >= maxIterations || escape.period != 0)
+		++maxedPixels;
+}
+
+
+void escapeStatistics::merge(const escapeStatistics& other) {
+	pixels += other.pixels;
+	escapedPixels += other.escapedPixels;
+	maxedPixels += other.maxedPixels;
+	totalIterations += other.totalIterations;
+	lowestIteration = std::min(lowestIteration, other.lowestIteration);
+	highestIteration = std::max(highestIteration, other.highestIteration);
+
+	for (size_t i = 0; i < ESCAPE_HISTOGRAM_BINS; ++i)
+		histogram[i] += other.histogram[i];
+}
+
+
+double escapeStatistics::meanIterations() const {
+	return pixels > 0 ? (double)totalIterations / pixels : 0.0;
+}
+
+
+double escapeStatistics::maxedFraction() const {
+	return pixels > 0 ? (double)maxedPixels / pixels : 0.0;
+}
+
+
+escapeStatistics computeEscapeStatistics(const std::vector<pixelEscape>& escapes, const uint32_t& maxIterations, const unsigned& threads) {
+	// Every chunk is reduced into its own partial result, which are then merged in order
+
+	size_t chunks = (escapes.size() + ESCAPE_STATS_CHUNK - 1) / ESCAPE_STATS_CHUNK;
+	std::vector<escapeStatistics> partial(chunks);
+
+	parallelRows((int)chunks, threads, [&](int chunk) {
+		escapeStatistics& statistics = partial[chunk];
+		statistics.maxIterations = maxIterations;
+
+		size_t end = std::min((size_t)(chunk + 1) * ESCAPE_STATS_CHUNK, escapes.size());
+		for (size_t i = (size_t)chunk * ESCAPE_STATS_CHUNK; i < end; ++i)
+			statistics.add(escapes[i]);
+	});
+
+	escapeStatistics total;
+	total.maxIterations = maxIterations;
+	for (const escapeStatistics& statistics : partial)
+		total.merge(statistics);
+
+	return total;
+}
+
+
+EscapeStatisticsLog::EscapeStatisticsLog(const std::string& path) : out(path), json(nullptr) {
+	if (!out) {
+		std::cout << "ERROR:STATISTICS_LOG_COULD_NOT_BE_OPENED " << path << '\n';
+		return;
+	}
+
+	if (path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0) {
+		json = new JsonWriter(out);
+		json->beginArray();
+	}
+	else
+		out << "frame,pixels,max_iterations,total_iterations,lowest_iteration,highest_iteration,mean_iterations,"
+			"escaped_pixels,maxed_pixels,maxed_fraction,histogram\n";
+}
+
+
+EscapeStatisticsLog::~EscapeStatisticsLog() {
+	if (json != nullptr) {
+		json->endArray();
+		out << '\n';
+		delete json;
+	}
+}
+
+
+bool EscapeStatisticsLog::isOpen() const {
+	return (bool)out;
+}
+
+
+void EscapeStatisticsLog::write(const uint64_t& frame, const escapeStatistics& statistics) {
+	uint32_t lowest = (statistics.pixels > 0) ? statistics.lowestIteration : 0;
+
+	if (json == nullptr) {
+		out << frame << ',' << statistics.pixels << ',' << statistics.maxIterations << ',' << statistics.totalIterations << ','
+			<< lowest << ',' << statistics.highestIteration << ',' << statistics.meanIterations() << ','
+			<< statistics.escapedPixels << ',' << statistics.maxedPixels << ',' << statistics.maxedFraction() << ',';
+		for (size_t i = 0; i < ESCAPE_HISTOGRAM_BINS; ++i)
+			out << (i > 0 ? " " : "") << statistics.histogram[i];
+		out << '\n';
+		return;
+	}
+
+	json->beginObject();
+	json->key("frame");
+	json->value(frame);
+	json->key("pixels");
+	json->value(statistics.pixels);
+	json->key("max_iterations");
+	json->value(statistics.maxIterations);
+	json->key("total_iterations");
+	json->value(statistics.totalIterations);
+	json->key("lowest_iteration");
+	json->value(lowest);
+	json->key("highest_iteration");
+	json->value(statistics.highestIteration);
+	json->key("mean_iterations");
+	json->value(statistics.meanIterations());
+	json->key("escaped_pixels");
+	json->value(statistics.escapedPixels);
+	json->key("maxed_pixels");
+	json->value(statistics.maxedPixels);
+	json->key("maxed_fraction");
+	json->value(statistics.maxedFraction());
+	json->key("histogram");
+	json->beginArray();
+	for (uint64_t count : statistics.histogram)
+		json->value(count);
+	json->endArray();
+	json->endObject();
+}
@@ -0,0 +1,113 @@
+#include "escape_stats_pass.h"
+
+#include <algorithm>
+
+
+// Layout of the statistics buffer (std430, must match shaders/escape_stats_compute.glsl)
+
+struct gpuEscapeStatistics {
+	GLuint totalLow, totalHigh;
+	GLuint escapedPixels, maxedPixels;
+	GLuint lowestIteration, highestIteration;
+	GLuint bins[ESCAPE_HISTOGRAM_BINS];
+};
+
+
+EscapeStatisticsPass::EscapeStatisticsPass(const char* computeShaderPath, EscapeStatisticsLog* log)
+	: nextSlot(0), program(computeShaderPath), log(log), memory("escape statistics", memoryDomain::gpu), hasLatest(false), latestFrame(0) {
+	for (statisticsSlot& slot : slots) {
+		glGenBuffers(1, &slot.SSBO);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, slot.SSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(gpuEscapeStatistics), nullptr, GL_DYNAMIC_READ);
+		slot.fence = nullptr;
+	}
+	memory.set(ESCAPE_STATS_RING_SIZE * sizeof(gpuEscapeStatistics));
+}
+
+
+EscapeStatisticsPass::~EscapeStatisticsPass() {
+	for (size_t i = 0; i < ESCAPE_STATS_RING_SIZE; ++i)
+		collect((nextSlot + i) % ESCAPE_STATS_RING_SIZE);
+
+	for (statisticsSlot& slot : slots)
+		glDeleteBuffers(1, &slot.SSBO);
+}
+
+
+void EscapeStatisticsPass::update(const uint64_t& frame, const GLuint& pixelCount, const GLuint& maxIterations) {
+	// The slot about to be reused is the oldest, only wait for it if the whole ring is still in flight
+
+	size_t index = nextSlot;
+	collect(index);
+	nextSlot = (nextSlot + 1) % ESCAPE_STATS_RING_SIZE;
+
+	statisticsSlot& slot = slots[index];
+
+	gpuEscapeStatistics initial{};
+	initial.lowestIteration = UINT32_MAX;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, slot.SSBO);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(initial), &initial);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ESCAPE_STATS_BINDING, slot.SSBO);
+
+	// One invocation per pixel, reduced per work group
+
+	program.setUInt("pixelCount", pixelCount);
+	program.setUInt("maxIterations", maxIterations);
+	glDispatchCompute((pixelCount + 255) / 256, 1, 1);
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.frame = frame;
+	slot.pixels = pixelCount;
+	slot.maxIterations = maxIterations;
+}
+
+
+void EscapeStatisticsPass::collect(const size_t& waitSlot) {
+	// The slots finish in the order they were submitted, stopping at the first unfinished one keeps the log in frame order
+
+	for (size_t i = 0; i < ESCAPE_STATS_RING_SIZE; ++i) {
+		size_t index = (nextSlot + i) % ESCAPE_STATS_RING_SIZE;
+		statisticsSlot& slot = slots[index];
+		if (slot.fence == nullptr)
+			continue;
+
+		GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, index == waitSlot ? GL_TIMEOUT_IGNORED : 0);
+		if (status == GL_TIMEOUT_EXPIRED)
+			break;
+
+		glDeleteSync(slot.fence);
+		slot.fence = nullptr;
+
+		gpuEscapeStatistics result;
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, slot.SSBO);
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(result), &result);
+
+		latest = escapeStatistics();
+		latest.maxIterations = slot.maxIterations;
+		latest.pixels = slot.pixels;
+		latest.escapedPixels = result.escapedPixels;
+		latest.maxedPixels = result.maxedPixels;
+		latest.totalIterations = ((uint64_t)result.totalHigh << 32) | result.totalLow;
+		latest.lowestIteration = result.lowestIteration;
+		latest.highestIteration = result.highestIteration;
+		std::copy(result.bins, result.bins + ESCAPE_HISTOGRAM_BINS, latest.histogram.begin());
+		latestFrame = slot.frame;
+		hasLatest = true;
+
+		if (log != nullptr)
+			log->write(slot.frame, latest);
+	}
+}
+
+
+bool EscapeStatisticsPass::getLatest(uint64_t& frame, escapeStatistics& statistics) const {
+	frame = latestFrame;
+	statistics = latest;
+	return hasLatest;
+}
+
+
+Shader& EscapeStatisticsPass::getProgram() {
+	return program;
+}
@@ -0,0 +1,517 @@
+#include "exp_map.h"
+#include "cli.h"
+#include "mandelbrot.h"
+#include "png_writer.h"
+#include "shader.h"
+#include "helpers.h"
+#include "memory_registry.h"
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <numbers>
+#include <chrono>
+#include <cstring>
+#include <cmath>
+
+
+// Set the default frame size, iteration count, and the paths the frames mode loads from
+constexpr int EXP_MAP_FRAME_WIDTH = 1280, EXP_MAP_FRAME_HEIGHT = 720;
+constexpr int EXP_MAP_ITERATIONS = 1000;
+const char* EXP_MAP_PALETTES_PATH = "./palettes";
+const char* EXP_MAP_VERTEX_SHADER_PATH = "./shaders/vertex_shader.glsl";
+const char* EXP_MAP_FRAGMENT_SHADER_PATH = "./shaders/exp_map_fragment.glsl";
+
+// Number of rows rendered and written at once
+constexpr uint32_t EXP_MAP_BLOCK_ROWS = 64;
+
+// Number of rows in one layer of the texture array the strip is uploaded to
+constexpr uint32_t EXP_MAP_LAYER_ROWS = 1024;
+
+
+ExpMapStrip::ExpMapStrip(const char* path) : in(path, std::ios::binary), header{}, firstRow(0), rowCount(0) {
+	if (!in) {
+		std::cout << "ERROR:EXP_MAP_COULD_NOT_BE_READ " << path << '\n';
+		return;
+	}
+
+	if (!in.read((char*)&header, sizeof(header)) || std::memcmp(header.magic, EXP_MAP_MAGIC, sizeof(EXP_MAP_MAGIC)) != 0
+		|| header.version != EXP_MAP_VERSION || header.width == 0 || header.height == 0) {
+		std::cout << "ERROR:EXP_MAP_INVALID_HEADER " << path << '\n';
+		in.close();
+	}
+}
+
+
+bool ExpMapStrip::isOpen() const {
+	return in.is_open();
+}
+
+
+const expMapHeader& ExpMapStrip::getHeader() const {
+	return header;
+}
+
+
+void ExpMapStrip::loadRows(const uint32_t& first, const uint32_t& count) {
+	uint32_t begin = std::min(first, header.height);
+	uint32_t end = std::min(first + count, header.height);
+
+	if (begin >= firstRow && end <= firstRow + rowCount)
+		return;
+
+	// Keep the rows that are already loaded, a zoom moves the window by a fraction of its size per frame
+
+	std::vector<float> window((size_t)(end - begin) * header.width);
+	uint32_t keptBegin = std::max(begin, firstRow), keptEnd = std::min(end, firstRow + rowCount);
+
+	if (keptBegin < keptEnd)
+		std::copy(rows.begin() + (size_t)(keptBegin - firstRow) * header.width, rows.begin() + (size_t)(keptEnd - firstRow) * header.width,
+			window.begin() + (size_t)(keptBegin - begin) * header.width);
+	else
+		keptBegin = keptEnd = end;
+
+	auto read = [&](uint32_t from, uint32_t to) {
+		if (from >= to)
+			return;
+		in.clear();
+		in.seekg(sizeof(header) + (std::streamoff)from * header.width * sizeof(float));
+		if (!in.read((char*)(window.data() + (size_t)(from - begin) * header.width), (std::streamsize)(to - from) * header.width * sizeof(float)))
+			std::cout << "ERROR:EXP_MAP_TRUNCATED rows " << from << " to " << to << '\n';
+	};
+
+	read(begin, keptBegin);
+	read(keptEnd, end);
+
+	rows = std::move(window);
+	firstRow = begin;
+	rowCount = end - begin;
+}
+
+
+const float* ExpMapStrip::getRows() const {
+	return rows.data();
+}
+
+
+uint32_t ExpMapStrip::getFirstRow() const {
+	return firstRow;
+}
+
+
+uint32_t ExpMapStrip::getRowCount() const {
+	return rowCount;
+}
+
+
+float ExpMapStrip::sample(const double& column, const double& row) const {
+	// Same interpolation as sampleStrip in shaders/exp_map_fragment.glsl
+
+	int width = (int)header.width;
+	double columnFloor = std::floor(column), rowFloor = std::floor(row);
+	float fx = (float)(column - columnFloor), fy = (float)(row - rowFloor);
+
+	auto value = [&](int x, int y) {
+		x = ((x % width) + width) % width;
+		y = std::clamp(y, (int)firstRow, (int)(firstRow + rowCount) - 1);
+		return rows[(size_t)(y - firstRow) * width + x];
+	};
+
+	int x = (int)columnFloor, y = (int)rowFloor;
+	float values[4] = { value(x, y), value(x + 1, y), value(x, y + 1), value(x + 1, y + 1) };
+	float weights[4] = { (1 - fx) * (1 - fy), fx * (1 - fy), (1 - fx) * fy, fx * fy };
+
+	float interiorWeight = 0.0f, sum = 0.0f;
+	for (int i = 0; i < 4; ++i) {
+		if (values[i] < 0)
+			interiorWeight += weights[i];
+		else
+			sum += weights[i] * values[i];
+	}
+
+	return (interiorWeight >= 0.5f) ? EXP_MAP_INTERIOR : sum / (1 - interiorWeight);
+}
+
+
+double expMapFrameZoom(const expMapHeader& header, const size_t& index, const size_t& count) {
+	if (count < 2)
+		return header.startZoom;
+
+	return header.startZoom * std::pow(header.endZoom / header.startZoom, (double)index / (count - 1));
+}
+
+
+// Radius of the corners and half the pixel size of a frame, in units of 1 / zoom
+// (the view is 4 units high, as in imageToCoord)
+
+static double frameOuterRadius(const int& width, const int& height) {
+	return 2.0 * std::hypot(1.0, (double)width / height);
+}
+
+
+static double frameInnerRadius(const int& height) {
+	return 2.0 / height;
+}
+
+
+void expMapFrameRows(const expMapHeader& header, const int& width, const int& height, const double& zoom, uint32_t& first, uint32_t& last) {
+	double logZoom = std::log(zoom);
+	double outer = (header.logOuterRadius - (std::log(frameOuterRadius(width, height)) - logZoom)) / header.logStep;
+	double inner = (header.logOuterRadius - (std::log(frameInnerRadius(height)) - logZoom)) / header.logStep;
+
+	// One row of margin for the interpolation
+
+	first = (uint32_t)std::clamp(std::floor(outer) - 1.0, 0.0, (double)header.height - 1);
+	last = (uint32_t)std::clamp(std::ceil(inner) + 1.0, 0.0, (double)header.height - 1);
+}
+
+
+// Position in the strip (column, row) of the pixel at offset (x, y) from the zoom center, in units of 1 / zoom
+// Returns false if the pixel lies outside the outer radius of the strip
+
+static bool stripPosition(const expMapHeader& header, const double& x, const double& y, const double& logZoom, double& column, double& row) {
+	double logRadius = std::log(std::max(std::hypot(x, y), 1e-300)) - logZoom;
+	double angle = std::atan2(y, x);
+	if (angle < 0)
+		angle += 2 * std::numbers::pi;
+
+	column = angle / (2 * std::numbers::pi) * header.width - 0.5;
+	row = (header.logOuterRadius - logRadius) / header.logStep - 0.5;
+
+	return row >= -0.5;
+}
+
+
+static int renderStrip(const std::vector<std::string>& args, const std::vector<std::string>& positional) {
+	expMapHeader header{};
+	std::memcpy(header.magic, EXP_MAP_MAGIC, sizeof(EXP_MAP_MAGIC));
+	header.version = EXP_MAP_VERSION;
+
+	int frameWidth = EXP_MAP_FRAME_WIDTH, frameHeight = EXP_MAP_FRAME_HEIGHT, iterations = EXP_MAP_ITERATIONS, width = 0;
+	std::string value;
+
+	try {
+		header.centerX = std::stod(value = positional[2]);
+		header.centerY = std::stod(value = positional[3]);
+		header.startZoom = std::stod(value = positional[4]);
+		header.endZoom = std::stod(value = positional[5]);
+		if (getOption(args, "--width", value)) width = std::stoi(value);
+		if (getOption(args, "--frame-width", value)) frameWidth = std::stoi(value);
+		if (getOption(args, "--frame-height", value)) frameHeight = std::stoi(value);
+		if (getOption(args, "--max-iterations", value)) iterations = std::stoi(value);
+	}
+	catch (const std::exception&) {
+		std::cout << "ERROR:INVALID_OPTION_VALUE " << value << '\n';
+		return -1;
+	}
+	unsigned threads = getThreadCount(args);
+
+	if (header.startZoom <= 0 || header.endZoom < header.startZoom || frameWidth <= 0 || frameHeight <= 0 || iterations <= 0 || width < 0) {
+		std::cout << "ERROR:INVALID_OPTION_VALUE\n";
+		return -1;
+	}
+
+	// By default the angular resolution matches the pixels at the corners of a frame (pi times its diagonal)
+
+	if (width == 0)
+		width = (int)std::ceil(std::numbers::pi * std::hypot(frameWidth, frameHeight));
+
+	// Rows are square in log-polar space and run from the corners of the first frame
+	// to half a pixel of the last frame
+
+	header.width = (uint32_t)width;
+	header.maxIterations = (uint32_t)iterations;
+	header.frameWidth = (uint32_t)frameWidth;
+	header.frameHeight = (uint32_t)frameHeight;
+	header.logStep = 2 * std::numbers::pi / width;
+	header.logOuterRadius = std::log(frameOuterRadius(frameWidth, frameHeight)) - std::log(header.startZoom);
+	double logInnerRadius = std::log(frameInnerRadius(frameHeight)) - std::log(header.endZoom);
+	header.height = (uint32_t)std::ceil((header.logOuterRadius - logInnerRadius) / header.logStep) + 1;
+
+	std::ofstream out(positional[1], std::ios::binary);
+	if (!out) {
+		std::cout << "ERROR:EXP_MAP_COULD_NOT_BE_WRITTEN " << positional[1] << '\n';
+		return 1;
+	}
+	out.write((const char*)&header, sizeof(header));
+
+	std::cout << "Rendering a " << header.width << " x " << header.height << " strip ("
+		<< (double)header.width * header.height / ((double)frameWidth * frameHeight) << " frames of " << frameWidth << " x " << frameHeight << ")\n";
+
+	std::vector<float> block((size_t)EXP_MAP_BLOCK_ROWS * width);
+	auto start = std::chrono::steady_clock::now();
+	int reportedPercent = -1;
+
+	for (uint32_t first = 0; first < header.height; first += EXP_MAP_BLOCK_ROWS) {
+		uint32_t count = std::min(EXP_MAP_BLOCK_ROWS, header.height - first);
+
+		parallelRows((int)count, threads, [&](int row) {
+			double radius = std::exp(header.logOuterRadius - (first + row + 0.5) * header.logStep);
+			float* line = block.data() + (size_t)row * width;
+
+			for (int column = 0; column < width; ++column) {
+				double angle = (column + 0.5) * header.logStep;
+				pixelEscape escape = iterateMandelbrot(header.centerX + radius * std::cos(angle), header.centerY + radius * std::sin(angle), header.maxIterations);
+				line[column] = escape.escaped ? smoothIteration(escape) : EXP_MAP_INTERIOR;
+			}
+		});
+
+		out.write((const char*)block.data(), (std::streamsize)count * width * sizeof(float));
+
+		int percent = (int)(100.0 * (first + count) / header.height);
+		if (percent / 10 != reportedPercent / 10) {
+			std::cout << percent << "%\n";
+			reportedPercent = percent;
+		}
+	}
+
+	out.close();
+	if (!out) {
+		std::cout << "ERROR:EXP_MAP_COULD_NOT_BE_WRITTEN " << positional[1] << '\n';
+		return 1;
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "Rendered the strip in " << seconds << " s\n";
+
+	return 0;
+}
+
+
+// Reconstruct a frame on the CPU, rows from top to bottom
+
+static void reprojectFrame(const ExpMapStrip& strip, const int& width, const int& height, const double& zoom,
+	const Palette& palette, const float& paletteCycle, const unsigned& threads, std::vector<unsigned char>& rgb) {
+	const expMapHeader& header = strip.getHeader();
+	double logZoom = std::log(zoom);
+	double lenx = 4.0 * width / height, leny = 4.0;
+
+	parallelRows(height, threads, [&](int row) {
+		for (int column = 0; column < width; ++column) {
+			double x = ((column + 0.5) / width - 0.5) * lenx;
+			double y = ((height - row - 0.5) / height - 0.5) * leny;
+
+			double stripColumn, stripRow;
+			float iteration = stripPosition(header, x, y, logZoom, stripColumn, stripRow) ? strip.sample(stripColumn, stripRow) : EXP_MAP_INTERIOR;
+
+			std::array<unsigned char, 3> color = map_to_color(palette, iteration, paletteCycle);
+			std::copy(color.begin(), color.end(), rgb.data() + ((size_t)row * width + column) * 3);
+		}
+	});
+}
+
+
+// Reconstruct every frame with the reprojection shader, needs a current context
+// The strip is uploaded to a ring of texture array layers, each layer is uploaded once
+
+static int reprojectFramesOnGpu(ExpMapStrip& strip, const std::string& directory, const size_t& frameCount,
+	const int& width, const int& height, Palette& palette, const float& paletteCycle) {
+	const expMapHeader& header = strip.getHeader();
+
+	GLint maxTextureSize, maxLayers;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+	uint32_t layerRows = std::min<uint32_t>(EXP_MAP_LAYER_ROWS, (uint32_t)maxTextureSize);
+	uint32_t first, last;
+	expMapFrameRows(header, width, height, header.startZoom, first, last);
+	uint32_t ringSize = (last - first + layerRows - 1) / layerRows + 2;
+
+	if (header.width > (uint32_t)maxTextureSize || width > maxTextureSize || height > maxTextureSize || ringSize > (uint32_t)maxLayers) {
+		std::cout << "ERROR:EXP_MAP_TOO_LARGE_FOR_GPU use --cpu\n";
+		return 1;
+	}
+
+	int exitCode = 0;
+	{
+		Shader program(EXP_MAP_VERTEX_SHADER_PATH, EXP_MAP_FRAGMENT_SHADER_PATH);
+
+		GLuint stripTexture;
+		glGenTextures(1, &stripTexture);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, stripTexture);
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_R32F, header.width, layerRows, ringSize);
+		std::vector<int64_t> residentLayers(ringSize, -1);
+
+		// Render target and a quad covering it
+
+		GLuint framebuffer, renderbuffer;
+		glGenFramebuffers(1, &framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glGenRenderbuffers(1, &renderbuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffer);
+		glViewport(0, 0, width, height);
+
+		GLfloat vertices[] = { -1.0f, -1.0f, 0.0f, 1.0f, -1.0f, 0.0f, -1.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f };
+		GLuint VAO, VBO;
+		glGenVertexArrays(1, &VAO);
+		glBindVertexArray(VAO);
+		glGenBuffers(1, &VBO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
+		glEnableVertexAttribArray(0);
+
+		TrackedMemory memory("exp map", memoryDomain::gpu);
+		memory.set((int64_t)header.width * layerRows * ringSize * sizeof(float) + (int64_t)width * height * 4 + (int64_t)sizeof(vertices));
+
+		palette.bind(0);
+		program.setValues(width, height, header.centerX, header.centerY, header.startZoom, header.maxIterations);
+		program.setColoring(0, paletteCycle, 0);
+		program.setInt("strip", 1);
+		program.setUInt("stripWidth", header.width);
+		program.setUInt("stripHeight", header.height);
+		program.setUInt("layerRows", layerRows);
+		program.setUInt("ringSize", ringSize);
+		program.setFloat("logOuterRadius", (GLfloat)header.logOuterRadius);
+		program.setFloat("logStep", (GLfloat)header.logStep);
+
+		std::vector<unsigned char> rgb((size_t)width * height * 3);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+		for (size_t index = 0; index < frameCount && exitCode == 0; ++index) {
+			double zoom = expMapFrameZoom(header, index, frameCount);
+
+			// Upload the layers the frame needs that are not resident yet
+
+			expMapFrameRows(header, width, height, zoom, first, last);
+			for (uint32_t layer = first / layerRows; layer <= last / layerRows; ++layer) {
+				if (residentLayers[layer % ringSize] == layer)
+					continue;
+
+				strip.loadRows(layer * layerRows, layerRows);
+				glActiveTexture(GL_TEXTURE1);
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer % ringSize, header.width, strip.getRowCount(), 1, GL_RED, GL_FLOAT, strip.getRows());
+				residentLayers[layer % ringSize] = layer;
+			}
+
+			program.setFloat("logZoom", (GLfloat)std::log(zoom));
+			glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+			glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, rgb.data());
+
+			// The framebuffer rows go from bottom to top
+
+			char name[32];
+			std::snprintf(name, sizeof(name), "/frame_%06zu.png", index);
+			PngWriter png((directory + name).c_str(), width, height);
+			for (int row = height - 1; row >= 0; --row)
+				png.writeRows(rgb.data() + (size_t)row * width * 3, 1);
+
+			if (!png.finish()) {
+				std::cout << "ERROR:FRAME_COULD_NOT_BE_WRITTEN " << directory + name << '\n';
+				exitCode = 1;
+			}
+		}
+
+		glDeleteBuffers(1, &VBO);
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteRenderbuffers(1, &renderbuffer);
+		glDeleteFramebuffers(1, &framebuffer);
+		glDeleteTextures(1, &stripTexture);
+	}
+
+	return exitCode;
+}
+
+
+static int reconstructFrames(const std::vector<std::string>& args, const std::vector<std::string>& positional) {
+	ExpMapStrip strip(positional[1].c_str());
+	if (!strip.isOpen())
+		return -1;
+	const expMapHeader& header = strip.getHeader();
+
+	int width = (int)header.frameWidth, height = (int)header.frameHeight, frameCount;
+	float paletteCycle = DEFAULT_PALETTE_CYCLE;
+	std::string value, paletteName;
+
+	try {
+		frameCount = std::stoi(value = positional[3]);
+		if (getOption(args, "--frame-width", value)) width = std::stoi(value);
+		if (getOption(args, "--frame-height", value)) height = std::stoi(value);
+		if (getOption(args, "--palette-cycle", value)) paletteCycle = std::stof(value);
+	}
+	catch (const std::exception&) {
+		std::cout << "ERROR:INVALID_OPTION_VALUE " << value << '\n';
+		return -1;
+	}
+	getOption(args, "--palette", paletteName);
+	unsigned threads = getThreadCount(args);
+
+	if (frameCount <= 0 || width <= 0 || height <= 0 || paletteCycle <= 0) {
+		std::cout << "ERROR:INVALID_OPTION_VALUE\n";
+		return -1;
+	}
+
+	std::vector<std::unique_ptr<Palette>> palettes = loadPalettes(EXP_MAP_PALETTES_PATH);
+	Palette* palette = paletteName.empty() ? palettes.front().get() : findPalette(palettes, paletteName);
+	if (palette == nullptr) {
+		std::cout << "ERROR:UNKNOWN_PALETTE " << paletteName << '\n';
+		return -1;
+	}
+
+	// The palette textures belong to the context, so it is only destroyed after them
+
+	bool cpu = hasFlag(args, "--cpu");
+	GLFWwindow* context = cpu ? nullptr : createHeadlessContext();
+	if (!cpu && context == nullptr)
+		return 1;
+
+	std::filesystem::create_directories(positional[2]);
+	auto start = std::chrono::steady_clock::now();
+	int exitCode = 0;
+
+	if (cpu) {
+		std::vector<unsigned char> rgb((size_t)width * height * 3);
+
+		for (size_t index = 0; index < (size_t)frameCount && exitCode == 0; ++index) {
+			double zoom = expMapFrameZoom(header, index, frameCount);
+
+			uint32_t first, last;
+			expMapFrameRows(header, width, height, zoom, first, last);
+			strip.loadRows(first, last - first + 1);
+			reprojectFrame(strip, width, height, zoom, *palette, paletteCycle, threads, rgb);
+
+			char name[32];
+			std::snprintf(name, sizeof(name), "/frame_%06zu.png", index);
+			if (!writePng((positional[2] + name).c_str(), rgb.data(), width, height)) {
+				std::cout << "ERROR:FRAME_COULD_NOT_BE_WRITTEN " << positional[2] + name << '\n';
+				exitCode = 1;
+			}
+		}
+	}
+	else
+		exitCode = reprojectFramesOnGpu(strip, positional[2], frameCount, width, height, *palette, paletteCycle);
+
+	if (exitCode == 0) {
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "Reconstructed " << frameCount << " frames in " << seconds << " s\n";
+	}
+
+	palettes.clear();
+
+	if (context != nullptr)
+		glfwTerminate();
+
+	return exitCode;
+}
+
+
+int runExpMap(const std::vector<std::string>& args) {
+	std::vector<std::string> positional = getPositional(args);
+
+	if (positional.size() == 6 && positional[0] == "render")
+		return renderStrip(args, positional);
+	if (positional.size() == 4 && positional[0] == "frames")
+		return reconstructFrames(args, positional);
+
+	std::cout << "Usage: --exp-map render <strip file> <x> <y> <start zoom> <end zoom> [--width W] [--frame-width W] [--frame-height H]"
+		" [--max-iterations N] [--threads N]\n"
+		"       --exp-map frames <strip file> <output directory> <frame count> [--frame-width W] [--frame-height H]"
+		" [--palette name] [--palette-cycle C] [--cpu] [--threads N]\n";
+	return -1;
+}
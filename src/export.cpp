@@ -0,0 +1,366 @@
+#include "export.h"
+#include "cli.h"
+#include "mandelbrot.h"
+#include "png_writer.h"
+#include "raw_iterations.h"
+#include "trace.h"
+#include "memory_registry.h"
+
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+#include <chrono>
+#include <cstring>
+
+
+// Set the default iteration count, palette directory and memory of one band of rows
+constexpr int EXPORT_ITERATIONS = 1000;
+const char* EXPORT_PALETTES_PATH = "./palettes";
+constexpr double EXPORT_BAND_MEGABYTES = 64.0;
+
+// Size of the square tiles a band is split into, tiles are handed out to the threads one at a time
+constexpr int EXPORT_TILE_SIZE = 128;
+
+
+// Magic and version of the checkpoint file written next to the image
+constexpr char EXPORT_CHECKPOINT_MAGIC[8] = { 'M', 'B', 'E', 'X', 'C', 'K', 'P', '\0' };
+constexpr uint32_t EXPORT_CHECKPOINT_VERSION = 2;
+
+
+// Progress of an export, rewritten after every band so that a killed export can be continued with --resume
+// The settings are stored to make sure that the continued rows belong to the same image
+
+struct exportCheckpoint {
+	char magic[8];
+	uint32_t version;
+	uint32_t rowsDone;
+	uint32_t width, height, maxIterations, rawChannels;
+	double centerX, centerY, zoom;
+	float paletteCycle;
+	uint32_t paletteHash;
+	uint32_t distanceColoring;
+	uint32_t periodColoring;
+	pngResumePoint png;
+};
+
+static_assert(sizeof(exportCheckpoint) == 88, "the checkpoint is written as is");
+
+
+// Rows of the image that are computed together and then handed to the encoder
+
+struct exportBand {
+	std::vector<unsigned char> rgb;
+	std::vector<float> samples;
+	int firstRow, rowCount;
+	bool filled;
+};
+
+
+// Checkpoint of the settings of an export with no rows done, the palette is identified by a 32 bit FNV-1a hash of its name
+
+static exportCheckpoint initialCheckpoint(const viewState& view, const uint32_t& rawChannels, const float& paletteCycle, const std::string& paletteName,
+	const bool& distanceColoring, const bool& periodColoring) {
+	exportCheckpoint checkpoint{};
+	std::memcpy(checkpoint.magic, EXPORT_CHECKPOINT_MAGIC, sizeof(EXPORT_CHECKPOINT_MAGIC));
+	checkpoint.version = EXPORT_CHECKPOINT_VERSION;
+	checkpoint.width = (uint32_t)view.width;
+	checkpoint.height = (uint32_t)view.height;
+	checkpoint.maxIterations = (uint32_t)view.maxIterations;
+	checkpoint.rawChannels = rawChannels;
+	checkpoint.centerX = view.off.x;
+	checkpoint.centerY = view.off.y;
+	checkpoint.zoom = view.zoom;
+	checkpoint.paletteCycle = paletteCycle;
+	checkpoint.distanceColoring = distanceColoring ? 1 : 0;
+	checkpoint.periodColoring = periodColoring ? 1 : 0;
+
+	checkpoint.paletteHash = 2166136261u;
+	for (unsigned char character : paletteName)
+		checkpoint.paletteHash = (checkpoint.paletteHash ^ character) * 16777619u;
+
+	return checkpoint;
+}
+
+
+// Read a checkpoint and check that it was written by an export with the same settings
+
+static bool readCheckpoint(const std::string& path, const exportCheckpoint& settings, exportCheckpoint& checkpoint) {
+	std::ifstream in(path, std::ios::binary);
+	if (!in.read((char*)&checkpoint, sizeof(checkpoint)))
+		return false;
+
+	return std::memcmp(checkpoint.magic, settings.magic, sizeof(checkpoint.magic)) == 0 && checkpoint.version == settings.version
+		&& checkpoint.width == settings.width && checkpoint.height == settings.height && checkpoint.maxIterations == settings.maxIterations
+		&& checkpoint.rawChannels == settings.rawChannels && checkpoint.centerX == settings.centerX && checkpoint.centerY == settings.centerY
+		&& checkpoint.zoom == settings.zoom && checkpoint.paletteCycle == settings.paletteCycle && checkpoint.paletteHash == settings.paletteHash
+		&& checkpoint.distanceColoring == settings.distanceColoring && checkpoint.periodColoring == settings.periodColoring
+		&& checkpoint.rowsDone <= checkpoint.height && checkpoint.png.rowsWritten == checkpoint.rowsDone;
+}
+
+
+// Replace the checkpoint file, through a temporary file so that a kill while writing leaves the previous one intact
+
+static bool writeCheckpoint(const std::string& path, const exportCheckpoint& checkpoint) {
+	std::string temporaryPath = path + ".tmp";
+	{
+		std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+		if (!out.write((const char*)&checkpoint, sizeof(checkpoint)))
+			return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, path, error);
+	return !error;
+}
+
+
+int runExport(const std::vector<std::string>& args) {
+	std::vector<std::string> positional = getPositional(args);
+	if (positional.size() != 6) {
+		std::cout << "Usage: --export <output.png> <x> <y> <zoom> <width> <height> [--max-iterations N] [--palette name]"
+			" [--palette-cycle C] [--band-memory MB] [--compression L] [--raw file] [--distance-coloring] [--period-coloring] [--resume] [--threads N]\n";
+		return -1;
+	}
+
+	viewState view{ {}, 1.0, EXPORT_ITERATIONS, 0, 0 };
+	float paletteCycle = DEFAULT_PALETTE_CYCLE;
+	double bandMegabytes = EXPORT_BAND_MEGABYTES;
+	int compressionLevel = Z_DEFAULT_COMPRESSION;
+	std::string value, paletteName, rawPath;
+
+	try {
+		view.off.x = std::stod(value = positional[1]);
+		view.off.y = std::stod(value = positional[2]);
+		view.zoom = std::stod(value = positional[3]);
+		view.width = std::stoi(value = positional[4]);
+		view.height = std::stoi(value = positional[5]);
+		if (getOption(args, "--max-iterations", value)) view.maxIterations = std::stoi(value);
+		if (getOption(args, "--palette-cycle", value)) paletteCycle = std::stof(value);
+		if (getOption(args, "--band-memory", value)) bandMegabytes = std::stod(value);
+		if (getOption(args, "--compression", value)) compressionLevel = std::stoi(value);
+	}
+	catch (const std::exception&) {
+		std::cout << "ERROR:INVALID_OPTION_VALUE " << value << '\n';
+		return -1;
+	}
+	getOption(args, "--palette", paletteName);
+	getOption(args, "--raw", rawPath);
+	bool distanceColoring = hasFlag(args, "--distance-coloring"), periodColoring = hasFlag(args, "--period-coloring");
+	unsigned threads = getThreadCount(args);
+
+	if (view.zoom <= 0 || view.width <= 0 || view.height <= 0 || view.maxIterations <= 0 || paletteCycle <= 0 || bandMegabytes <= 0
+		|| compressionLevel < Z_DEFAULT_COMPRESSION || compressionLevel > Z_BEST_COMPRESSION) {
+		std::cout << "ERROR:INVALID_OPTION_VALUE\n";
+		return -1;
+	}
+
+	std::vector<std::unique_ptr<Palette>> palettes = loadPalettes(EXPORT_PALETTES_PATH);
+	Palette* palette = paletteName.empty() ? palettes.front().get() : findPalette(palettes, paletteName);
+	if (palette == nullptr) {
+		std::cout << "ERROR:UNKNOWN_PALETTE " << paletteName << '\n';
+		return -1;
+	}
+
+	std::filesystem::path outputPath(positional[0]);
+	if (outputPath.has_parent_path())
+		std::filesystem::create_directories(outputPath.parent_path());
+
+	// The escape data can be written next to the image, to recolor it later, with the distance estimates and periods when they are used
+
+	uint32_t rawChannels = RAW_CHANNEL_MAGNITUDE | (distanceColoring ? RAW_CHANNEL_DISTANCE : 0) | (periodColoring ? RAW_CHANNEL_PERIOD : 0);
+	uint32_t sampleFloats = rawSampleFloats(rawChannels);
+
+	// Progress is saved after every band, with --resume an export continues after the last saved band
+
+	std::string checkpointPath = positional[0] + ".checkpoint";
+	exportCheckpoint checkpoint = initialCheckpoint(view, rawPath.empty() ? 0 : rawChannels, paletteCycle, palette->getName(), distanceColoring, periodColoring);
+
+	if (hasFlag(args, "--resume")) {
+		exportCheckpoint saved;
+		if (readCheckpoint(checkpointPath, checkpoint, saved)) {
+			checkpoint = saved;
+			std::cout << "Resuming " << positional[0] << " at row " << checkpoint.rowsDone << " of " << view.height << '\n';
+		}
+		else if (std::filesystem::exists(checkpointPath))
+			std::cout << "The checkpoint " << checkpointPath << " belongs to other settings, starting over\n";
+	}
+
+	PngWriter png = (checkpoint.rowsDone > 0)
+		? PngWriter(positional[0].c_str(), view.width, view.height, compressionLevel, checkpoint.png)
+		: PngWriter(positional[0].c_str(), view.width, view.height, compressionLevel);
+	if (!png.isOpen()) {
+		std::cout << "ERROR:IMAGE_COULD_NOT_BE_WRITTEN " << positional[0] << '\n';
+		return 1;
+	}
+
+	RawIterationWriter* raw = nullptr;
+	if (!rawPath.empty()) {
+		raw = (checkpoint.rowsDone > 0)
+			? new RawIterationWriter(rawPath.c_str(), view, rawChannels, checkpoint.rowsDone)
+			: new RawIterationWriter(rawPath.c_str(), view, rawChannels);
+		if (!raw->isOpen()) {
+			std::cout << "ERROR:RAW_ITERATIONS_COULD_NOT_BE_WRITTEN " << rawPath << '\n';
+			delete raw;
+			return 1;
+		}
+	}
+
+	// As many rows as fit in the band memory, whole tiles high when possible
+
+	size_t rowBytes = (size_t)view.width * 3 + (raw != nullptr ? (size_t)view.width * sampleFloats * sizeof(float) : 0);
+	int bandRows = (int)std::clamp<double>(bandMegabytes * 1024 * 1024 / rowBytes, 1.0, (double)view.height);
+
+	// Smaller bands if two of them do not fit in the CPU memory budget
+
+	int64_t budgetRows = getAvailableMemory(memoryDomain::cpu) / (2 * (int64_t)rowBytes);
+	if (budgetRows < 1) {
+		std::cout << "ERROR:MEMORY_BUDGET_EXCEEDED export bands need at least " << 2 * rowBytes << " bytes\n";
+		delete raw;
+		return 1;
+	}
+	bandRows = (int)std::min<int64_t>(bandRows, budgetRows);
+	if (bandRows > EXPORT_TILE_SIZE)
+		bandRows -= bandRows % EXPORT_TILE_SIZE;
+
+	std::cout << "Exporting " << view.width << " x " << view.height << " in bands of " << bandRows << " rows ("
+		<< 2.0 * bandRows * rowBytes / (1024 * 1024) << " MB)\n";
+
+	// Two bands: the threads fill one while the encoder compresses the other
+
+	exportBand bands[2];
+	for (exportBand& band : bands) {
+		band.rgb.resize((size_t)bandRows * view.width * 3);
+		if (raw != nullptr)
+			band.samples.resize((size_t)bandRows * view.width * sampleFloats);
+		band.filled = false;
+	}
+	TrackedMemory bandMemory("export bands", memoryDomain::cpu);
+	bandMemory.set(2 * (int64_t)bandRows * (int64_t)rowBytes);
+
+	std::mutex bandMutex;
+	std::condition_variable bandChanged;
+	int firstRow = (int)checkpoint.rowsDone;
+	int bandCount = (view.height - firstRow + bandRows - 1) / bandRows;
+	bool checkpointFailed = false;
+	double encodeSeconds = 0.0;
+
+	std::thread encoder([&]() {
+		setTraceThreadName("band encoder");
+
+		for (int i = 0; i < bandCount; ++i) {
+			exportBand& band = bands[i % 2];
+			{
+				std::unique_lock<std::mutex> lock(bandMutex);
+				bandChanged.wait(lock, [&]() { return band.filled; });
+			}
+
+			TRACE_SCOPE("encode band");
+			auto start = std::chrono::steady_clock::now();
+			png.writeRows(band.rgb.data(), band.rowCount);
+			if (raw != nullptr)
+				raw->writeRows(band.samples.data(), band.rowCount);
+
+			// The checkpoint is only replaced once both files hold the band
+
+			if (png.flush(checkpoint.png) && (raw == nullptr || raw->flush())) {
+				checkpoint.rowsDone = (uint32_t)(band.firstRow + band.rowCount);
+				if (!writeCheckpoint(checkpointPath, checkpoint) && !checkpointFailed) {
+					std::cout << "ERROR:CHECKPOINT_COULD_NOT_BE_WRITTEN " << checkpointPath << '\n';
+					checkpointFailed = true;
+				}
+			}
+			encodeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			std::lock_guard<std::mutex> lock(bandMutex);
+			band.filled = false;
+			bandChanged.notify_all();
+		}
+	});
+
+	auto start = std::chrono::steady_clock::now();
+	double renderSeconds = 0.0;
+	int startPercent = (int)(100.0 * firstRow / view.height), reportedPercent = startPercent;
+
+	for (int i = 0; i < bandCount; ++i) {
+		exportBand& band = bands[i % 2];
+		{
+			std::unique_lock<std::mutex> lock(bandMutex);
+			bandChanged.wait(lock, [&]() { return !band.filled; });
+		}
+
+		band.firstRow = firstRow + i * bandRows;
+		band.rowCount = std::min(bandRows, view.height - band.firstRow);
+
+		int tileColumns = (view.width + EXPORT_TILE_SIZE - 1) / EXPORT_TILE_SIZE;
+		double pixelWidth = pixelSize(view);
+		int tileRows = (band.rowCount + EXPORT_TILE_SIZE - 1) / EXPORT_TILE_SIZE;
+		auto renderStart = std::chrono::steady_clock::now();
+
+		parallelRows(tileColumns * tileRows, threads, [&](int tile) {
+			TRACE_SCOPE("export tile");
+			int left = (tile % tileColumns) * EXPORT_TILE_SIZE, top = (tile / tileColumns) * EXPORT_TILE_SIZE;
+			int right = std::min(left + EXPORT_TILE_SIZE, view.width), bottom = std::min(top + EXPORT_TILE_SIZE, band.rowCount);
+
+			for (int row = top; row < bottom; ++row) {
+				unsigned char* pixel = band.rgb.data() + ((size_t)row * view.width + left) * 3;
+				for (int column = left; column < right; ++column, pixel += 3) {
+					coord c = imageToCoord(view, column + 0.5, band.firstRow + row + 0.5);
+					pixelEscape escape = iterateMandelbrotAnalyzed(c.x, c.y, view.maxIterations, distanceColoring, true);
+
+					std::array<unsigned char, 3> color = (periodColoring && escape.period != 0)
+						? periodColor(*palette, escape.period) : map_to_color(*palette, escape, paletteCycle);
+					if (distanceColoring)
+						color = shadeDistance(color, escape.distance / pixelWidth);
+					std::copy(color.begin(), color.end(), pixel);
+
+					if (raw != nullptr)
+						storeRawSample(escape, rawChannels, pixelWidth, band.samples.data() + ((size_t)row * view.width + column) * sampleFloats);
+				}
+			}
+		});
+
+		renderSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - renderStart).count();
+
+		{
+			std::lock_guard<std::mutex> lock(bandMutex);
+			band.filled = true;
+			bandChanged.notify_all();
+		}
+
+		int percent = (int)(100.0 * (band.firstRow + band.rowCount) / view.height);
+		if (percent / 5 != reportedPercent / 5) {
+			double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			std::cout << percent << "% after " << elapsed << " s, about " << elapsed * (100.0 - percent) / std::max(percent - startPercent, 1) << " s left\n";
+			reportedPercent = percent;
+		}
+	}
+
+	encoder.join();
+	bool written = png.finish();
+
+	if (raw != nullptr) {
+		if (!raw->finish()) {
+			std::cout << "ERROR:RAW_ITERATIONS_COULD_NOT_BE_WRITTEN " << rawPath << '\n';
+			written = false;
+		}
+		delete raw;
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "Exported " << positional[0] << " in " << seconds << " s (" << renderSeconds << " s computing, "
+		<< encodeSeconds << " s compressing)\n";
+
+	if (!written) {
+		std::cout << "ERROR:IMAGE_COULD_NOT_BE_WRITTEN " << positional[0] << '\n';
+		return 1;
+	}
+
+	std::error_code error;
+	std::filesystem::remove(checkpointPath, error);
+
+	return 0;
+}
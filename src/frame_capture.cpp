@@ -0,0 +1,216 @@
+#include "frame_capture.h"
+#include "png_writer.h"
+#include "trace.h"
+
+#include <iostream>
+#include <filesystem>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <ctime>
+
+
+// Current local time formatted for file names
+
+static std::string timestamp() {
+	std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+	char buffer[32];
+	std::strftime(buffer, sizeof(buffer), "%Y%m%d_%H%M%S", std::localtime(&now));
+	return buffer;
+}
+
+
+FrameCapture::FrameCapture(const char* outputDirectory)
+	: nextSlot(0), bufferMemory("capture buffers", memoryDomain::gpu), outputDirectory(outputDirectory), screenshotRequested(false), recording(false),
+	  recordedFrames(0), queueMemory("capture queue", memoryDomain::cpu), stopping(false) {
+
+	for (captureSlot& slot : slots) {
+		glGenBuffers(1, &slot.PBO);
+		slot.fence = nullptr;
+		slot.size = 0;
+	}
+
+	encoder = std::thread(&FrameCapture::encodeFrames, this);
+}
+
+
+FrameCapture::~FrameCapture() {
+	// Hand over the readbacks still in flight, then let the encoder drain the queue
+
+	for (size_t i = 0; i < CAPTURE_RING_SIZE; ++i)
+		collect((nextSlot + i) % CAPTURE_RING_SIZE);
+
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		stopping = true;
+	}
+	queueChanged.notify_all();
+	encoder.join();
+
+	for (captureSlot& slot : slots)
+		glDeleteBuffers(1, &slot.PBO);
+}
+
+
+void FrameCapture::requestScreenshot() {
+	screenshotRequested = true;
+}
+
+
+void FrameCapture::setRecording(const bool& enabled) {
+	if (enabled == recording)
+		return;
+	recording = enabled;
+
+	if (recording) {
+		recordingDirectory = outputDirectory + "/recording_" + timestamp();
+		recordedFrames = 0;
+		std::filesystem::create_directories(recordingDirectory);
+		std::cout << "Recording to " << recordingDirectory << '\n';
+	}
+	else
+		std::cout << "Recorded " << recordedFrames << " frames\n";
+}
+
+
+bool FrameCapture::isRecording() const {
+	return recording;
+}
+
+
+void FrameCapture::update(const int& width, const int& height) {
+	collect(CAPTURE_RING_SIZE);
+
+	if (screenshotRequested) {
+		screenshotRequested = false;
+		std::filesystem::create_directories(outputDirectory);
+		startReadback(width, height, outputDirectory + "/screenshot_" + timestamp() + ".png", Z_DEFAULT_COMPRESSION);
+	}
+
+	if (recording) {
+		char name[32];
+		std::snprintf(name, sizeof(name), "/frame_%06u.png", recordedFrames++);
+
+		// Recorded frames favour encoding speed over file size
+		startReadback(width, height, recordingDirectory + name, Z_BEST_SPEED);
+	}
+}
+
+
+void FrameCapture::startReadback(const int& width, const int& height, const std::string& path, const int& compressionLevel) {
+	// The slot about to be reused is the oldest, only wait for it if the whole ring is still in flight, which means the GPU
+	// is several frames behind
+
+	size_t index = nextSlot;
+	collect(index);
+	nextSlot = (nextSlot + 1) % CAPTURE_RING_SIZE;
+
+	captureSlot& slot = slots[index];
+
+	GLsizeiptr size = (GLsizeiptr)width * height * 4;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+	if (size != slot.size) {
+		glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+		bufferMemory.set(bufferMemory.get() + size - slot.size);
+		slot.size = size;
+	}
+
+	// With a pixel pack buffer bound the copy is queued on the GPU and glReadPixels returns immediately
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.width = width;
+	slot.height = height;
+	slot.path = path;
+	slot.compressionLevel = compressionLevel;
+}
+
+
+void FrameCapture::collect(const size_t& waitSlot) {
+	// Visit the slots from the oldest to the newest readback and stop at the first unfinished one, so that frames reach the
+	// encoder in order
+
+	for (size_t i = 0; i < CAPTURE_RING_SIZE; ++i) {
+		size_t index = (nextSlot + i) % CAPTURE_RING_SIZE;
+		captureSlot& slot = slots[index];
+		if (slot.fence == nullptr)
+			continue;
+
+		GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, index == waitSlot ? GL_TIMEOUT_IGNORED : 0);
+		if (status == GL_TIMEOUT_EXPIRED)
+			break;
+
+		glDeleteSync(slot.fence);
+		slot.fence = nullptr;
+
+		// The pixel buffer cannot be trusted if the wait failed, the frame is dropped and its slot freed
+		if (status == GL_WAIT_FAILED) {
+			std::cout << "ERROR:CAPTURE_FENCE_WAIT_FAILED " << slot.path << '\n';
+			continue;
+		}
+
+		capturedFrame frame{ std::vector<unsigned char>(slot.size), slot.width, slot.height, slot.path, slot.compressionLevel };
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+		void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.size, GL_MAP_READ_BIT);
+		if (mapped != nullptr) {
+			std::memcpy(frame.pixels.data(), mapped, slot.size);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		if (mapped == nullptr) {
+			std::cout << "ERROR:CAPTURE_BUFFER_COULD_NOT_BE_MAPPED\n";
+			continue;
+		}
+
+		// Apply back pressure only if the encoder has fallen far behind, so that no recorded frame is lost
+
+		std::unique_lock<std::mutex> lock(queueMutex);
+		queueChanged.wait(lock, [this] { return queue.size() < MAX_QUEUED_FRAMES; });
+		queueMemory.set(queueMemory.get() + (int64_t)frame.pixels.size());
+		queue.push_back(std::move(frame));
+		lock.unlock();
+		queueChanged.notify_all();
+	}
+}
+
+
+void FrameCapture::encodeFrames() {
+	setTraceThreadName("capture encoder");
+	std::vector<unsigned char> row;
+
+	while (true) {
+		std::unique_lock<std::mutex> lock(queueMutex);
+		queueChanged.wait(lock, [this] { return stopping || !queue.empty(); });
+		if (queue.empty())
+			return;
+
+		capturedFrame frame = std::move(queue.front());
+		queue.pop_front();
+		lock.unlock();
+		queueChanged.notify_all();
+		TRACE_SCOPE("encode capture");
+
+		// OpenGL returns the rows from bottom to top and with an alpha channel
+
+		PngWriter writer(frame.path.c_str(), frame.width, frame.height, frame.compressionLevel);
+		row.resize((size_t)frame.width * 3);
+
+		for (int y = frame.height - 1; y >= 0; --y) {
+			const unsigned char* source = frame.pixels.data() + (size_t)y * frame.width * 4;
+			for (int x = 0; x < frame.width; ++x)
+				std::memcpy(&row[(size_t)x * 3], source + (size_t)x * 4, 3);
+			writer.writeRows(row.data(), 1);
+		}
+
+		if (!writer.finish())
+			std::cout << "ERROR:FRAME_COULD_NOT_BE_WRITTEN " << frame.path << '\n';
+
+		lock.lock();
+		queueMemory.set(queueMemory.get() - (int64_t)frame.pixels.size());
+	}
+}
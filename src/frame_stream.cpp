@@ -0,0 +1,178 @@
+#include "frame_stream.h"
+
+#include <iostream>
+#include <algorithm>
+#include <csignal>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+
+bool parsePixelFormat(const std::string& name, rawPixelFormat& format) {
+	if (name == "rgb24")
+		format = rawPixelFormat::RGB24;
+	else if (name == "yuv420p")
+		format = rawPixelFormat::YUV420P;
+	else
+		return false;
+
+	return true;
+}
+
+
+const char* pixelFormatName(const rawPixelFormat& format) {
+	return (format == rawPixelFormat::YUV420P) ? "yuv420p" : "rgb24";
+}
+
+
+void rgbToYuv420(const unsigned char* rgb, const int& width, const int& height, unsigned char* yuv) {
+	unsigned char* luma = yuv;
+	unsigned char* blue = luma + (size_t)width * height;
+	unsigned char* red = blue + (size_t)(width / 2) * (height / 2);
+
+	// Fixed point BT.601 coefficients scaled by 256, luma is computed per pixel and chroma from the
+	// average of each 2 x 2 block
+
+	for (int y = 0; y < height; y += 2) {
+		for (int x = 0; x < width; x += 2) {
+			int sum[3] = { 0, 0, 0 };
+
+			for (int dy = 0; dy < 2; ++dy) {
+				for (int dx = 0; dx < 2; ++dx) {
+					const unsigned char* pixel = rgb + ((size_t)(y + dy) * width + x + dx) * 3;
+					luma[(size_t)(y + dy) * width + x + dx] = (unsigned char)((66 * pixel[0] + 129 * pixel[1] + 25 * pixel[2] + 128) / 256 + 16);
+					for (int channel = 0; channel < 3; ++channel)
+						sum[channel] += pixel[channel];
+				}
+			}
+
+			size_t index = (size_t)(y / 2) * (width / 2) + x / 2;
+			blue[index] = (unsigned char)((-38 * sum[0] - 74 * sum[1] + 112 * sum[2] + 512) / 1024 + 128);
+			red[index] = (unsigned char)((112 * sum[0] - 94 * sum[1] - 18 * sum[2] + 512) / 1024 + 128);
+		}
+	}
+}
+
+
+FrameStream::FrameStream(const std::string& target, const int& width, const int& height, const rawPixelFormat& format)
+	: out(nullptr), target(target), width(width), height(height), format(format), redirectedOutput(nullptr),
+	  hasPending(false), stopping(false), failed(false) {
+
+#ifndef _WIN32
+	// A reader that goes away must make the writes fail instead of terminating the process
+	std::signal(SIGPIPE, SIG_IGN);
+#endif
+
+	if (target == "-") {
+		std::cout.flush();
+		redirectedOutput = std::cout.rdbuf(std::cerr.rdbuf());
+#ifdef _WIN32
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		out = stdout;
+	}
+	else {
+		// Opening a named pipe blocks until the reader opens the other end
+		out = std::fopen(target.c_str(), "wb");
+	}
+
+	if (out == nullptr) {
+		std::cout << "ERROR:STREAM_COULD_NOT_BE_OPENED " << target << '\n';
+		failed = true;
+		return;
+	}
+
+	pending.resize((size_t)width * height * 3);
+	if (format == rawPixelFormat::YUV420P)
+		converted.resize(getFrameSize());
+
+	writer = std::thread(&FrameStream::writeFrames, this);
+}
+
+
+FrameStream::~FrameStream() {
+	finish();
+
+	if (redirectedOutput != nullptr)
+		std::cout.rdbuf(redirectedOutput);
+}
+
+
+void FrameStream::writeFrames() {
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(frameMutex);
+			frameChanged.wait(lock, [&]() { return hasPending || stopping; });
+			if (!hasPending)
+				return;
+		}
+
+		// The frame is converted and written without holding the lock, write waits for hasPending to be cleared
+
+		const unsigned char* data = pending.data();
+		if (format == rawPixelFormat::YUV420P) {
+			rgbToYuv420(pending.data(), width, height, converted.data());
+			data = converted.data();
+		}
+
+		bool written = std::fwrite(data, 1, getFrameSize(), out) == getFrameSize() && std::fflush(out) == 0;
+
+		std::lock_guard<std::mutex> lock(frameMutex);
+		hasPending = false;
+		if (!written)
+			failed = true;
+		frameChanged.notify_all();
+	}
+}
+
+
+bool FrameStream::write(const std::vector<unsigned char>& rgb) {
+	if (out == nullptr)
+		return false;
+
+	std::unique_lock<std::mutex> lock(frameMutex);
+	frameChanged.wait(lock, [&]() { return !hasPending; });
+	if (failed)
+		return false;
+
+	std::copy(rgb.begin(), rgb.begin() + std::min(rgb.size(), pending.size()), pending.begin());
+	hasPending = true;
+	frameChanged.notify_all();
+
+	return true;
+}
+
+
+bool FrameStream::finish() {
+	if (writer.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(frameMutex);
+			stopping = true;
+			frameChanged.notify_all();
+		}
+		writer.join();
+	}
+
+	if (out != nullptr) {
+		if (out == stdout)
+			failed |= std::fflush(out) != 0;
+		else
+			failed |= std::fclose(out) != 0;
+		out = nullptr;
+	}
+
+	return !failed;
+}
+
+
+bool FrameStream::isOpen() const {
+	return out != nullptr && !failed;
+}
+
+
+size_t FrameStream::getFrameSize() const {
+	size_t pixels = (size_t)width * height;
+	return (format == rawPixelFormat::YUV420P) ? pixels + pixels / 2 : pixels * 3;
+}
@@ -1,10 +1,24 @@
 #include "helpers.h"
+#include "trace.h"
+
+#include <iostream>
 
 
 coord off{ 0.0, 0.0 };
 double zoom = 1.0;
 int currentWidth, currentHeight;
 int maxIterations = 250;
+int paletteIndex = 0;
+bool histogramColoring = false;
+float paletteCycle = 256.0f;
+int samplePatternIndex = 1;
+bool distanceEstimation = false;
+bool interiorDetection = true;
+bool periodColoring = false;
+bool takeScreenshot = false, recordFrames = false;
+bool showHud = false;
+frameInput sessionInput{ false, 0.0, 0.0, false };
+inputStamp pendingInput{ -1.0, nullptr };
 
 
 void setWindowCallbacks(GLFWwindow* window) {
@@ -32,12 +46,19 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 }
 
 
-void cursor_position_callback(GLFWwindow* window, double xpos, double ypos) {}
+void cursor_position_callback(GLFWwindow* window, double xpos, double ypos) {
+	// Moving the cursor only changes the image while panning
+	if (isLeftButtonPressed(window))
+		stampInput("pan");
+}
 
 
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+	TRACE_SCOPE("key_callback");
 
 	if (action == GLFW_PRESS || action == GLFW_REPEAT) {
+		stampInput("key");
+
 		// Move by 1% in all directions
 		double lenx = (4.0 * currentWidth / currentHeight) / zoom;
 		int signx = -1 * (key == GLFW_KEY_A || key == GLFW_KEY_LEFT) + (key == GLFW_KEY_D || key == GLFW_KEY_RIGHT); // key A / LEFT ARROW pressed -> signx = -1 (moving right);  key D / RIGHT ARROW pressed -> signx = 1; (moving left)
@@ -69,14 +90,76 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 			zoom = std::max(zoom * 0.9, 0.5);
 			break;
 
-			// Increase iteration count when '+' key(same as '=' key) pressed
+			// Increase iteration count when '+' key(same as '=' key) pressed (tenfold when ctrl is held)
 		case GLFW_KEY_EQUAL:
-			maxIterations = std::min(maxIterations + 10, 2000);
+			if (mods & GLFW_MOD_CONTROL)
+				maxIterations = (int)std::min(maxIterations * 10ll, (long long)MAX_ITERATIONS);
+			else
+				maxIterations = std::min(maxIterations + 10, MAX_ITERATIONS);
 			break;
 
-			// Decrease iteration count when '-' key pressed
+			// Decrease iteration count when '-' key pressed (tenfold when ctrl is held)
 		case GLFW_KEY_MINUS:
-			maxIterations = std::max(maxIterations - 10, 50);
+			if (mods & GLFW_MOD_CONTROL)
+				maxIterations = std::max(maxIterations / 10, MIN_ITERATIONS);
+			else
+				maxIterations = std::max(maxIterations - 10, MIN_ITERATIONS);
+			break;
+
+			// Switch to the next palette when 'P' key pressed
+		case GLFW_KEY_P:
+			++paletteIndex;
+			break;
+
+			// Toggle histogram equalized coloring when 'H' key pressed
+		case GLFW_KEY_H:
+			histogramColoring = !histogramColoring;
+			break;
+
+			// Halve / double the number of iterations after which the palette repeats with '[' / ']' keys
+		case GLFW_KEY_LEFT_BRACKET:
+			paletteCycle = std::max(paletteCycle / 2, 4.0f);
+			break;
+
+		case GLFW_KEY_RIGHT_BRACKET:
+			paletteCycle = std::min(paletteCycle * 2, 65536.0f);
+			break;
+
+			// Switch to the next supersampling pattern when 'M' key pressed
+		case GLFW_KEY_M:
+			++samplePatternIndex;
+			break;
+
+			// Toggle distance estimation coloring and supersampling when 'E' key pressed
+		case GLFW_KEY_E:
+			distanceEstimation = !distanceEstimation;
+			break;
+
+			// Toggle the detection of the interior of the set when 'C' key pressed
+		case GLFW_KEY_C:
+			interiorDetection = !interiorDetection;
+			break;
+
+			// Toggle the coloring of the interior by the period of its attracting cycle when 'T' key pressed
+		case GLFW_KEY_T:
+			periodColoring = !periodColoring;
+			break;
+
+			// Save the next frame as a screenshot when 'F12' key pressed
+		case GLFW_KEY_F12:
+			takeScreenshot = true;
+			break;
+
+			// Start / stop recording every frame when 'R' key pressed
+		case GLFW_KEY_R:
+			if (action == GLFW_PRESS)
+				recordFrames = !recordFrames;
+			break;
+
+			// Show / hide the performance overlay when 'F3' key pressed
+		case GLFW_KEY_F3:
+			if (action == GLFW_PRESS)
+				showHud = !showHud;
 			break;
 
 			// Listen for Esc and close window when key pressed
@@ -89,19 +172,40 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 
 
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
+	TRACE_SCOPE("scroll_callback");
+	stampInput("scroll");
 	if (yoffset != 0.0f)
 		zoomOnPoint(window, (bool)(yoffset > 0)); // yoffset > 0 -> zoom in; yoffset < 0 -> zoom out
 }
 
 
 void getMouseCoordinates(GLFWwindow* window, double& xMousePos, double& yMousePos) {
-	glfwGetCursorPos(window, &xMousePos, &yMousePos);
+	if (sessionInput.active) {
+		xMousePos = sessionInput.cursorX;
+		yMousePos = sessionInput.cursorY;
+	}
+	else
+		glfwGetCursorPos(window, &xMousePos, &yMousePos);
 	yMousePos = currentHeight - yMousePos;
 	normalizeCoord(xMousePos, yMousePos);
 }
 
 
+bool isLeftButtonPressed(GLFWwindow* window) {
+	if (sessionInput.active)
+		return sessionInput.leftButton;
+	return glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+}
+
+
+void stampInput(const char* source) {
+	if (pendingInput.time < 0.0)
+		pendingInput = { glfwGetTime(), source };
+}
+
+
 void zoomOnPoint(GLFWwindow* window, bool mode) {
+	TRACE_SCOPE("zoomOnPoint");
 
 	double xMousePos, yMousePos;
 	getMouseCoordinates(window, xMousePos, yMousePos);
@@ -138,3 +242,60 @@ void normalizeCoord(double& x, double& y) {
 	x = (x / currentWidth - 0.5) * (lenx / zoom) + off.x;
 	y = (y / currentHeight - 0.5) * (leny / zoom) + off.y;
 }
+
+
+
+viewState getCurrentView() {
+	return { off, zoom, maxIterations, currentWidth, currentHeight };
+}
+
+
+coloringState getCurrentColoring() {
+	return { paletteIndex, histogramColoring, paletteCycle, samplePatternIndex, distanceEstimation, interiorDetection, periodColoring };
+}
+
+
+GLFWwindow* createSharedContext(GLFWwindow* window) {
+	// The context version hints of the main window are still set, only the visibility has to change
+
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	GLFWwindow* context = glfwCreateWindow(1, 1, "", nullptr, window);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+	return context;
+}
+
+
+GLFWwindow* createHeadlessContext() {
+	if (glfwInit() != GL_TRUE) {
+		std::cout << "Failed to initialize GLFW\n";
+		return nullptr;
+	}
+
+	// Same OpenGL 4.6 core context as the interactive window
+
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+	GLFWwindow* context = createSharedContext(nullptr);
+	if (context == nullptr) {
+		std::cout << "Failed to create GLFW window\n";
+		glfwTerminate();
+		return nullptr;
+	}
+
+	glfwMakeContextCurrent(context);
+
+	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+		std::cout << "Failed to initialize GLAD\n";
+		glfwDestroyWindow(context);
+		glfwTerminate();
+		return nullptr;
+	}
+
+	return context;
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#include "histogram.h"
+
+
+IterationHistogram::IterationHistogram(const char* histogramShaderPath, const char* prefixSumShaderPath)
+	: histogramProgram(histogramShaderPath), prefixSumProgram(prefixSumShaderPath), memory("histogram", memoryDomain::gpu) {
+
+	// Binding point 1 holds the bins, binding point 2 the cumulative distribution read by the fragment shader
+
+	glGenBuffers(1, &histogramSSBO);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, histogramSSBO);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, HISTOGRAM_BINS * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, histogramSSBO);
+
+	glGenBuffers(1, &cdfSSBO);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, cdfSSBO);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, HISTOGRAM_BINS * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, cdfSSBO);
+
+	memory.set(2 * HISTOGRAM_BINS * sizeof(GLuint));
+}
+
+
+IterationHistogram::~IterationHistogram() {
+	glDeleteBuffers(1, &histogramSSBO);
+	glDeleteBuffers(1, &cdfSSBO);
+}
+
+
+Shader& IterationHistogram::getHistogramProgram() {
+	return histogramProgram;
+}
+
+
+Shader& IterationHistogram::getPrefixSumProgram() {
+	return prefixSumProgram;
+}
+
+
+void IterationHistogram::update(const GLuint& pixelCount) {
+	// Empty the bins
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, histogramSSBO);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+	// One invocation per pixel adds its continuous iteration count to the bins
+
+	histogramProgram.setUInt("pixelCount", pixelCount);
+	glDispatchCompute((pixelCount + 255) / 256, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	// A single work group scans the bins into the cumulative distribution
+
+	prefixSumProgram.use();
+	glDispatchCompute(1, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
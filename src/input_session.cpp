@@ -0,0 +1,186 @@
+#include "input_session.h"
+
+#include <iostream>
+#include <sstream>
+#include <limits>
+
+
+// Recorder whose callbacks are installed, GLFW callbacks cannot carry a pointer of their own
+static InputRecorder* activeRecorder = nullptr;
+
+
+InputRecorder::InputRecorder(const std::string& path, GLFWwindow* window) : out(path), window(window), startTime(glfwGetTime()) {
+	if (!out) {
+		std::cout << "ERROR:INPUT_RECORDING_COULD_NOT_BE_OPENED " << path << '\n';
+		return;
+	}
+
+	// Doubles are written with enough digits to be read back exactly
+
+	out.precision(std::numeric_limits<double>::max_digits10);
+	out << "# mandelbrot-opengl input session\n";
+
+	activeRecorder = this;
+	sessionInput.active = true;
+	glfwSetKeyCallback(window, recordKey);
+	glfwSetScrollCallback(window, recordScroll);
+}
+
+
+InputRecorder::~InputRecorder() {
+	if (activeRecorder != this)
+		return;
+
+	glfwSetKeyCallback(window, key_callback);
+	glfwSetScrollCallback(window, scroll_callback);
+	sessionInput.active = false;
+	activeRecorder = nullptr;
+}
+
+
+bool InputRecorder::isOpen() const {
+	return (bool)out;
+}
+
+
+void InputRecorder::recordKey(GLFWwindow* window, int key, int scancode, int action, int mods) {
+	activeRecorder->out << "key " << glfwGetTime() - activeRecorder->startTime << ' ' << key << ' ' << scancode << ' ' << action << ' ' << mods << '\n';
+	key_callback(window, key, scancode, action, mods);
+}
+
+
+void InputRecorder::recordScroll(GLFWwindow* window, double xoffset, double yoffset) {
+	activeRecorder->out << "scroll " << glfwGetTime() - activeRecorder->startTime << ' ' << xoffset << ' ' << yoffset << '\n';
+	scroll_callback(window, xoffset, yoffset);
+}
+
+
+void InputRecorder::beginFrame() {
+	int width, height;
+	glfwGetFramebufferSize(window, &width, &height);
+	glfwGetCursorPos(window, &sessionInput.cursorX, &sessionInput.cursorY);
+	sessionInput.leftButton = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+
+	out << "frame " << glfwGetTime() - startTime << ' ' << width << ' ' << height << ' '
+		<< sessionInput.cursorX << ' ' << sessionInput.cursorY << ' ' << sessionInput.leftButton << '\n';
+}
+
+
+void InputRecorder::endFrame(const viewState& view) {
+	out << "view " << view.off.x << ' ' << view.off.y << ' ' << view.zoom << ' ' << view.maxIterations << '\n';
+}
+
+
+InputReplayer::InputReplayer(const std::string& path) : current(0), divergedFrames(0), loaded(false) {
+	std::ifstream in(path);
+	if (!in) {
+		std::cout << "ERROR:INPUT_RECORDING_NOT_FOUND " << path << '\n';
+		return;
+	}
+
+	std::string line;
+	int lineNumber = 0;
+
+	while (std::getline(in, line)) {
+		++lineNumber;
+		std::istringstream fields(line);
+		std::string type;
+		if (!(fields >> type) || type[0] == '#')
+			continue;
+
+		bool valid;
+		if (type == "frame") {
+			inputFrame frame{};
+			valid = (bool)(fields >> frame.time >> frame.width >> frame.height >> frame.cursorX >> frame.cursorY >> frame.leftButton);
+			frames.push_back(frame);
+		}
+		else if (type == "key" && !frames.empty()) {
+			inputEvent event{};
+			event.isKey = true;
+			valid = (bool)(fields >> event.time >> event.key >> event.scancode >> event.action >> event.mods);
+			frames.back().events.push_back(event);
+		}
+		else if (type == "scroll" && !frames.empty()) {
+			inputEvent event{};
+			valid = (bool)(fields >> event.time >> event.xoffset >> event.yoffset);
+			frames.back().events.push_back(event);
+		}
+		else if (type == "view" && !frames.empty()) {
+			viewState& view = frames.back().view;
+			valid = (bool)(fields >> view.off.x >> view.off.y >> view.zoom >> view.maxIterations);
+		}
+		else
+			valid = false;
+
+		if (!valid) {
+			std::cout << "ERROR:INVALID_INPUT_RECORDING " << path << ':' << lineNumber << '\n';
+			return;
+		}
+	}
+
+	loaded = true;
+}
+
+
+bool InputReplayer::isLoaded() const {
+	return loaded;
+}
+
+
+void InputReplayer::getInitialSize(int& width, int& height) const {
+	if (!frames.empty()) {
+		width = frames.front().width;
+		height = frames.front().height;
+	}
+}
+
+
+bool InputReplayer::beginFrame(GLFWwindow* window) {
+	if (current >= frames.size()) {
+		sessionInput.active = false;
+		return false;
+	}
+
+	const inputFrame& frame = frames[current];
+	sessionInput = { true, frame.cursorX, frame.cursorY, frame.leftButton };
+
+	int width, height;
+	glfwGetFramebufferSize(window, &width, &height);
+	if (width != frame.width || height != frame.height)
+		glfwSetWindowSize(window, frame.width, frame.height);
+
+	return true;
+}
+
+
+void InputReplayer::dispatchEvents(GLFWwindow* window) {
+	for (const inputEvent& event : frames[current].events) {
+		if (event.isKey)
+			key_callback(window, event.key, event.scancode, event.action, event.mods);
+		else
+			scroll_callback(window, event.xoffset, event.yoffset);
+	}
+}
+
+
+void InputReplayer::endFrame(const viewState& view) {
+	const viewState& recorded = frames[current].view;
+
+	if (view.off != recorded.off || view.zoom != recorded.zoom || view.maxIterations != recorded.maxIterations) {
+		if (divergedFrames == 0)
+			std::cout << "ERROR:REPLAY_DIVERGED frame " << current << '\n';
+		++divergedFrames;
+	}
+
+	++current;
+}
+
+
+size_t InputReplayer::getFrameCount() const {
+	return current;
+}
+
+
+unsigned InputReplayer::getDivergedFrames() const {
+	return divergedFrames;
+}
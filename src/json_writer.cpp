@@ -0,0 +1,165 @@
+#include "json_writer.h"
+
+#include <cmath>
+#include <cstdio>
+#include <charconv>
+
+
+JsonWriter::JsonWriter(std::ostream& out) : out(out), afterKey(false) {}
+
+
+void JsonWriter::indent() {
+	out << '\n';
+	for (size_t i = 0; i < firstElement.size(); ++i)
+		out << '\t';
+}
+
+
+void JsonWriter::beginElement() {
+	// A value that follows its key is already positioned
+
+	if (afterKey) {
+		afterKey = false;
+		return;
+	}
+
+	if (!firstElement.empty()) {
+		if (!firstElement.back())
+			out << ',';
+		firstElement.back() = false;
+		indent();
+	}
+}
+
+
+void JsonWriter::beginObject() {
+	beginElement();
+	out << '{';
+	firstElement.push_back(true);
+}
+
+
+void JsonWriter::endObject() {
+	bool empty = firstElement.back();
+	firstElement.pop_back();
+	if (!empty)
+		indent();
+	out << '}';
+
+	if (firstElement.empty())
+		out << '\n';
+}
+
+
+void JsonWriter::beginArray() {
+	beginElement();
+	out << '[';
+	firstElement.push_back(true);
+}
+
+
+void JsonWriter::endArray() {
+	bool empty = firstElement.back();
+	firstElement.pop_back();
+	if (!empty)
+		indent();
+	out << ']';
+
+	if (firstElement.empty())
+		out << '\n';
+}
+
+
+void JsonWriter::key(const std::string& name) {
+	beginElement();
+	writeString(name);
+	out << ": ";
+	afterKey = true;
+}
+
+
+void JsonWriter::value(const std::string& text) {
+	beginElement();
+	writeString(text);
+}
+
+
+void JsonWriter::writeString(const std::string& text) {
+	out << '"';
+
+	for (char character : text) {
+		switch (character) {
+		case '"': out << "\\\""; break;
+		case '\\': out << "\\\\"; break;
+		case '\n': out << "\\n"; break;
+		case '\r': out << "\\r"; break;
+		case '\t': out << "\\t"; break;
+		default:
+			if ((unsigned char)character < 0x20) {
+				char escaped[8];
+				std::snprintf(escaped, sizeof(escaped), "\\u%04x", character);
+				out << escaped;
+			}
+			else
+				out << character;
+		}
+	}
+
+	out << '"';
+}
+
+
+void JsonWriter::value(const char* text) {
+	value(std::string(text));
+}
+
+
+void JsonWriter::value(const double& number) {
+	// JSON has no representation for infinities and NaN
+
+	if (!std::isfinite(number)) {
+		null();
+		return;
+	}
+
+	// Shortest representation that reads back as the same number
+
+	beginElement();
+	char formatted[32];
+	auto result = std::to_chars(formatted, formatted + sizeof(formatted), number);
+	out.write(formatted, result.ptr - formatted);
+}
+
+
+void JsonWriter::value(const int64_t& number) {
+	beginElement();
+	out << number;
+}
+
+
+void JsonWriter::value(const uint64_t& number) {
+	beginElement();
+	out << number;
+}
+
+
+void JsonWriter::value(const int& number) {
+	value((int64_t)number);
+}
+
+
+void JsonWriter::value(const unsigned& number) {
+	value((uint64_t)number);
+}
+
+
+void JsonWriter::value(const bool& flag) {
+	beginElement();
+	out << (flag ? "true" : "false");
+}
+
+
+void JsonWriter::null() {
+	beginElement();
+	out << "null";
+}
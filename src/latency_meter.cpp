@@ -0,0 +1,236 @@
+#include "latency_meter.h"
+#include "trace.h"
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+
+// Sources the summary is split into, in the order they are printed
+static const char* LATENCY_SOURCES[] = { "key", "scroll", "pan" };
+
+
+latencyPercentiles computeLatencyPercentiles(std::vector<double> milliseconds) {
+	latencyPercentiles percentiles;
+	percentiles.count = milliseconds.size();
+	if (milliseconds.empty())
+		return percentiles;
+
+	std::sort(milliseconds.begin(), milliseconds.end());
+
+	// Smallest value that at least the fraction q of the values do not exceed
+	auto rank = [&](const double& q) {
+		size_t index = (size_t)std::ceil(q * milliseconds.size());
+		return milliseconds[std::max<size_t>(index, 1) - 1];
+	};
+
+	percentiles.p50 = rank(0.5);
+	percentiles.p90 = rank(0.9);
+	percentiles.p99 = rank(0.99);
+	percentiles.p999 = rank(0.999);
+	percentiles.max = milliseconds.back();
+	return percentiles;
+}
+
+
+LatencyMeter::LatencyMeter(const std::string& logPath)
+	: slots{}, nextSlot(0), frame(0), frameInput{ -1.0, nullptr }, gpuClockOffset(0.0), lastCalibration(0.0), json(nullptr) {
+	for (latencySlot& slot : slots) {
+		glGenQueries(1, &slot.query);
+		slot.pending = false;
+	}
+
+	calibrate();
+
+	if (logPath.empty())
+		return;
+
+	out.open(logPath);
+	if (!out) {
+		std::cout << "ERROR:LATENCY_LOG_COULD_NOT_BE_OPENED " << logPath << '\n';
+		return;
+	}
+
+	if (logPath.size() >= 5 && logPath.compare(logPath.size() - 5, 5, ".json") == 0) {
+		json = new JsonWriter(out);
+		json->beginArray();
+	}
+	else {
+		// Fixed decimals, so that the input time keeps its microseconds however long the program has run
+		out << std::fixed << std::setprecision(6);
+		out << "frame,source,input_time,submit_ms,present_ms\n";
+	}
+}
+
+
+LatencyMeter::~LatencyMeter() {
+	for (size_t i = 0; i < LATENCY_QUERY_RING_SIZE; ++i)
+		collect((nextSlot + i) % LATENCY_QUERY_RING_SIZE);
+
+	for (latencySlot& slot : slots)
+		glDeleteQueries(1, &slot.query);
+
+	if (json != nullptr) {
+		json->endArray();
+		out << '\n';
+		delete json;
+	}
+}
+
+
+bool LatencyMeter::isOpen() const {
+	return !out.fail();
+}
+
+
+void LatencyMeter::calibrate() {
+	// GL_TIMESTAMP read this way is the GPU time at which the commands issued so far have reached the GPU
+
+	GLint64 gpuNanoseconds = 0;
+	double before = glfwGetTime();
+	glGetInteger64v(GL_TIMESTAMP, &gpuNanoseconds);
+	double after = glfwGetTime();
+
+	gpuClockOffset = (before + after) / 2 - gpuNanoseconds * 1e-9;
+	lastCalibration = after;
+}
+
+
+void LatencyMeter::beginFrame() {
+	frameInput = pendingInput;
+	pendingInput.time = -1.0;
+}
+
+
+void LatencyMeter::endFrame() {
+	double submitTime = glfwGetTime();
+	uint64_t current = frame++;
+
+	collect(LATENCY_QUERY_RING_SIZE);
+
+	if (frameInput.time < 0.0)
+		return;
+
+	// Only the slot about to be reused has to be waited for
+
+	size_t index = nextSlot;
+	if (slots[index].pending)
+		collect(index);
+	nextSlot = (nextSlot + 1) % LATENCY_QUERY_RING_SIZE;
+
+	latencySlot& slot = slots[index];
+
+	glQueryCounter(slot.query, GL_TIMESTAMP);
+	slot.pending = true;
+	slot.frame = current;
+	slot.input = frameInput;
+	slot.submitTime = submitTime;
+	frameInput.time = -1.0;
+}
+
+
+void LatencyMeter::collect(const size_t& waitSlot) {
+	// The slots finish in the order they were submitted, starting with the slot about to be reused
+
+	for (size_t i = 0; i < LATENCY_QUERY_RING_SIZE; ++i) {
+		size_t index = (nextSlot + i) % LATENCY_QUERY_RING_SIZE;
+		latencySlot& slot = slots[index];
+		if (!slot.pending)
+			continue;
+
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(slot.query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available && index != waitSlot)
+			break;
+
+		GLuint64 gpuNanoseconds = 0;
+		glGetQueryObjectui64v(slot.query, GL_QUERY_RESULT, &gpuNanoseconds);
+		slot.pending = false;
+
+		if (glfwGetTime() - lastCalibration >= LATENCY_CALIBRATION_INTERVAL)
+			calibrate();
+
+		// The frame cannot have been presented before it was submitted (the clocks are only calibrated to a few microseconds)
+		double presentTime = std::max(gpuNanoseconds * 1e-9 + gpuClockOffset, slot.submitTime);
+
+		latencySample sample{ slot.frame, slot.input.source, slot.input.time,
+			1000.0 * (slot.submitTime - slot.input.time), 1000.0 * (presentTime - slot.input.time) };
+		samples.push_back(sample);
+		write(sample);
+
+		if (traceEnabled.load(std::memory_order_relaxed)) {
+			int64_t now = traceNow();
+			double cpuNow = glfwGetTime();
+			recordTraceEvent("input to present", now - (int64_t)((cpuNow - slot.input.time) * 1e9), now - (int64_t)((cpuNow - presentTime) * 1e9));
+		}
+	}
+}
+
+
+void LatencyMeter::write(const latencySample& sample) {
+	if (!out.is_open() || !out)
+		return;
+
+	if (json == nullptr) {
+		out << sample.frame << ',' << sample.source << ',' << sample.inputTime << ',' << sample.submitMilliseconds << ',' << sample.presentMilliseconds << '\n';
+		return;
+	}
+
+	json->beginObject();
+	json->key("frame");
+	json->value(sample.frame);
+	json->key("source");
+	json->value(sample.source);
+	json->key("input_time");
+	json->value(sample.inputTime);
+	json->key("submit_ms");
+	json->value(sample.submitMilliseconds);
+	json->key("present_ms");
+	json->value(sample.presentMilliseconds);
+	json->endObject();
+}
+
+
+latencyPercentiles LatencyMeter::getRecentPercentiles() const {
+	std::vector<double> milliseconds;
+	size_t first = samples.size() - std::min(samples.size(), LATENCY_RECENT_SAMPLES);
+	for (size_t i = first; i < samples.size(); ++i)
+		milliseconds.push_back(samples[i].presentMilliseconds);
+
+	return computeLatencyPercentiles(std::move(milliseconds));
+}
+
+
+latencyPercentiles LatencyMeter::getPercentiles(const char* source, const bool& present) const {
+	std::vector<double> milliseconds;
+	for (const latencySample& sample : samples)
+		if (source == nullptr || std::strcmp(sample.source, source) == 0)
+			milliseconds.push_back(present ? sample.presentMilliseconds : sample.submitMilliseconds);
+
+	return computeLatencyPercentiles(std::move(milliseconds));
+}
+
+
+void LatencyMeter::printSummary() {
+	for (size_t i = 0; i < LATENCY_QUERY_RING_SIZE; ++i)
+		collect((nextSlot + i) % LATENCY_QUERY_RING_SIZE);
+
+	auto print = [](const char* label, const latencyPercentiles& percentiles) {
+		char line[160];
+		std::snprintf(line, sizeof(line), "  %-8s %6zu  p50 %7.2f  p90 %7.2f  p99 %7.2f  p99.9 %7.2f  max %7.2f\n", label, percentiles.count,
+			percentiles.p50, percentiles.p90, percentiles.p99, percentiles.p999, percentiles.max);
+		std::cout << line;
+	};
+
+	std::cout << "Input to present latency (ms):\n";
+	print("all", getPercentiles(nullptr));
+	for (const char* source : LATENCY_SOURCES)
+		if (getPercentiles(source).count > 0)
+			print(source, getPercentiles(source));
+
+	std::cout << "Input to submit latency (ms):\n";
+	print("all", getPercentiles(nullptr, false));
+}
@@ -7,17 +7,74 @@
 #include <GLFW/glfw3.h>
 #include "shader.h"
 #include "helpers.h"
+#include "pixel_state.h"
+#include "palette.h"
+#include "histogram.h"
+#include "supersampler.h"
+#include "frame_capture.h"
+#include "shader_reloader.h"
+#include "performance_hud.h"
+#include "escape_stats_pass.h"
+#include "input_session.h"
+#include "latency_meter.h"
+#include "cli.h"
+#include "trace.h"
 
 
 // Set default WIDTH and HEIGHT values
 constexpr GLint WIDTH = 800, HEIGHT = 600;
 
 // Set the paths to the shaders
+const char* SHADERS_PATH = "./shaders";
 const char* VERTEX_SHADER_PATH = "./shaders/vertex_shader.glsl";
 const char* FRAGMENT_SHADER_PATH = "./shaders/fragment_shader.glsl";
+const char* HISTOGRAM_SHADER_PATH = "./shaders/histogram_compute.glsl";
+const char* PREFIX_SUM_SHADER_PATH = "./shaders/prefix_sum_compute.glsl";
+const char* SUPERSAMPLE_SHADER_PATH = "./shaders/supersample_fragment.glsl";
+const char* HUD_SHADER_PATH = "./shaders/hud_fragment.glsl";
+const char* ESCAPE_STATS_SHADER_PATH = "./shaders/escape_stats_compute.glsl";
+
+// Set the directory the palettes are loaded from
+const char* PALETTES_PATH = "./palettes";
+
+// Set the directory screenshots and recordings are written to
+const char* CAPTURES_PATH = "./captures";
+
+// Maximum number of iterations a pixel advances per frame, so that a single draw stays short
+// even for iteration counts in the millions (the image converges over several frames)
+constexpr GLuint ITERATIONS_PER_FRAME = 1000;
+
+// Variance of log2(continuous iteration count + 1) around a pixel above which it gets supersampled
+constexpr GLfloat EDGE_THRESHOLD = 0.005f;
+
+// Minimum time between two updates of the window title (each one is a round trip to the window manager)
+constexpr double TITLE_UPDATE_INTERVAL = 0.25;
+
+// Precision of the iteration in the fragment shader, shown by the performance overlay
+const char* ITERATION_PRECISION = "fp64";
 
 
 int main(int argc, char** argv) {
+
+	// Headless modes selected on the command line run without a window
+
+	int exitCode;
+	if (runCommandLineMode(argc, argv, exitCode))
+		return exitCode;
+
+	// A replayed input session drives a hidden window instead of the user
+
+	const globalOptions& options = getGlobalOptions();
+	InputReplayer* replayer = nullptr;
+	int windowWidth = WIDTH, windowHeight = HEIGHT;
+	if (!options.replayInputPath.empty()) {
+		replayer = new InputReplayer(options.replayInputPath);
+		if (!replayer->isLoaded()) {
+			delete replayer;
+			return -1;
+		}
+		replayer->getInitialSize(windowWidth, windowHeight);
+	}
 	
 	// -------------------------------- INIT ------------------------------- //
 	
@@ -39,11 +96,13 @@ int main(int argc, char** argv) {
 #ifdef __APPLE_
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
-    glfwWindowHint(GLFW_SAMPLES, 4);
+
+	if (replayer != nullptr)
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
     // Create a window
 
-	GLFWwindow* window = glfwCreateWindow(WIDTH, HEIGHT, "Mandelbrot zoom", nullptr, nullptr);
+	GLFWwindow* window = glfwCreateWindow(windowWidth, windowHeight, "Mandelbrot zoom", nullptr, nullptr);
 
 	if (window == nullptr) {
 		std::cout << "Failed to create GLFW window\n";
@@ -62,14 +121,68 @@ int main(int argc, char** argv) {
 		std::cout << "Failed to initialize GLAD\n";
 		return -1;
 	}
+
+	// A replay renders its frames back to back, a recording wraps the input callbacks set above
+
+	InputRecorder* recorder = nullptr;
+	if (replayer != nullptr)
+		glfwSwapInterval(0);
+	else if (!options.recordInputPath.empty()) {
+		recorder = new InputRecorder(options.recordInputPath, window);
+		if (!recorder->isOpen()) {
+			glfwTerminate();
+			return -1;
+		}
+	}
 	
 
 	// -------------------------------- SHADERS ------------------------------- //
 
 
 	Shader shaderProgram(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH);
+
+	IterationHistogram histogram(HISTOGRAM_SHADER_PATH, PREFIX_SUM_SHADER_PATH);
+
+	EdgeSupersampler supersampler(VERTEX_SHADER_PATH, SUPERSAMPLE_SHADER_PATH);
+
+	PerformanceHud hud(VERTEX_SHADER_PATH, HUD_SHADER_PATH);
+
+	// Input to present latency, shown by the overlay and logged with --latency-log
+
+	LatencyMeter* latency = new LatencyMeter(options.latencyLogPath);
+	if (!latency->isOpen()) {
+		glfwTerminate();
+		return -1;
+	}
+
+	// Escape statistics of every frame, only reduced when they are logged
+
+	EscapeStatisticsLog* statisticsLog = nullptr;
+	EscapeStatisticsPass* statistics = nullptr;
+	if (!options.statisticsLogPath.empty()) {
+		statisticsLog = new EscapeStatisticsLog(options.statisticsLogPath);
+		statistics = new EscapeStatisticsPass(ESCAPE_STATS_SHADER_PATH, statisticsLog);
+	}
+
+	// Rebuild the programs in the background whenever their sources change
+
+	ShaderReloader* reloader = new ShaderReloader(window, SHADERS_PATH);
+	reloader->watch(shaderProgram);
+	reloader->watch(histogram.getHistogramProgram());
+	reloader->watch(histogram.getPrefixSumProgram());
+	reloader->watch(supersampler.getProgram());
+	reloader->watch(hud.getProgram());
+	if (statistics != nullptr)
+		reloader->watch(statistics->getProgram());
+	reloader->start();
 	
 
+	// -------------------------------- PALETTES ------------------------------- //
+
+
+	std::vector<std::unique_ptr<Palette>> palettes = loadPalettes(PALETTES_PATH);
+
+
 	// -------------------------------- VERTEX DATA ------------------------------- //
 
 
@@ -108,6 +221,9 @@ int main(int argc, char** argv) {
 	
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+	TrackedMemory geometryMemory("geometry", memoryDomain::gpu);
+	geometryMemory.set(sizeof(vertices) + sizeof(indices));
 	
 	// Configure vertex attributes
 
@@ -120,37 +236,136 @@ int main(int argc, char** argv) {
 	glBindVertexArray(0);
 
 
+	// -------------------------------- PIXEL STATE ------------------------------- //
+
+
+	// Per pixel iteration state, resumed every frame by the fragment shader
+
+	PixelStateBuffer pixelState(0);
+	viewState renderedView{};
+	GLuint framesSinceReset = 0;
+	uint64_t frameNumber = 0;
+
+	// Supersampled edge colors are cached until the coloring settings change
+
+	coloringState renderedColoring = getCurrentColoring();
+	GLuint supersampleGeneration = 1;
+	bool coloringSettled = false;
+
+
+	// -------------------------------- CAPTURE ------------------------------- //
+
+
+	// Frames are read back asynchronously and encoded on a background thread
+
+	FrameCapture* capture = new FrameCapture(CAPTURES_PATH);
+
+
 	// -------------------------------- RENDERING ------------------------------- //
 	
 
 	bool isPanning = false;
 	double xPrevPos = 0.0, yPrevPos = 0.0;
+	double lastTitleUpdate = -TITLE_UPDATE_INTERVAL;
+	double replayStart = glfwGetTime();
 	
-	// Render loop. Keep the window up until it is closed
+	// Render loop. Keep the window up until it is closed, or until the last frame of a replay
 
 	while (!glfwWindowShouldClose(window)) {
+		TRACE_SCOPE("frame");
+
+		// Sample the input the frame uses
+
+		if (replayer != nullptr && !replayer->beginFrame(window))
+			break;
+		if (recorder != nullptr)
+			recorder->beginFrame();
+		latency->beginFrame();
+
+		// Use the programs that were rebuilt since the last frame
+
+		reloader->update();
+
+		// Measure the frame time, and the GPU time and iteration count of the passes below while the overlay is shown
+		hud.beginFrame(showHud);
 
 		// Draw the shape
 
-		shaderProgram.use();
+		{
+			TRACE_SCOPE("shader setup");
+			shaderProgram.use();
+
+			// Pass window width and height to the shader
+			glfwGetFramebufferSize(window, &currentWidth, &currentHeight);
+			shaderProgram.setValues(currentWidth, currentHeight, off.x, off.y, zoom, maxIterations);
+			shaderProgram.setUInt("iterationsPerFrame", ITERATIONS_PER_FRAME);
+			shaderProgram.setUInt("countIterations", showHud ? 1 : 0);
+		}
+
+		// Start over if anything that affects the image has changed since the last frame, except for a higher iteration count:
+		// the shader resumes every pixel below it, so the unfinished pixels continue from where the lower count stopped them
+		viewState currentView = getCurrentView();
+		viewState previousCount = currentView;
+		previousCount.maxIterations = renderedView.maxIterations;
+		bool countRaised = previousCount == renderedView && currentView.maxIterations > renderedView.maxIterations;
+
+		if (currentView.width != renderedView.width || currentView.height != renderedView.height) {
+			pixelState.resize(currentWidth, currentHeight);
+			supersampler.resize(currentWidth, currentHeight);
+		}
+		else if (currentView != renderedView && !countRaised)
+			pixelState.reset();
+
+		if (countRaised) {
+			// The pixels stopped by the lower count have not progressed since, and the edges have to be supersampled again
+			framesSinceReset = std::min<GLuint>(framesSinceReset, (GLuint)renderedView.maxIterations / ITERATIONS_PER_FRAME);
+			++supersampleGeneration;
+			coloringSettled = false;
+		}
+		else if (currentView != renderedView) {
+			// The samples in progress belong to the previous view
+			framesSinceReset = 0;
+			++supersampleGeneration;
+		}
+		renderedView = currentView;
+
+		// Pass the coloring settings to the shader
+		palettes[paletteIndex % palettes.size()]->bind(0);
+		shaderProgram.setColoring(0, paletteCycle, histogramColoring ? 1 : 0);
+		shaderProgram.setUInt("distanceEstimation", distanceEstimation ? 1 : 0);
+		shaderProgram.setUInt("interiorDetection", interiorDetection ? 1 : 0);
+		shaderProgram.setUInt("periodColoring", periodColoring ? 1 : 0);
+
+		coloringState currentColoring = getCurrentColoring();
+		if (currentColoring != renderedColoring) {
+			++supersampleGeneration;
+			coloringSettled = false;
+		}
 
-		// Pass window width and height to the shader
-		glfwGetFramebufferSize(window, &currentWidth, &currentHeight);
-        shaderProgram.setValues(currentWidth, currentHeight, off.x, off.y, zoom, maxIterations);
+		// The derivative and the atom domains of the pixels are only valid if they were tracked from the first iteration
+		if (currentColoring.distanceEstimation != renderedColoring.distanceEstimation
+			|| currentColoring.interiorDetection != renderedColoring.interiorDetection) {
+			pixelState.reset();
+			framesSinceReset = 0;
+		}
+		renderedColoring = currentColoring;
 
 		// Get current cursor position
 		double xCurrentPos, yCurrentPos;
 		getMouseCoordinates(window, xCurrentPos, yCurrentPos);
 
-		// Update titlebar information
-		glfwSetWindowTitle(window, std::format("Mandelbrot zoom | Mouse location: x={} y={} | Zoom={} | Iteration count={}", xCurrentPos, yCurrentPos, zoom, maxIterations).c_str());
+		// Update titlebar information a few times per second
+		if (glfwGetTime() - lastTitleUpdate >= TITLE_UPDATE_INTERVAL) {
+			glfwSetWindowTitle(window, std::format("Mandelbrot zoom | Mouse location: x={} y={} | Zoom={} | Iteration count={}{}", xCurrentPos, yCurrentPos, zoom, maxIterations, capture->isRecording() ? " | Recording" : "").c_str());
+			lastTitleUpdate = glfwGetTime();
+		}
 
 		if (isPanning) {
 			// Change the offset position according to the mouse movement
 			off.x -= (xCurrentPos - xPrevPos);
 			off.y -= (yCurrentPos - yPrevPos);
 		}
-		else if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS){
+		else if (isLeftButtonPressed(window)){
 			isPanning = true;
 			
 			// Remember the position of the mouse when starting panning
@@ -158,17 +373,118 @@ int main(int argc, char** argv) {
 			yPrevPos = yCurrentPos;
 		}
 		// If left click is released, stop panning
-		isPanning = (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) != GLFW_RELEASE);
+		isPanning = isLeftButtonPressed(window);
+
+		{
+			TRACE_SCOPE("draw");
+			glBindVertexArray(VAO);
+			glDrawElements(GL_TRIANGLES, sizeof(indices) / sizeof(GLuint), GL_UNSIGNED_INT, (GLvoid*) nullptr);
+
+			// Make the stored pixel states visible to the next pass
+			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		}
+
+		// Supersample the edges once every pixel has converged and the histogram matches the coloring settings
+		const samplePattern& pattern = SAMPLE_PATTERNS[samplePatternIndex % SAMPLE_PATTERNS.size()];
+		bool converged = (GLuint64)framesSinceReset * ITERATIONS_PER_FRAME >= (GLuint64)maxIterations;
+
+		if (!pattern.offsets.empty() && converged && coloringSettled) {
+			TRACE_SCOPE("supersample");
+
+			// Limit the work to what the iteration of a frame may cost
+			GLuint costBudget = (GLuint)std::min<GLuint64>((GLuint64)currentWidth * currentHeight * ITERATIONS_PER_FRAME / 1000, UINT32_MAX / 2);
 
-		glBindVertexArray(VAO);
-		glDrawElements(GL_TRIANGLES, sizeof(indices) / sizeof(GLuint), GL_UNSIGNED_INT, (GLvoid*) nullptr);
+			Shader& supersampleProgram = supersampler.getProgram();
+			supersampleProgram.setValues(currentWidth, currentHeight, off.x, off.y, zoom, maxIterations);
+			supersampleProgram.setUInt("iterationsPerFrame", ITERATIONS_PER_FRAME);
+			supersampleProgram.setColoring(0, paletteCycle, histogramColoring ? 1 : 0);
+			supersampleProgram.setUInt("distanceEstimation", distanceEstimation ? 1 : 0);
+			supersampleProgram.setUInt("interiorDetection", interiorDetection ? 1 : 0);
+			supersampleProgram.setUInt("periodColoring", periodColoring ? 1 : 0);
+			supersampler.prepare(pattern, supersampleGeneration, costBudget, EDGE_THRESHOLD);
 
-		glfwSwapBuffers(window);
+			glDrawElements(GL_TRIANGLES, sizeof(indices) / sizeof(GLuint), GL_UNSIGNED_INT, (GLvoid*) nullptr);
+			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		}
+
+		hud.endFrame();
+
+		if (statistics != nullptr) {
+			TRACE_SCOPE("escape statistics");
+			statistics->update(frameNumber, currentWidth * currentHeight, maxIterations);
+		}
+
+		++framesSinceReset;
+		++frameNumber;
+		coloringSettled = true;
+
+		// Queue the readback of the finished frame if it has to be captured
+		if (takeScreenshot) {
+			capture->requestScreenshot();
+			takeScreenshot = false;
+		}
+		capture->setRecording(recordFrames);
+		capture->update(currentWidth, currentHeight);
+
+		// Build the histogram used to color the next frame
+		if (histogramColoring) {
+			TRACE_SCOPE("histogram");
+			histogram.update(currentWidth * currentHeight);
+		}
+
+		// The overlay is drawn after the readback, so it does not appear in screenshots and recordings
+		if (showHud) {
+			TRACE_SCOPE("hud");
+			latencyPercentiles recentLatency = latency->getRecentPercentiles();
+			hud.setInputLatency(recentLatency.count > 0 ? recentLatency.p50 : -1.0, recentLatency.p99);
+			glBindVertexArray(VAO);
+			hud.draw(currentView, ITERATION_PRECISION);
+		}
+
+		{
+			TRACE_SCOPE("swap buffers");
+			glfwSwapBuffers(window);
+		}
+		latency->endFrame();
+
+		// The input callbacks run in here
+		TRACE_SCOPE("poll events");
 		glfwPollEvents();
+
+		if (replayer != nullptr) {
+			replayer->dispatchEvents(window);
+			replayer->endFrame(getCurrentView());
+		}
+		if (recorder != nullptr)
+			recorder->endFrame(getCurrentView());
 	}
 
+	if (replayer != nullptr) {
+		double seconds = glfwGetTime() - replayStart;
+		std::cout << "Replayed " << replayer->getFrameCount() << " frames in " << seconds << " s ("
+			<< replayer->getFrameCount() / seconds << " frames/s), " << replayer->getDivergedFrames() << " frames diverged from the recording\n";
+		exitCode = (replayer->getDivergedFrames() == 0) ? 0 : 1;
+	}
+	else
+		exitCode = 0;
+
+	if (!options.latencyLogPath.empty())
+		latency->printSummary();
+
+	// Write the frames that are still being captured
+
+	delete capture;
+	delete reloader;
+	delete statistics;
+	delete statisticsLog;
+	delete latency;
+	delete recorder;
+	delete replayer;
+
+	palettes.clear();
+
 	// Delete all GLFW resources allocated
 
 	glfwTerminate();
-	return 0;
+	return exitCode;
 }
\ No newline at end of file
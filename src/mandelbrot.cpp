@@ -0,0 +1,276 @@
+#include "mandelbrot.h"
+#include "trace.h"
+
+#include <cmath>
+#include <complex>
+#include <thread>
+#include <atomic>
+
+
+pixelEscape iterateMandelbrot(const double& cx, const double& cy, const uint32_t& maxIterations) {
+	double x = 0.0, y = 0.0;
+	double x2 = 0.0, y2 = 0.0;
+	uint32_t iteration = 0;
+
+	while (x2 + y2 <= ESCAPE_RADIUS_SQUARED && iteration < maxIterations) {
+		y = 2 * x * y + cy;
+		x = x2 - y2 + cx;
+		x2 = x * x;
+		y2 = y * y;
+		++iteration;
+	}
+
+	return { x, y, iteration, x2 + y2 > ESCAPE_RADIUS_SQUARED };
+}
+
+
+// Complex products without the checks for infinite and NaN operands that std::complex performs, which dominate the Newton steps
+
+static std::complex<double> complexMultiply(const std::complex<double>& a, const std::complex<double>& b) {
+	return { a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real() };
+}
+
+
+static std::complex<double> complexDivide(const std::complex<double>& a, const std::complex<double>& b) {
+	return std::complex<double>(a.real() * b.real() + a.imag() * b.imag(), a.imag() * b.real() - a.real() * b.imag()) / std::norm(b);
+}
+
+
+// Look for an attracting cycle of the given period near the orbit point w: Newton's method solves f^period(w) = w, and the cycle
+// attracts if the derivative of f^period at w (its multiplier) is smaller than 1
+// Returns the interior distance estimate and sets period to the exact period of the cycle, or returns -1 if there is no such cycle
+
+static double attractingCycle(const std::complex<double>& c, std::complex<double> w, uint32_t& period) {
+	bool converged = false;
+	for (int step = 0; step < INTERIOR_NEWTON_STEPS && !converged; ++step) {
+		std::complex<double> z = w, dz = 1.0;
+		for (uint32_t i = 0; i < period; ++i) {
+			dz = 2.0 * complexMultiply(z, dz);
+			z = complexMultiply(z, z) + c;
+		}
+
+		// A multiplier well above 1 near w means the cycle there repels, an orbit that escapes slowly shadows such cycles
+		if (std::norm(dz) > INTERIOR_REPELLING)
+			return -1.0;
+
+		std::complex<double> delta = complexDivide(z - w, dz - 1.0);
+		w -= delta;
+		converged = std::norm(delta) <= 1e-26 * std::norm(w);
+		if (!(std::norm(w) <= ESCAPE_RADIUS_SQUARED))
+			return -1.0;
+	}
+	if (!converged)
+		return -1.0;
+
+	// Multiplier and the derivatives the interior distance needs: d/dz, d/dc, d2/dz2 and d2/dcdz of f^period at w
+	// The cycle first returns to w after its exact period, the atom domain may have found a multiple of it
+
+	std::complex<double> z = w, dz = 1.0, dc = 0.0, dzdz = 0.0, dcdz = 0.0;
+	uint32_t exactPeriod = 0;
+	for (uint32_t i = 0; i < period; ++i) {
+		dcdz = 2.0 * (complexMultiply(z, dcdz) + complexMultiply(dc, dz));
+		dzdz = 2.0 * (complexMultiply(dz, dz) + complexMultiply(z, dzdz));
+		dc = 2.0 * complexMultiply(z, dc) + 1.0;
+		dz = 2.0 * complexMultiply(z, dz);
+		z = complexMultiply(z, z) + c;
+
+		if (exactPeriod == 0 && std::norm(z - w) <= 1e-12 * std::norm(w))
+			exactPeriod = i + 1;
+	}
+
+	if (!(std::norm(dz) < 1.0))
+		return -1.0;
+
+	// Closer to the boundary than the precision of c, the cycle may only exist because of rounding
+	double distance = (1.0 - std::norm(dz)) / std::abs(dcdz + complexDivide(complexMultiply(dzdz, dc), 1.0 - dz));
+	if (!(distance > INTERIOR_PRECISION * std::abs(c)))
+		return -1.0;
+
+	if (exactPeriod != 0)
+		period = exactPeriod;
+	return distance;
+}
+
+
+pixelEscape iterateMandelbrotAnalyzed(const double& cx, const double& cy, const uint32_t& maxIterations, const bool& trackDistance, const bool& detectInterior) {
+	double x = 0.0, y = 0.0;
+	double x2 = 0.0, y2 = 0.0;
+	double dx = 0.0, dy = 0.0;
+	uint32_t iteration = 0;
+
+	// Atom domain: iteration of the smallest |z| so far and its |z|^2, and |d z / d z| squared since the last check
+	uint32_t atomPeriod = 0;
+	double atomMagnitude = 0.0, contraction = 1.0;
+
+	while (x2 + y2 <= ESCAPE_RADIUS_SQUARED && iteration < maxIterations) {
+		if (trackDistance) {
+			// dz/dc = 2 z dz/dc + 1, with the z before the step
+			double nextDx = 2 * (x * dx - y * dy) + 1;
+			dy = 2 * (x * dy + y * dx);
+			dx = nextDx;
+		}
+		if (detectInterior)
+			contraction *= 4 * (x2 + y2);
+
+		y = 2 * x * y + cy;
+		x = x2 - y2 + cx;
+		x2 = x * x;
+		y2 = y * y;
+		++iteration;
+
+		if (!detectInterior)
+			continue;
+
+		// A new atom domain is checked if the orbit contracted since the previous one, an orbit that keeps contracting within
+		// the same domain (converging to its cycle from below the smallest |z|) is checked every time it contracts enough
+
+		bool newDomain = atomPeriod == 0 || x2 + y2 < atomMagnitude;
+		if (newDomain || contraction < INTERIOR_CONTRACTION) {
+			uint32_t period = newDomain ? iteration : atomPeriod;
+			double distance = (contraction < 1.0) ? attractingCycle({ cx, cy }, { x, y }, period) : -1.0;
+			if (distance >= 0.0) {
+				pixelEscape escape{ x, y, iteration, false, period };
+				escape.distance = (float)distance;
+				return escape;
+			}
+
+			contraction = 1.0;
+			if (newDomain) {
+				atomPeriod = iteration;
+				atomMagnitude = x2 + y2;
+			}
+		}
+	}
+
+	pixelEscape escape{ x, y, iteration, x2 + y2 > ESCAPE_RADIUS_SQUARED };
+
+	// Half of the bound 2 |z| log|z| / |dz/dc|, the true distance lies between a quarter of the bound and the bound
+	double magnitude = std::sqrt(x2 + y2), derivative = std::hypot(dx, dy);
+	if (escape.escaped && trackDistance && derivative > 0.0)
+		escape.distance = (float)(magnitude * std::log(magnitude) / derivative);
+
+	return escape;
+}
+
+
+float smoothIteration(const pixelEscape& escape) {
+	float logZn = std::log((float)(escape.zx * escape.zx + escape.zy * escape.zy)) / 2;
+	return std::max((float)escape.iteration + 1 - std::log2(logZn / std::log(2.0f)), 0.0f);
+}
+
+
+coord imageToCoord(const viewState& view, const double& x, const double& y) {
+	// Same mapping as fragNormalizeCoords in the fragment shader, whose y axis points up
+
+	double leny = 4;
+	double lenx = (1.0 * view.width / view.height) * leny;
+
+	return {
+		(x / view.width - 0.5) * (lenx / view.zoom) + view.off.x,
+		((view.height - y) / view.height - 0.5) * (leny / view.zoom) + view.off.y
+	};
+}
+
+
+void coordToImage(const viewState& view, const coord& c, double& x, double& y) {
+	double leny = 4;
+	double lenx = (1.0 * view.width / view.height) * leny;
+
+	x = ((c.x - view.off.x) / (lenx / view.zoom) + 0.5) * view.width;
+	y = view.height - ((c.y - view.off.y) / (leny / view.zoom) + 0.5) * view.height;
+}
+
+
+double pixelSize(const viewState& view) {
+	return 4.0 / view.zoom / view.height;
+}
+
+
+void parallelRows(const int& height, const unsigned& threads, const std::function<void(int)>& rowFunction) {
+	// Rows are handed out one at a time so that expensive rows near the set do not stall a single thread
+
+	std::atomic<int> nextRow(0);
+
+	auto work = [&]() {
+		for (int row = nextRow++; row < height; row = nextRow++) {
+			TRACE_SCOPE("cpu task");
+			rowFunction(row);
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (unsigned i = 1; i < threads; ++i)
+		workers.emplace_back([&]() {
+			setTraceThreadName("cpu worker");
+			work();
+		});
+	work();
+
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+
+void renderEscapes(const viewState& view, std::vector<pixelEscape>& escapes, const unsigned& threads, const bool& detectInterior) {
+	escapes.resize((size_t)view.width * view.height);
+
+	parallelRows(view.height, threads, [&](int row) {
+		pixelEscape* line = escapes.data() + (size_t)row * view.width;
+		for (int column = 0; column < view.width; ++column) {
+			coord c = imageToCoord(view, column + 0.5, row + 0.5);
+			line[column] = detectInterior
+				? iterateMandelbrotAnalyzed(c.x, c.y, view.maxIterations, false, true) : iterateMandelbrot(c.x, c.y, view.maxIterations);
+		}
+	});
+}
+
+
+std::array<unsigned char, 3> map_to_color(const Palette& palette, const pixelEscape& escape, const float& paletteCycle) {
+	return map_to_color(palette, escape.escaped ? smoothIteration(escape) : -1.0f, paletteCycle);
+}
+
+
+std::array<unsigned char, 3> map_to_color(const Palette& palette, const float& iteration, const float& paletteCycle) {
+	if (iteration < 0)
+		return { 0, 0, 0 };
+
+	std::array<float, 3> color = palette.sample(iteration / paletteCycle);
+
+	return {
+		(unsigned char)std::lround(std::clamp(color[0], 0.0f, 1.0f) * 255),
+		(unsigned char)std::lround(std::clamp(color[1], 0.0f, 1.0f) * 255),
+		(unsigned char)std::lround(std::clamp(color[2], 0.0f, 1.0f) * 255)
+	};
+}
+
+
+std::array<unsigned char, 3> shadeDistance(const std::array<unsigned char, 3>& color, const double& distancePixels) {
+	// The square root keeps the darkening narrow, pixels further than DISTANCE_SHADING_PIXELS keep their color
+
+	double shade = std::sqrt(std::clamp(distancePixels / DISTANCE_SHADING_PIXELS, 0.0, 1.0));
+
+	return {
+		(unsigned char)std::lround(color[0] * shade),
+		(unsigned char)std::lround(color[1] * shade),
+		(unsigned char)std::lround(color[2] * shade)
+	};
+}
+
+
+std::array<unsigned char, 3> periodColor(const Palette& palette, const uint32_t& period) {
+	// Same palette position as the shaders, which compute it in single precision
+	float position = (float)period * PERIOD_PALETTE_STEP;
+	return map_to_color(palette, position - std::floor(position), 1.0f);
+}
+
+
+void colorEscapes(const std::vector<pixelEscape>& escapes, const Palette& palette, const float& paletteCycle, std::vector<unsigned char>& rgb) {
+	rgb.resize(escapes.size() * 3);
+
+	for (size_t i = 0; i < escapes.size(); ++i) {
+		std::array<unsigned char, 3> color = map_to_color(palette, escapes[i], paletteCycle);
+		rgb[i * 3] = color[0];
+		rgb[i * 3 + 1] = color[1];
+		rgb[i * 3 + 2] = color[2];
+	}
+}
@@ -0,0 +1,176 @@
+#include "memory_registry.h"
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+
+// Usage of a subsystem in a domain, entries are never removed so TrackedMemory can keep a pointer to its entry
+
+struct memoryEntry {
+	const char* subsystem;
+	memoryDomain domain;
+	std::atomic<int64_t> current{ 0 }, peak{ 0 };
+
+	memoryEntry(const char* subsystem, const memoryDomain& domain) : subsystem(subsystem), domain(domain) {}
+};
+
+// Totals and budget of a domain
+
+struct memoryDomainState {
+	std::atomic<int64_t> current{ 0 }, peak{ 0 }, budget{ 0 };
+	std::atomic<bool> overBudget{ false };
+};
+
+
+// A deque keeps its elements in place as it grows, the mutex only guards the lookup and the insertion
+static std::deque<memoryEntry> entries;
+static std::mutex entriesMutex;
+
+static memoryDomainState domains[2];
+
+
+static memoryDomainState& domainState(const memoryDomain& domain) {
+	return domains[domain == memoryDomain::gpu ? 1 : 0];
+}
+
+
+static void raisePeak(std::atomic<int64_t>& peak, const int64_t& value) {
+	int64_t previous = peak.load(std::memory_order_relaxed);
+	while (value > previous && !peak.compare_exchange_weak(previous, value, std::memory_order_relaxed));
+}
+
+
+static memoryEntry* findEntry(const char* subsystem, const memoryDomain& domain) {
+	std::lock_guard<std::mutex> lock(entriesMutex);
+
+	for (memoryEntry& entry : entries)
+		if (entry.domain == domain && std::strcmp(entry.subsystem, subsystem) == 0)
+			return &entry;
+
+	return &entries.emplace_back(subsystem, domain);
+}
+
+
+const char* memoryDomainName(const memoryDomain& domain) {
+	return domain == memoryDomain::gpu ? "gpu" : "cpu";
+}
+
+
+void setMemoryBudget(const memoryDomain& domain, const int64_t& bytes) {
+	domainState(domain).budget = bytes;
+}
+
+
+int64_t getMemoryBudget(const memoryDomain& domain) {
+	return domainState(domain).budget;
+}
+
+
+int64_t getAvailableMemory(const memoryDomain& domain) {
+	const memoryDomainState& state = domainState(domain);
+	int64_t budget = state.budget;
+	if (budget <= 0)
+		return INT64_MAX;
+
+	return std::max<int64_t>(budget - state.current, 0);
+}
+
+
+std::vector<memoryUsage> getMemoryUsage() {
+	std::lock_guard<std::mutex> lock(entriesMutex);
+
+	std::vector<memoryUsage> usage;
+	for (memoryDomain domain : { memoryDomain::cpu, memoryDomain::gpu })
+		for (const memoryEntry& entry : entries)
+			if (entry.domain == domain && entry.peak > 0)
+				usage.push_back({ entry.subsystem, domain, entry.current, entry.peak });
+
+	return usage;
+}
+
+
+memoryUsage getTotalMemoryUsage(const memoryDomain& domain) {
+	const memoryDomainState& state = domainState(domain);
+	return { "total", domain, state.current, state.peak };
+}
+
+
+void writeMemoryUsage(JsonWriter& json) {
+	json.beginObject();
+
+	for (memoryDomain domain : { memoryDomain::cpu, memoryDomain::gpu }) {
+		memoryUsage total = getTotalMemoryUsage(domain);
+		json.key(memoryDomainName(domain));
+		json.beginObject();
+		json.key("budget");
+		json.value(getMemoryBudget(domain));
+		json.key("current");
+		json.value(total.current);
+		json.key("peak");
+		json.value(total.peak);
+		json.endObject();
+	}
+
+	json.key("subsystems");
+	json.beginArray();
+	for (const memoryUsage& usage : getMemoryUsage()) {
+		json.beginObject();
+		json.key("name");
+		json.value(usage.subsystem);
+		json.key("domain");
+		json.value(memoryDomainName(usage.domain));
+		json.key("current");
+		json.value(usage.current);
+		json.key("peak");
+		json.value(usage.peak);
+		json.endObject();
+	}
+	json.endArray();
+
+	json.endObject();
+}
+
+
+TrackedMemory::TrackedMemory(const char* subsystem, const memoryDomain& domain) : entry(findEntry(subsystem, domain)), bytes(0) {}
+
+
+TrackedMemory::~TrackedMemory() {
+	set(0);
+}
+
+
+void TrackedMemory::set(const int64_t& bytes) {
+	int64_t change = bytes - this->bytes;
+	this->bytes = bytes;
+	if (change == 0)
+		return;
+
+	raisePeak(entry->peak, entry->current.fetch_add(change, std::memory_order_relaxed) + change);
+
+	memoryDomainState& state = domainState(entry->domain);
+	int64_t total = state.current.fetch_add(change, std::memory_order_relaxed) + change;
+	raisePeak(state.peak, total);
+
+	// Report the subsystem that crossed the budget, once per crossing
+
+	int64_t budget = state.budget;
+	bool over = budget > 0 && total > budget;
+	if (state.overBudget.exchange(over) != over && over)
+		std::cout << "ERROR:MEMORY_BUDGET_EXCEEDED " << memoryDomainName(entry->domain) << ' ' << entry->subsystem << ' '
+			<< total / (1024 * 1024) << " MB of " << budget / (1024 * 1024) << " MB\n";
+}
+
+
+bool TrackedMemory::fits(const int64_t& bytes) const {
+	return bytes <= this->bytes || bytes - this->bytes <= getAvailableMemory(entry->domain);
+}
+
+
+int64_t TrackedMemory::get() const {
+	return bytes;
+}
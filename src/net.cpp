@@ -0,0 +1,166 @@
+#include "net.h"
+
+#include <iostream>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <csignal>
+#endif
+
+
+bool initializeSockets() {
+#ifdef _WIN32
+	WSADATA data;
+	if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+		std::cout << "ERROR:SOCKETS_COULD_NOT_BE_INITIALIZED\n";
+		return false;
+	}
+#else
+	// Writing to a connection the peer closed must fail instead of terminating the process
+
+	signal(SIGPIPE, SIG_IGN);
+#endif
+
+	return true;
+}
+
+
+socketHandle listenOn(const uint16_t& port, const bool& anyInterface, uint16_t& boundPort) {
+	socketHandle listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (listener == NO_SOCKET)
+		return NO_SOCKET;
+
+	int reuse = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(anyInterface ? INADDR_ANY : INADDR_LOOPBACK);
+
+	socklen_t length = sizeof(address);
+	if (bind(listener, (const sockaddr*)&address, sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0
+		|| getsockname(listener, (sockaddr*)&address, &length) != 0) {
+		std::cout << "ERROR:PORT_COULD_NOT_BE_OPENED " << port << '\n';
+		closeSocket(listener);
+		return NO_SOCKET;
+	}
+
+	boundPort = ntohs(address.sin_port);
+	return listener;
+}
+
+
+socketHandle acceptConnection(const socketHandle& listener) {
+	socketHandle connection = accept(listener, nullptr, nullptr);
+	if (connection == NO_SOCKET)
+		return NO_SOCKET;
+
+	// Requests and replies are small messages, send them without waiting for more data
+
+	int noDelay = 1;
+	setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+
+	return connection;
+}
+
+
+socketHandle connectTo(const std::string& host, const uint16_t& port) {
+	addrinfo hints{}, *addresses = nullptr;
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+
+	if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0)
+		return NO_SOCKET;
+
+	socketHandle connection = NO_SOCKET;
+	for (addrinfo* address = addresses; address != nullptr && connection == NO_SOCKET; address = address->ai_next) {
+		connection = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+		if (connection != NO_SOCKET && connect(connection, address->ai_addr, (socklen_t)address->ai_addrlen) != 0) {
+			closeSocket(connection);
+			connection = NO_SOCKET;
+		}
+	}
+	freeaddrinfo(addresses);
+
+	if (connection != NO_SOCKET) {
+		int noDelay = 1;
+		setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+	}
+
+	return connection;
+}
+
+
+bool sendAll(const socketHandle& socket, const void* data, const size_t& size) {
+	const char* bytes = (const char*)data;
+
+	for (size_t sent = 0; sent < size;) {
+		int count = (int)std::min<size_t>(size - sent, 1 << 20);
+		long result = send(socket, bytes + sent, count, 0);
+		if (result <= 0)
+			return false;
+		sent += (size_t)result;
+	}
+
+	return true;
+}
+
+
+bool receiveAll(const socketHandle& socket, void* data, const size_t& size) {
+	char* bytes = (char*)data;
+
+	for (size_t received = 0; received < size;) {
+		long result = receiveSome(socket, bytes + received, size - received);
+		if (result <= 0)
+			return false;
+		received += (size_t)result;
+	}
+
+	return true;
+}
+
+
+long receiveSome(const socketHandle& socket, void* data, const size_t& size) {
+	return recv(socket, (char*)data, (int)std::min<size_t>(size, 1 << 20), 0);
+}
+
+
+bool waitReadable(const socketHandle& socket, const int& timeoutMilliseconds) {
+	pollfd descriptor{};
+	descriptor.fd = socket;
+	descriptor.events = POLLIN;
+
+#ifdef _WIN32
+	return WSAPoll(&descriptor, 1, timeoutMilliseconds) > 0;
+#else
+	return poll(&descriptor, 1, timeoutMilliseconds) > 0;
+#endif
+}
+
+
+bool peerClosed(const socketHandle& socket) {
+	if (!waitReadable(socket, 0))
+		return false;
+
+	// Readable with nothing to read means the end of the connection
+
+	char byte;
+	return recv(socket, &byte, 1, MSG_PEEK) <= 0;
+}
+
+
+void closeSocket(const socketHandle& socket) {
+#ifdef _WIN32
+	closesocket(socket);
+#else
+	close(socket);
+#endif
+}
@@ -0,0 +1,142 @@
+#include "palette.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <cmath>
+
+
+Palette::Palette() : name("default"), texture(0), memory("palettes", memoryDomain::gpu) {
+	// Sample the polynomial that was used before palettes could be loaded
+
+	constexpr int size = 64;
+	for (int i = 0; i < size; ++i) {
+		float t = (float)i / (size - 1);
+		colors.push_back({
+			9.0f * (1.0f - t) * t * t * t,
+			15.0f * (1.0f - t) * (1.0f - t) * t * t,
+			8.5f * (1.0f - t) * (1.0f - t) * (1.0f - t) * t
+		});
+	}
+}
+
+
+Palette::Palette(const char* path) : name(std::filesystem::path(path).stem().string()), texture(0), memory("palettes", memoryDomain::gpu) {
+	std::ifstream in(path);
+
+	if (!in) {
+		std::cout << "ERROR:PALETTE_COULD_NOT_BE_READ " << path << '\n';
+		return;
+	}
+
+	std::string line;
+	while (std::getline(in, line)) {
+		// Skip comments and empty lines
+
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		std::istringstream values(line);
+		float r, g, b;
+		if (!(values >> r >> g >> b)) {
+			std::cout << "ERROR:PALETTE_INVALID_LINE " << path << ": " << line << '\n';
+			continue;
+		}
+		colors.push_back({ r / 255.0f, g / 255.0f, b / 255.0f });
+	}
+}
+
+
+Palette::~Palette() {
+	if (texture != 0)
+		glDeleteTextures(1, &texture);
+}
+
+
+bool Palette::isValid() const {
+	return !colors.empty();
+}
+
+
+const std::string& Palette::getName() const {
+	return name;
+}
+
+
+size_t Palette::getSize() const {
+	return colors.size();
+}
+
+
+std::array<float, 3> Palette::sample(const float& t) const {
+	// GL_MIRRORED_REPEAT folds t into [0, 1] with every other repetition reversed
+
+	float mirrored = std::fmod(std::fabs(t), 2.0f);
+	if (mirrored > 1.0f)
+		mirrored = 2.0f - mirrored;
+
+	// GL_LINEAR interpolates between texel centers, the edges repeat the first / last color
+
+	float position = std::clamp(mirrored * colors.size() - 0.5f, 0.0f, (float)colors.size() - 1);
+	size_t first = (size_t)position;
+	size_t second = std::min(first + 1, colors.size() - 1);
+	float fraction = position - first;
+
+	return {
+		colors[first][0] + (colors[second][0] - colors[first][0]) * fraction,
+		colors[first][1] + (colors[second][1] - colors[first][1]) * fraction,
+		colors[first][2] + (colors[second][2] - colors[first][2]) * fraction
+	};
+}
+
+
+void Palette::bind(const GLuint& textureUnit) {
+	glActiveTexture(GL_TEXTURE0 + textureUnit);
+
+	if (texture == 0) {
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_1D, texture);
+		glTexImage1D(GL_TEXTURE_1D, 0, GL_RGB32F, (GLsizei)colors.size(), 0, GL_RGB, GL_FLOAT, colors.data());
+		memory.set((int64_t)colors.size() * sizeof(colors[0]));
+
+		// Interpolate between the colors and mirror the palette so that it can be cycled without seams
+
+		glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
+	}
+
+	glBindTexture(GL_TEXTURE_1D, texture);
+}
+
+
+std::vector<std::unique_ptr<Palette>> loadPalettes(const char* directory) {
+	std::vector<std::filesystem::path> paths;
+	std::error_code error;
+
+	for (const auto& entry : std::filesystem::directory_iterator(directory, error))
+		if (entry.path().extension() == ".txt")
+			paths.push_back(entry.path());
+	std::sort(paths.begin(), paths.end());
+
+	std::vector<std::unique_ptr<Palette>> palettes;
+	for (const auto& path : paths) {
+		auto palette = std::make_unique<Palette>(path.string().c_str());
+		if (palette->isValid())
+			palettes.push_back(std::move(palette));
+	}
+
+	if (palettes.empty())
+		palettes.push_back(std::make_unique<Palette>());
+
+	return palettes;
+}
+
+
+
+Palette* findPalette(const std::vector<std::unique_ptr<Palette>>& palettes, const std::string& name) {
+	for (const std::unique_ptr<Palette>& palette : palettes)
+		if (palette->getName() == name)
+			return palette.get();
+
+	return nullptr;
+}
\ No newline at end of file
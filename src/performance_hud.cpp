@@ -0,0 +1,310 @@
+#include "performance_hud.h"
+
+#include <cstdio>
+#include <cctype>
+#include <algorithm>
+
+
+// Size of a glyph of the built in font, in font pixels (must match shaders/hud_fragment.glsl)
+constexpr int GLYPH_WIDTH = 5, GLYPH_HEIGHT = 7;
+
+
+// Bitmaps of the characters the overlay can show, '#' is set
+// The first glyph (a space) is also used for any character that is not in the table
+
+struct hudGlyph {
+	char character;
+	const char* rows[GLYPH_HEIGHT];
+};
+
+static const hudGlyph HUD_FONT[] = {
+	{ ' ', { "     ", "     ", "     ", "     ", "     ", "     ", "     " } },
+	{ '0', { " ### ", "#   #", "#  ##", "# # #", "##  #", "#   #", " ### " } },
+	{ '1', { "  #  ", " ##  ", "  #  ", "  #  ", "  #  ", "  #  ", " ### " } },
+	{ '2', { " ### ", "#   #", "    #", "   # ", "  #  ", " #   ", "#####" } },
+	{ '3', { "#####", "   # ", "  #  ", "   # ", "    #", "#   #", " ### " } },
+	{ '4', { "   # ", "  ## ", " # # ", "#  # ", "#####", "   # ", "   # " } },
+	{ '5', { "#####", "#    ", "#### ", "    #", "    #", "#   #", " ### " } },
+	{ '6', { "  ## ", " #   ", "#    ", "#### ", "#   #", "#   #", " ### " } },
+	{ '7', { "#####", "    #", "   # ", "  #  ", " #   ", " #   ", " #   " } },
+	{ '8', { " ### ", "#   #", "#   #", " ### ", "#   #", "#   #", " ### " } },
+	{ '9', { " ### ", "#   #", "#   #", " ####", "    #", "   # ", " ##  " } },
+	{ 'A', { " ### ", "#   #", "#   #", "#####", "#   #", "#   #", "#   #" } },
+	{ 'B', { "#### ", "#   #", "#   #", "#### ", "#   #", "#   #", "#### " } },
+	{ 'C', { " ### ", "#   #", "#    ", "#    ", "#    ", "#   #", " ### " } },
+	{ 'D', { "###  ", "#  # ", "#   #", "#   #", "#   #", "#  # ", "###  " } },
+	{ 'E', { "#####", "#    ", "#    ", "#### ", "#    ", "#    ", "#####" } },
+	{ 'F', { "#####", "#    ", "#    ", "#### ", "#    ", "#    ", "#    " } },
+	{ 'G', { " ### ", "#   #", "#    ", "# ###", "#   #", "#   #", " ####" } },
+	{ 'H', { "#   #", "#   #", "#   #", "#####", "#   #", "#   #", "#   #" } },
+	{ 'I', { " ### ", "  #  ", "  #  ", "  #  ", "  #  ", "  #  ", " ### " } },
+	{ 'J', { "  ###", "   # ", "   # ", "   # ", "   # ", "#  # ", " ##  " } },
+	{ 'K', { "#   #", "#  # ", "# #  ", "##   ", "# #  ", "#  # ", "#   #" } },
+	{ 'L', { "#    ", "#    ", "#    ", "#    ", "#    ", "#    ", "#####" } },
+	{ 'M', { "#   #", "## ##", "# # #", "# # #", "#   #", "#   #", "#   #" } },
+	{ 'N', { "#   #", "#   #", "##  #", "# # #", "#  ##", "#   #", "#   #" } },
+	{ 'O', { " ### ", "#   #", "#   #", "#   #", "#   #", "#   #", " ### " } },
+	{ 'P', { "#### ", "#   #", "#   #", "#### ", "#    ", "#    ", "#    " } },
+	{ 'Q', { " ### ", "#   #", "#   #", "#   #", "# # #", "#  # ", " ## #" } },
+	{ 'R', { "#### ", "#   #", "#   #", "#### ", "# #  ", "#  # ", "#   #" } },
+	{ 'S', { " ####", "#    ", "#    ", " ### ", "    #", "    #", "#### " } },
+	{ 'T', { "#####", "  #  ", "  #  ", "  #  ", "  #  ", "  #  ", "  #  " } },
+	{ 'U', { "#   #", "#   #", "#   #", "#   #", "#   #", "#   #", " ### " } },
+	{ 'V', { "#   #", "#   #", "#   #", "#   #", "#   #", " # # ", "  #  " } },
+	{ 'W', { "#   #", "#   #", "#   #", "# # #", "# # #", "# # #", " # # " } },
+	{ 'X', { "#   #", "#   #", " # # ", "  #  ", " # # ", "#   #", "#   #" } },
+	{ 'Y', { "#   #", "#   #", " # # ", "  #  ", "  #  ", "  #  ", "  #  " } },
+	{ 'Z', { "#####", "    #", "   # ", "  #  ", " #   ", "#    ", "#####" } },
+	{ '.', { "     ", "     ", "     ", "     ", "     ", " ##  ", " ##  " } },
+	{ ',', { "     ", "     ", "     ", "     ", " ##  ", "  #  ", " #   " } },
+	{ ':', { "     ", " ##  ", " ##  ", "     ", " ##  ", " ##  ", "     " } },
+	{ '-', { "     ", "     ", "     ", "#####", "     ", "     ", "     " } },
+	{ '+', { "     ", "  #  ", "  #  ", "#####", "  #  ", "  #  ", "     " } },
+	{ '/', { "     ", "    #", "   # ", "  #  ", " #   ", "#    ", "     " } },
+	{ '(', { "   # ", "  #  ", " #   ", " #   ", " #   ", "  #  ", "   # " } },
+	{ ')', { " #   ", "  #  ", "   # ", "   # ", "   # ", "  #  ", " #   " } },
+	{ '%', { "##   ", "##  #", "   # ", "  #  ", " #   ", "#  ##", "   ##" } },
+	{ '=', { "     ", "     ", "#####", "     ", "#####", "     ", "     " } }
+};
+
+constexpr GLsizei HUD_GLYPH_COUNT = (GLsizei)(sizeof(HUD_FONT) / sizeof(HUD_FONT[0]));
+
+
+// Index of the glyph of a character, lower case letters use the upper case glyphs
+
+static unsigned char glyphIndex(const char& character) {
+	char upper = (char)std::toupper((unsigned char)character);
+	for (GLsizei i = 0; i < HUD_GLYPH_COUNT; ++i)
+		if (HUD_FONT[i].character == upper)
+			return (unsigned char)i;
+
+	return 0;
+}
+
+
+// Shorter than the default stream formatting and without locale dependent separators
+
+static std::string formatNumber(const char* format, const double& value) {
+	char text[64];
+	std::snprintf(text, sizeof(text), format, value);
+	return text;
+}
+
+
+PerformanceHud::PerformanceHud(const char* vertexShaderPath, const char* fragmentShaderPath)
+	: slots{}, currentSlot(0), measuring(false), program(vertexShaderPath, fragmentShaderPath), memory("overlay", memoryDomain::gpu), fontBytes(0), textureColumns(0), textureLines(0), lastFrame(std::chrono::steady_clock::now()),
+	  windowSeconds(0.0), windowGpuSeconds(0.0), windowIterations(0), windowFrames(0), windowGpuFrames(0),
+	  frameMilliseconds(0.0), gpuMilliseconds(0.0), iterationsPerSecond(0.0), latencyMedian(-1.0), latency99(-1.0) {
+
+	// Every slot has a timer query and a 64 bit counter stored as two 32 bit words (low, high)
+
+	for (measurementSlot& slot : slots) {
+		glGenQueries(1, &slot.query);
+		glGenBuffers(1, &slot.counterSSBO);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, slot.counterSSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * sizeof(GLuint), nullptr, GL_DYNAMIC_READ);
+		slot.pending = false;
+	}
+
+	// The glyphs side by side in a single row, one byte per font pixel
+
+	std::vector<unsigned char> bitmap((size_t)HUD_GLYPH_COUNT * GLYPH_WIDTH * GLYPH_HEIGHT, 0);
+	for (GLsizei glyph = 0; glyph < HUD_GLYPH_COUNT; ++glyph)
+		for (int y = 0; y < GLYPH_HEIGHT; ++y)
+			for (int x = 0; x < GLYPH_WIDTH; ++x)
+				if (HUD_FONT[glyph].rows[y][x] == '#')
+					bitmap[(size_t)y * HUD_GLYPH_COUNT * GLYPH_WIDTH + glyph * GLYPH_WIDTH + x] = 255;
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	glGenTextures(1, &fontTexture);
+	glBindTexture(GL_TEXTURE_2D, fontTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, HUD_GLYPH_COUNT * GLYPH_WIDTH, GLYPH_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, bitmap.data());
+
+	// The counters and the font, the text texture is added when it is allocated
+	fontBytes = HUD_QUERY_RING_SIZE * 2 * sizeof(GLuint) + (int64_t)bitmap.size();
+	memory.set(fontBytes);
+
+	glGenTextures(1, &textTexture);
+	glBindTexture(GL_TEXTURE_2D, textTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+
+PerformanceHud::~PerformanceHud() {
+	for (measurementSlot& slot : slots) {
+		glDeleteQueries(1, &slot.query);
+		glDeleteBuffers(1, &slot.counterSSBO);
+	}
+
+	glDeleteTextures(1, &fontTexture);
+	glDeleteTextures(1, &textTexture);
+}
+
+
+void PerformanceHud::collect(const size_t& waitSlot) {
+	// The slots finish in the order they were submitted, the oldest one is the slot about to be reused
+
+	for (size_t i = 0; i < HUD_QUERY_RING_SIZE; ++i) {
+		size_t index = (currentSlot + i) % HUD_QUERY_RING_SIZE;
+		measurementSlot& slot = slots[index];
+		if (!slot.pending)
+			continue;
+
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(slot.query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available && index != waitSlot)
+			break;
+
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(slot.query, GL_QUERY_RESULT, &nanoseconds);
+
+		GLuint counter[2] = { 0, 0 };
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, slot.counterSSBO);
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counter), counter);
+
+		windowGpuSeconds += nanoseconds * 1e-9;
+		windowIterations += ((uint64_t)counter[1] << 32) | counter[0];
+		++windowGpuFrames;
+		slot.pending = false;
+	}
+}
+
+
+void PerformanceHud::beginFrame(const bool& measureGpu) {
+	auto now = std::chrono::steady_clock::now();
+	windowSeconds += std::chrono::duration<double>(now - lastFrame).count();
+	lastFrame = now;
+	++windowFrames;
+
+	currentSlot = (currentSlot + 1) % HUD_QUERY_RING_SIZE;
+	collect(currentSlot);
+
+	// Publish the averages of the last interval
+
+	if (windowSeconds >= HUD_UPDATE_INTERVAL) {
+		frameMilliseconds = 1000.0 * windowSeconds / windowFrames;
+		gpuMilliseconds = (windowGpuFrames > 0) ? 1000.0 * windowGpuSeconds / windowGpuFrames : 0.0;
+		iterationsPerSecond = windowIterations / windowSeconds;
+
+		windowSeconds = windowGpuSeconds = 0.0;
+		windowIterations = 0;
+		windowFrames = windowGpuFrames = 0;
+	}
+
+	measuring = measureGpu;
+	if (!measuring)
+		return;
+
+	measurementSlot& slot = slots[currentSlot];
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, slot.counterSSBO);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, HUD_COUNTER_BINDING, slot.counterSSBO);
+
+	glBeginQuery(GL_TIME_ELAPSED, slot.query);
+	slot.pending = true;
+}
+
+
+void PerformanceHud::endFrame() {
+	if (!measuring)
+		return;
+
+	glEndQuery(GL_TIME_ELAPSED);
+
+	// The counter is read with glGetBufferSubData, after the shader writes
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	measuring = false;
+}
+
+
+void PerformanceHud::setInputLatency(const double& medianMilliseconds, const double& p99Milliseconds) {
+	latencyMedian = medianMilliseconds;
+	latency99 = p99Milliseconds;
+}
+
+
+void PerformanceHud::draw(const viewState& view, const char* precision) {
+	std::vector<std::string> lines = {
+		"Frame " + formatNumber("%.2f", frameMilliseconds) + " ms (" + formatNumber("%.0f", frameMilliseconds > 0 ? 1000.0 / frameMilliseconds : 0.0) + " fps)",
+		"GPU " + formatNumber("%.2f", gpuMilliseconds) + " ms",
+		latencyMedian < 0.0 ? std::string("Input latency -") : "Input latency " + formatNumber("%.1f", latencyMedian) + " ms, p99 " + formatNumber("%.1f", latency99) + " ms",
+		"Iterations " + formatNumber("%.3g", iterationsPerSecond) + "/s",
+		std::string("Precision ") + precision,
+		"X " + formatNumber("%.17g", view.off.x),
+		"Y " + formatNumber("%.17g", view.off.y),
+		"Zoom " + formatNumber("%.6g", view.zoom) + ", " + std::to_string(view.maxIterations) + " iterations",
+		std::to_string(view.width) + " x " + std::to_string(view.height)
+	};
+
+	// Memory held on the GPU and the CPU, then by every subsystem, with the peaks
+
+	auto size = [](const int64_t& bytes) {
+		return bytes < 1024 * 1024 ? formatNumber("%.1f", bytes / 1024.0) + " KB" : formatNumber("%.1f", bytes / (1024.0 * 1024.0)) + " MB";
+	};
+	for (memoryDomain domain : { memoryDomain::gpu, memoryDomain::cpu }) {
+		memoryUsage total = getTotalMemoryUsage(domain);
+		int64_t budget = getMemoryBudget(domain);
+		lines.push_back(std::string(domain == memoryDomain::gpu ? "GPU" : "CPU") + " memory " + size(total.current) + " (peak " + size(total.peak) + ")"
+			+ (budget > 0 ? " of " + size(budget) : ""));
+
+		for (const memoryUsage& usage : getMemoryUsage())
+			if (usage.domain == domain)
+				lines.push_back(std::string("  ") + usage.subsystem + " " + size(usage.current) + " (peak " + size(usage.peak) + ")");
+	}
+
+	// One texel per character holding its glyph index
+
+	size_t columns = 0;
+	for (const std::string& line : lines)
+		columns = std::max(columns, line.size());
+
+	std::vector<unsigned char> text(columns * lines.size(), 0);
+	for (size_t line = 0; line < lines.size(); ++line)
+		for (size_t column = 0; column < lines[line].size(); ++column)
+			text[line * columns + column] = glyphIndex(lines[line][column]);
+
+	// The texture is only reallocated when the text outgrows it, and only updated when the text changed (twice a second)
+
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, textTexture);
+	if (columns > textureColumns || lines.size() > textureLines) {
+		textureColumns = std::max(textureColumns, columns);
+		textureLines = std::max(textureLines, lines.size());
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, (GLsizei)textureColumns, (GLsizei)textureLines, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, nullptr);
+		memory.set(fontBytes + (int64_t)(textureColumns * textureLines));
+		uploadedText.clear();
+	}
+	if (text != uploadedText) {
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, (GLsizei)columns, (GLsizei)lines.size(), GL_RED_INTEGER, GL_UNSIGNED_BYTE, text.data());
+		uploadedText = std::move(text);
+	}
+
+	glActiveTexture(GL_TEXTURE3);
+	glBindTexture(GL_TEXTURE_2D, fontTexture);
+	glActiveTexture(GL_TEXTURE0);
+
+	// Font pixels are scaled up on large windows
+
+	program.use();
+	program.setUInt("windowHeight", (GLuint)view.height);
+	program.setUInt("columns", (GLuint)columns);
+	program.setUInt("lines", (GLuint)lines.size());
+	program.setUInt("scale", (GLuint)std::max(1, view.height / 540));
+	program.setInt("text", 2);
+	program.setInt("font", 3);
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (GLvoid*)nullptr);
+	glDisable(GL_BLEND);
+}
+
+
+Shader& PerformanceHud::getProgram() {
+	return program;
+}
@@ -0,0 +1,54 @@
+#include "pixel_state.h"
+
+
+PixelStateBuffer::PixelStateBuffer(const GLuint& binding) : binding(binding), width(0), height(0), memory("pixel states", memoryDomain::gpu) {
+	glGenBuffers(1, &SSBO);
+	bind();
+}
+
+
+PixelStateBuffer::~PixelStateBuffer() {
+	glDeleteBuffers(1, &SSBO);
+}
+
+
+void PixelStateBuffer::resize(const GLuint& width, const GLuint& height) {
+	this->width = width;
+	this->height = height;
+
+	// Allocate new storage and start every pixel from the initial state
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBO);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)width * height * PIXEL_STATE_SIZE, nullptr, GL_DYNAMIC_COPY);
+	memory.set((int64_t)width * height * PIXEL_STATE_SIZE);
+	reset();
+}
+
+
+void PixelStateBuffer::reset() {
+	// An all-zero state means z = 0, no iterations done, not escaped and not supersampled
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBO);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+	bind();
+}
+
+
+void PixelStateBuffer::bind() {
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, SSBO);
+}
+
+
+GLuint PixelStateBuffer::getID() {
+	return SSBO;
+}
+
+
+GLuint PixelStateBuffer::getWidth() {
+	return width;
+}
+
+
+GLuint PixelStateBuffer::getHeight() {
+	return height;
+}
@@ -0,0 +1,230 @@
+#include "png_writer.h"
+
+#include <iostream>
+#include <filesystem>
+#include <cstring>
+
+
+// Size of the compressed data gathered before it is written out as an IDAT chunk
+
+constexpr size_t IDAT_CHUNK_SIZE = 1 << 16;
+
+// zlib header of the image data: deflate with a 32 KB window, no preset dictionary
+constexpr unsigned char ZLIB_HEADER[2] = { 0x78, 0x9C };
+
+
+static void storeBigEndian(unsigned char* destination, const uint32_t& value) {
+	destination[0] = (unsigned char)(value >> 24);
+	destination[1] = (unsigned char)(value >> 16);
+	destination[2] = (unsigned char)(value >> 8);
+	destination[3] = (unsigned char)value;
+}
+
+
+PngWriter::PngWriter(const char* path, const uint32_t& width, const uint32_t& height, const int& compressionLevel)
+	: out(path, std::ios::out | std::ios::trunc | std::ios::binary), compressed(IDAT_CHUNK_SIZE), filteredRow(1 + (size_t)width * 3),
+	  compressedSize(0), width(width), height(height), rowsWritten(0), adler(adler32(0L, nullptr, 0)), failed(false), finished(false) {
+
+	if (!initializeCompressor(compressionLevel) || !out) {
+		std::cout << "ERROR:PNG_COULD_NOT_BE_OPENED " << path << '\n';
+		failed = true;
+		return;
+	}
+
+	// Signature and header: 8 bit depth, truecolor, default compression, filter and no interlacing
+
+	const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	out.write((const char*)signature, sizeof(signature));
+
+	unsigned char header[13] = {};
+	storeBigEndian(header, width);
+	storeBigEndian(header + 4, height);
+	header[8] = 8;
+	header[9] = 2;
+	writeChunk("IHDR", header, sizeof(header));
+
+	std::memcpy(compressed.data(), ZLIB_HEADER, sizeof(ZLIB_HEADER));
+	compressedSize = sizeof(ZLIB_HEADER);
+}
+
+
+PngWriter::PngWriter(const char* path, const uint32_t& width, const uint32_t& height, const int& compressionLevel, const pngResumePoint& resumePoint)
+	: compressed(IDAT_CHUNK_SIZE), filteredRow(1 + (size_t)width * 3), compressedSize(0), width(width), height(height),
+	  rowsWritten(resumePoint.rowsWritten), adler(resumePoint.adler), failed(false), finished(false) {
+
+	// Everything after the resume point is dropped, the file then ends with a complete IDAT chunk
+
+	std::error_code error;
+	if (std::filesystem::file_size(path, error) < resumePoint.fileSize || error || rowsWritten > height) {
+		std::cout << "ERROR:PNG_COULD_NOT_BE_RESUMED " << path << '\n';
+		std::memset(&stream, 0, sizeof(stream));
+		failed = true;
+		return;
+	}
+
+	std::filesystem::resize_file(path, resumePoint.fileSize, error);
+	out.open(path, std::ios::in | std::ios::out | std::ios::binary);
+	out.seekp(0, std::ios::end);
+
+	if (!initializeCompressor(compressionLevel) || error || !out) {
+		std::cout << "ERROR:PNG_COULD_NOT_BE_OPENED " << path << '\n';
+		failed = true;
+	}
+}
+
+
+bool PngWriter::initializeCompressor(const int& compressionLevel) {
+	std::memset(&stream, 0, sizeof(stream));
+
+	// Negative window bits: raw deflate, the header and checksum are added by the writer
+	return deflateInit2(&stream, compressionLevel, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+}
+
+
+PngWriter::~PngWriter() {
+	if (!finished)
+		finish();
+}
+
+
+void PngWriter::writeChunk(const char* type, const unsigned char* data, const uint32_t& length) {
+	unsigned char word[4];
+
+	storeBigEndian(word, length);
+	out.write((const char*)word, 4);
+	out.write(type, 4);
+
+	// The CRC covers the type and the data, crc32 with a null buffer returns its initial value instead of crc
+
+	uLong crc = crc32(0L, (const Bytef*)type, 4);
+	if (length > 0) {
+		out.write((const char*)data, length);
+		crc = crc32(crc, data, length);
+	}
+	storeBigEndian(word, (uint32_t)crc);
+	out.write((const char*)word, 4);
+
+	if (!out)
+		failed = true;
+}
+
+
+void PngWriter::deflateRows(const int& flush) {
+	int result;
+
+	do {
+		stream.next_out = compressed.data() + compressedSize;
+		stream.avail_out = (uInt)(compressed.size() - compressedSize);
+		result = deflate(&stream, flush);
+
+		compressedSize = compressed.size() - stream.avail_out;
+		if (compressedSize == compressed.size())
+			writeCompressed();
+	} while (stream.avail_out == 0 || (flush == Z_FINISH && result == Z_OK));
+}
+
+
+void PngWriter::writeCompressed() {
+	if (compressedSize > 0)
+		writeChunk("IDAT", compressed.data(), (uint32_t)compressedSize);
+	compressedSize = 0;
+}
+
+
+void PngWriter::compressRow(const unsigned char* rgb) {
+	// Sub filter: every byte stores the difference to the same channel of the previous pixel
+
+	filteredRow[0] = 1;
+	for (size_t i = 0; i + 1 < filteredRow.size(); ++i)
+		filteredRow[1 + i] = (unsigned char)(rgb[i] - (i >= 3 ? rgb[i - 3] : 0));
+
+	adler = adler32(adler, filteredRow.data(), (uInt)filteredRow.size());
+
+	stream.next_in = filteredRow.data();
+	stream.avail_in = (uInt)filteredRow.size();
+	deflateRows(Z_NO_FLUSH);
+
+	++rowsWritten;
+}
+
+
+void PngWriter::writeRows(const unsigned char* rgb, const uint32_t& rowCount) {
+	if (failed || finished)
+		return;
+
+	const size_t rowSize = (size_t)width * 3;
+
+	for (uint32_t row = 0; row < rowCount && rowsWritten < height; ++row)
+		compressRow(rgb + row * rowSize);
+}
+
+
+bool PngWriter::flush(pngResumePoint& resumePoint) {
+	if (failed || finished)
+		return false;
+
+	// A full flush ends the deflate data on a byte boundary and resets the compressor, so a new
+	// compressor can continue with a fresh window
+
+	stream.next_in = nullptr;
+	stream.avail_in = 0;
+	deflateRows(Z_FULL_FLUSH);
+	writeCompressed();
+	out.flush();
+
+	if (!out) {
+		failed = true;
+		return false;
+	}
+
+	resumePoint = { (uint64_t)out.tellp(), rowsWritten, (uint32_t)adler };
+	return true;
+}
+
+
+bool PngWriter::finish() {
+	if (finished)
+		return !failed;
+	finished = true;
+
+	if (failed) {
+		deflateEnd(&stream);
+		return false;
+	}
+
+	// Missing rows are filled with black so that the file is always valid
+
+	std::vector<unsigned char> blackRow((size_t)width * 3, 0);
+	while (rowsWritten < height)
+		compressRow(blackRow.data());
+
+	stream.next_in = nullptr;
+	stream.avail_in = 0;
+	deflateRows(Z_FINISH);
+	deflateEnd(&stream);
+
+	// The zlib stream ends with the Adler-32 checksum of the uncompressed (filtered) rows
+
+	if (compressed.size() - compressedSize < 4)
+		writeCompressed();
+	storeBigEndian(compressed.data() + compressedSize, (uint32_t)adler);
+	compressedSize += 4;
+	writeCompressed();
+
+	writeChunk("IEND", nullptr, 0);
+	out.close();
+
+	return !failed;
+}
+
+
+bool PngWriter::isOpen() const {
+	return !failed;
+}
+
+
+bool writePng(const char* path, const unsigned char* rgb, const uint32_t& width, const uint32_t& height, const int& compressionLevel) {
+	PngWriter writer(path, width, height, compressionLevel);
+	writer.writeRows(rgb, height);
+	return writer.finish();
+}
@@ -0,0 +1,342 @@
+#include "raw_iterations.h"
+#include "cli.h"
+#include "png_writer.h"
+
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cmath>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+// Set the default palette directory and the number of rows colored at once
+const char* RECOLOR_PALETTES_PATH = "./palettes";
+constexpr uint32_t RECOLOR_BAND_ROWS = 256;
+
+
+uint32_t rawSampleFloats(const uint32_t& channels) {
+	uint32_t floats = 1;
+	if (channels & RAW_CHANNEL_MAGNITUDE)
+		++floats;
+	if (channels & RAW_CHANNEL_DISTANCE)
+		++floats;
+	if (channels & RAW_CHANNEL_PERIOD)
+		++floats;
+
+	return floats;
+}
+
+
+void storeRawSample(const pixelEscape& escape, const uint32_t& channels, const double& pixelSize, float* sample) {
+	*sample++ = escape.escaped ? smoothIteration(escape) : -1.0f;
+
+	if (channels & RAW_CHANNEL_MAGNITUDE)
+		*sample++ = (float)std::hypot(escape.zx, escape.zy);
+
+	if (channels & RAW_CHANNEL_DISTANCE)
+		*sample++ = escape.distance >= 0.0f ? (float)(escape.distance / pixelSize) : -1.0f;
+
+	if (channels & RAW_CHANNEL_PERIOD)
+		*sample++ = (float)escape.period;
+}
+
+
+RawIterationWriter::RawIterationWriter(const char* path, const viewState& view, const uint32_t& channels)
+	: out(path, std::ios::out | std::ios::trunc | std::ios::binary), header{}, rowsWritten(0), finished(false) {
+	fillHeader(view, channels);
+	out.write((const char*)&header, sizeof(header));
+}
+
+
+RawIterationWriter::RawIterationWriter(const char* path, const viewState& view, const uint32_t& channels, const uint32_t& resumeRows)
+	: header{}, rowsWritten(resumeRows), finished(false) {
+	fillHeader(view, channels);
+
+	// The header and the rows before are kept, the file must already hold them
+
+	std::error_code error;
+	uint64_t keptSize = sizeof(header) + (uint64_t)resumeRows * header.width * header.sampleSize;
+	if (resumeRows <= header.height && std::filesystem::file_size(path, error) >= keptSize && !error)
+		std::filesystem::resize_file(path, keptSize, error);
+	else
+		error = std::make_error_code(std::errc::invalid_argument);
+
+	if (!error) {
+		out.open(path, std::ios::in | std::ios::out | std::ios::binary);
+		out.seekp(0, std::ios::end);
+	}
+	else
+		out.setstate(std::ios::failbit);
+}
+
+
+void RawIterationWriter::fillHeader(const viewState& view, const uint32_t& channels) {
+	std::memcpy(header.magic, RAW_ITERATIONS_MAGIC, sizeof(RAW_ITERATIONS_MAGIC));
+	header.version = RAW_ITERATIONS_VERSION;
+	header.headerSize = sizeof(rawIterationHeader);
+	header.width = (uint32_t)view.width;
+	header.height = (uint32_t)view.height;
+	header.maxIterations = (uint32_t)view.maxIterations;
+	header.channels = channels;
+	header.sampleSize = rawSampleFloats(channels) * sizeof(float);
+	header.centerX = view.off.x;
+	header.centerY = view.off.y;
+	header.zoom = view.zoom;
+	header.escapeRadiusSquared = ESCAPE_RADIUS_SQUARED;
+}
+
+
+RawIterationWriter::~RawIterationWriter() {
+	finish();
+}
+
+
+void RawIterationWriter::writeRows(const float* samples, const uint32_t& rowCount) {
+	if (!out || finished)
+		return;
+
+	uint32_t rows = std::min(rowCount, header.height - rowsWritten);
+	out.write((const char*)samples, (std::streamsize)rows * header.width * header.sampleSize);
+	rowsWritten += rows;
+}
+
+
+bool RawIterationWriter::flush() {
+	out.flush();
+	return !out.fail();
+}
+
+
+bool RawIterationWriter::finish() {
+	if (finished)
+		return !out.fail();
+	finished = true;
+
+	// Missing rows are filled with interior samples so that the file always has the size given by its header
+
+	std::vector<float> interiorRow((size_t)header.width * rawSampleFloats(header.channels), 0.0f);
+	for (size_t i = 0; i < interiorRow.size(); i += rawSampleFloats(header.channels))
+		interiorRow[i] = -1.0f;
+
+	while (out && rowsWritten < header.height) {
+		out.write((const char*)interiorRow.data(), (std::streamsize)interiorRow.size() * sizeof(float));
+		++rowsWritten;
+	}
+
+	out.close();
+	return !out.fail();
+}
+
+
+bool RawIterationWriter::isOpen() const {
+	return !out.fail();
+}
+
+
+RawIterationFile::RawIterationFile(const char* path) : data(nullptr), size(0), header{} {
+	// The mapping stays valid after the file is closed
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file != INVALID_HANDLE_VALUE) {
+		LARGE_INTEGER fileSize;
+		HANDLE mapping = GetFileSizeEx(file, &fileSize) ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+		if (mapping != nullptr) {
+			data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			size = (data != nullptr) ? (size_t)fileSize.QuadPart : 0;
+			CloseHandle(mapping);
+		}
+		CloseHandle(file);
+	}
+#else
+	int file = open(path, O_RDONLY);
+	if (file >= 0) {
+		struct stat status;
+		if (fstat(file, &status) == 0 && status.st_size > 0) {
+			void* mapping = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_SHARED, file, 0);
+			if (mapping != MAP_FAILED) {
+				data = (const unsigned char*)mapping;
+				size = (size_t)status.st_size;
+				madvise(mapping, size, MADV_SEQUENTIAL);
+			}
+		}
+		close(file);
+	}
+#endif
+
+	if (data == nullptr) {
+		std::cout << "ERROR:RAW_ITERATIONS_COULD_NOT_BE_READ " << path << '\n';
+		return;
+	}
+
+	// Check the header and that the file holds every sample it announces
+
+	if (size >= sizeof(header))
+		std::memcpy(&header, data, sizeof(header));
+
+	if (size < sizeof(header) || std::memcmp(header.magic, RAW_ITERATIONS_MAGIC, sizeof(RAW_ITERATIONS_MAGIC)) != 0
+		|| header.version < 1 || header.headerSize < sizeof(header) || header.sampleSize < rawSampleFloats(header.channels) * sizeof(float)
+		|| size < header.headerSize + (size_t)header.width * header.height * header.sampleSize) {
+		std::cout << "ERROR:RAW_ITERATIONS_INVALID " << path << '\n';
+		unmap();
+	}
+}
+
+
+RawIterationFile::~RawIterationFile() {
+	unmap();
+}
+
+
+void RawIterationFile::unmap() {
+	if (data == nullptr)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+#else
+	munmap((void*)data, size);
+#endif
+
+	data = nullptr;
+	size = 0;
+}
+
+
+bool RawIterationFile::isOpen() const {
+	return data != nullptr;
+}
+
+
+const rawIterationHeader& RawIterationFile::getHeader() const {
+	return header;
+}
+
+
+viewState RawIterationFile::getView() const {
+	return { { header.centerX, header.centerY }, header.zoom, (int)header.maxIterations, (int)header.width, (int)header.height };
+}
+
+
+const float* RawIterationFile::getSample(const uint32_t& x, const uint32_t& y) const {
+	return (const float*)(data + header.headerSize + ((size_t)y * header.width + x) * header.sampleSize);
+}
+
+
+int RawIterationFile::getChannelOffset(const uint32_t& channel) const {
+	if (!(header.channels & channel))
+		return -1;
+
+	// Channels are stored in the order of their flags, after the iteration count
+
+	return (int)rawSampleFloats(header.channels & (channel - 1));
+}
+
+
+int runRecolor(const std::vector<std::string>& args) {
+	std::vector<std::string> positional = getPositional(args);
+	if (positional.size() != 2) {
+		std::cout << "Usage: --recolor <raw file> <output.png> [--palette name] [--palette-cycle C] [--compression L] [--distance-coloring] [--period-coloring] [--threads N]\n";
+		return -1;
+	}
+
+	float paletteCycle = DEFAULT_PALETTE_CYCLE;
+	int compressionLevel = Z_DEFAULT_COMPRESSION;
+	std::string value, paletteName;
+
+	try {
+		if (getOption(args, "--palette-cycle", value)) paletteCycle = std::stof(value);
+		if (getOption(args, "--compression", value)) compressionLevel = std::stoi(value);
+	}
+	catch (const std::exception&) {
+		std::cout << "ERROR:INVALID_OPTION_VALUE " << value << '\n';
+		return -1;
+	}
+	getOption(args, "--palette", paletteName);
+	unsigned threads = getThreadCount(args);
+
+	if (paletteCycle <= 0 || compressionLevel < Z_DEFAULT_COMPRESSION || compressionLevel > Z_BEST_COMPRESSION) {
+		std::cout << "ERROR:INVALID_OPTION_VALUE\n";
+		return -1;
+	}
+
+	RawIterationFile raw(positional[0].c_str());
+	if (!raw.isOpen())
+		return -1;
+	const rawIterationHeader& header = raw.getHeader();
+
+	// Distance and period coloring need the channels of the render they come from
+
+	int distanceOffset = -1, periodOffset = -1;
+	auto requireChannel = [&](const char* flag, const uint32_t& channel, const char* name, int& offset) {
+		if (!hasFlag(args, flag))
+			return true;
+
+		offset = raw.getChannelOffset(channel);
+		if (offset < 0)
+			std::cout << "ERROR:RAW_CHANNEL_MISSING " << name << ' ' << positional[0] << '\n';
+		return offset >= 0;
+	};
+
+	if (!requireChannel("--distance-coloring", RAW_CHANNEL_DISTANCE, "distance", distanceOffset)
+		|| !requireChannel("--period-coloring", RAW_CHANNEL_PERIOD, "period", periodOffset))
+		return -1;
+
+	std::vector<std::unique_ptr<Palette>> palettes = loadPalettes(RECOLOR_PALETTES_PATH);
+	Palette* palette = paletteName.empty() ? palettes.front().get() : findPalette(palettes, paletteName);
+	if (palette == nullptr) {
+		std::cout << "ERROR:UNKNOWN_PALETTE " << paletteName << '\n';
+		return -1;
+	}
+
+	std::filesystem::path outputPath(positional[1]);
+	if (outputPath.has_parent_path())
+		std::filesystem::create_directories(outputPath.parent_path());
+
+	auto start = std::chrono::steady_clock::now();
+	PngWriter png(positional[1].c_str(), header.width, header.height, compressionLevel);
+	std::vector<unsigned char> band((size_t)RECOLOR_BAND_ROWS * header.width * 3);
+
+	for (uint32_t first = 0; first < header.height && png.isOpen(); first += RECOLOR_BAND_ROWS) {
+		uint32_t count = std::min(RECOLOR_BAND_ROWS, header.height - first);
+
+		// The iteration counts are colored straight from the mapping
+
+		parallelRows((int)count, threads, [&](int row) {
+			unsigned char* pixel = band.data() + (size_t)row * header.width * 3;
+			for (uint32_t column = 0; column < header.width; ++column, pixel += 3) {
+				const float* sample = raw.getSample(column, first + row);
+				std::array<unsigned char, 3> color = (periodOffset >= 0 && sample[periodOffset] > 0.0f)
+					? periodColor(*palette, (uint32_t)sample[periodOffset]) : map_to_color(*palette, *sample, paletteCycle);
+				if (distanceOffset >= 0)
+					color = shadeDistance(color, sample[distanceOffset]);
+				std::copy(color.begin(), color.end(), pixel);
+			}
+		});
+
+		png.writeRows(band.data(), count);
+	}
+
+	bool written = png.finish();
+
+	if (!written) {
+		std::cout << "ERROR:IMAGE_COULD_NOT_BE_WRITTEN " << positional[1] << '\n';
+		return 1;
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "Recolored " << header.width << " x " << header.height << " in " << seconds << " s\n";
+
+	return 0;
+}
@@ -1,4 +1,5 @@
 #include "shader.h"
+#include "trace.h"
 
 
 const std::string Shader::readFileToString(const char* path) {
@@ -22,13 +23,13 @@ const std::string Shader::readFileToString(const char* path) {
 	}
 	catch (std::ifstream::failure err) {
 		
-		std::cout << "ERROR:SHADER_SOURCE_COULD_NOT_BE_READ\n";
+		std::cout << "ERROR:SHADER_SOURCE_COULD_NOT_BE_READ " << path << '\n';
 	    return {};
 	}
 }
 
 
-void Shader::loadShader(const char* shaderPath, const GLenum& shaderType, GLuint& shader) {
+bool Shader::loadShader(const char* shaderPath, const GLenum& shaderType, GLuint& shader) {
 	// Read the shader source as std::string and convert it to GLchar*
 	
 	const std::string& tempSource = readFileToString(shaderPath);  // lvalue reference to the const string returned to extend lifetime of the string
@@ -50,45 +51,83 @@ void Shader::loadShader(const char* shaderPath, const GLenum& shaderType, GLuint
 	if (!success) {
 		GLchar infoLog[512];
 		glGetShaderInfoLog(shader, 512, nullptr, infoLog);
-		std::cout << "ERROR:SHADER_COMPILATION_FAILED\n" << infoLog << '\n';
+		std::cout << "ERROR:SHADER_COMPILATION_FAILED " << shaderPath << '\n' << infoLog << '\n';
 	}
+
+	return success;
+}
+
+
+GLuint Shader::buildProgram(const std::vector<shaderStage>& stages) {
+	TRACE_SCOPE("build shader program");
+
+	// Compile every stage
+
+	std::vector<GLuint> shaders;
+	bool compiled = true;
+
+	for (const shaderStage& stage : stages) {
+		GLuint shader;
+		compiled &= loadShader(stage.path.c_str(), stage.type, shader);
+		shaders.push_back(shader);
+	}
+
+	// Create the Shader Program and link all the stages to it
+
+	GLuint program = 0;
+	if (compiled) {
+		program = glCreateProgram();
+		for (GLuint shader : shaders)
+			glAttachShader(program, shader);
+		glLinkProgram(program);
+	}
+
+	// Cleanup
+
+	for (GLuint shader : shaders)
+		glDeleteShader(shader);
+
+	if (program != 0 && !checkLinking(program)) {
+		glDeleteProgram(program);
+		program = 0;
+	}
+
+	return program;
 }
 
 
 Shader::Shader(const char* vertexShaderPath, const char* fragmentShaderPath) {
 	ID = new GLuint;
 
-	// Vertex Shader
+	// Vertex and Fragment Shader
 
-	GLuint vertexShader;
-	loadShader(vertexShaderPath, GL_VERTEX_SHADER, vertexShader);
-	
-	// Fragment Shader
+	stages = { { vertexShaderPath, GL_VERTEX_SHADER }, { fragmentShaderPath, GL_FRAGMENT_SHADER } };
+	*ID = buildProgram(stages);
+}
 
-	GLuint fragmentShader;
-	loadShader(fragmentShaderPath, GL_FRAGMENT_SHADER, fragmentShader);
 
-	// Create the Shader Program and link the vertex and fragment shader to it
+Shader::Shader(const char* computeShaderPath) {
+	ID = new GLuint;
 
-	*ID = glCreateProgram();
-	glAttachShader(*ID, vertexShader);
-	glAttachShader(*ID, fragmentShader);
-	glLinkProgram(*ID);
+	// Compute Shader
 
-	// Cleanup
+	stages = { { computeShaderPath, GL_COMPUTE_SHADER } };
+	*ID = buildProgram(stages);
+}
 
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
 
+bool Shader::checkLinking(const GLuint& program) {
 	// Check for linking errors
 	
 	GLint success;
-	glGetProgramiv(*ID, GL_LINK_STATUS, &success);
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
 	if (!success) {
 		GLchar infoLog[512];
-		glGetProgramInfoLog(*ID, 512, nullptr, infoLog);
+		glGetProgramInfoLog(program, 512, nullptr, infoLog);
 		std::cout << "ERROR:SHADER_PROGRAM_LINKING_FAILED\n" << infoLog << '\n';
 	}
+
+	return success;
 }
 
 
@@ -110,6 +149,17 @@ GLuint Shader::getID() {
 	return *this->ID;
 }
 
+
+const std::vector<shaderStage>& Shader::getStages() {
+	return stages;
+}
+
+
+void Shader::swapProgram(const GLuint& program) {
+	glDeleteProgram(*this->ID);
+	*this->ID = program;
+}
+
 void Shader::setValues(const GLuint& width, const GLuint& height, const GLdouble& x, const GLdouble& y, const GLdouble& zoom, const GLuint& maxIterations) {
 	// Ensure that the correct shader program is in use
 	
@@ -121,4 +171,31 @@ void Shader::setValues(const GLuint& width, const GLuint& height, const GLdouble
 	glUniform2d(glGetUniformLocation(*this->ID, "off"), x, y);
 	glUniform1d(glGetUniformLocation(*this->ID, "zoom"), zoom);
 	glUniform1ui(glGetUniformLocation(*this->ID, "maxIterations"), maxIterations);
+}
+
+
+void Shader::setColoring(const GLint& paletteUnit, const GLfloat& paletteCycle, const GLuint& coloringMode) {
+	this->use();
+
+	glUniform1i(glGetUniformLocation(*this->ID, "palette"), paletteUnit);
+	glUniform1f(glGetUniformLocation(*this->ID, "paletteCycle"), paletteCycle);
+	glUniform1ui(glGetUniformLocation(*this->ID, "coloringMode"), coloringMode);
+}
+
+
+void Shader::setUInt(const char* name, const GLuint& value) {
+	this->use();
+	glUniform1ui(glGetUniformLocation(*this->ID, name), value);
+}
+
+
+void Shader::setInt(const char* name, const GLint& value) {
+	this->use();
+	glUniform1i(glGetUniformLocation(*this->ID, name), value);
+}
+
+
+void Shader::setFloat(const char* name, const GLfloat& value) {
+	this->use();
+	glUniform1f(glGetUniformLocation(*this->ID, name), value);
 }
\ No newline at end of file
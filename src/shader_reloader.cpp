@@ -0,0 +1,195 @@
+#include "shader_reloader.h"
+#include "helpers.h"
+#include "trace.h"
+
+#include <iostream>
+#include <filesystem>
+#include <chrono>
+#include <map>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+
+// How long the worker waits for further changes before rebuilding (editors often write a file in several steps)
+
+constexpr int SETTLE_MILLISECONDS = 100;
+
+// Interval at which the worker checks for changes and for the request to stop
+
+constexpr int POLL_MILLISECONDS = 250;
+
+
+ShaderReloader::ShaderReloader(GLFWwindow* window, const char* directory)
+	: directory(directory), stopping(false) {
+	workerContext = createSharedContext(window);
+	if (workerContext == nullptr)
+		std::cout << "ERROR:SHADER_RELOAD_CONTEXT_COULD_NOT_BE_CREATED\n";
+}
+
+
+ShaderReloader::~ShaderReloader() {
+	stopping = true;
+	if (worker.joinable())
+		worker.join();
+
+	for (rebuiltProgram& program : rebuilt) {
+		glDeleteSync(program.fence);
+		glDeleteProgram(program.program);
+	}
+
+	if (workerContext != nullptr)
+		glfwDestroyWindow(workerContext);
+}
+
+
+void ShaderReloader::watch(Shader& shader) {
+	shaders.push_back(&shader);
+}
+
+
+void ShaderReloader::start() {
+	if (workerContext != nullptr)
+		worker = std::thread(&ShaderReloader::watchFiles, this);
+}
+
+
+void ShaderReloader::update() {
+	std::lock_guard<std::mutex> lock(rebuiltMutex);
+
+	// The programs are only used once the worker's commands are known to be complete
+
+	auto swapped = std::remove_if(rebuilt.begin(), rebuilt.end(), [](rebuiltProgram& program) {
+		GLenum status = glClientWaitSync(program.fence, 0, 0);
+		if (status == GL_TIMEOUT_EXPIRED)
+			return false;
+
+		glDeleteSync(program.fence);
+		program.shader->swapProgram(program.program);
+		return true;
+	});
+
+	if (swapped != rebuilt.end())
+		std::cout << "Shaders reloaded\n";
+
+	rebuilt.erase(swapped, rebuilt.end());
+}
+
+
+void ShaderReloader::rebuild(const std::vector<std::string>& changedFiles) {
+	for (Shader* shader : shaders) {
+		const std::vector<shaderStage>& stages = shader->getStages();
+
+		bool affected = std::any_of(stages.begin(), stages.end(), [&](const shaderStage& stage) {
+			return std::find(changedFiles.begin(), changedFiles.end(), std::filesystem::path(stage.path).filename().string()) != changedFiles.end();
+		});
+		if (!affected)
+			continue;
+
+		// Keep the old program if the new sources do not compile or link
+
+		GLuint program = Shader::buildProgram(stages);
+		if (program == 0) {
+			std::cout << "Keeping the previous program of " << stages.back().path << '\n';
+			continue;
+		}
+
+		// The fence tells the render loop when the program can be used from the other context
+
+		GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glFlush();
+
+		std::lock_guard<std::mutex> lock(rebuiltMutex);
+		rebuilt.push_back({ shader, program, fence });
+	}
+}
+
+
+#ifdef __linux__
+
+void ShaderReloader::watchFiles() {
+	setTraceThreadName("shader reloader");
+	glfwMakeContextCurrent(workerContext);
+
+	int inotify = inotify_init1(IN_NONBLOCK);
+	if (inotify < 0 || inotify_add_watch(inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		std::cout << "ERROR:SHADER_DIRECTORY_COULD_NOT_BE_WATCHED " << directory << '\n';
+		if (inotify >= 0)
+			close(inotify);
+		glfwMakeContextCurrent(nullptr);
+		return;
+	}
+
+	alignas(inotify_event) char buffer[4096];
+	std::vector<std::string> changedFiles;
+
+	while (!stopping) {
+		// Collect events until no more arrive for a short while, then rebuild
+
+		pollfd descriptor{ inotify, POLLIN, 0 };
+		int ready = poll(&descriptor, 1, changedFiles.empty() ? POLL_MILLISECONDS : SETTLE_MILLISECONDS);
+
+		if (ready <= 0) {
+			if (!changedFiles.empty()) {
+				rebuild(changedFiles);
+				changedFiles.clear();
+			}
+			continue;
+		}
+
+		ssize_t length;
+		while ((length = read(inotify, buffer, sizeof(buffer))) > 0) {
+			for (char* position = buffer; position < buffer + length; ) {
+				inotify_event* event = (inotify_event*)position;
+				if (event->len > 0 && std::filesystem::path(event->name).extension() == ".glsl")
+					changedFiles.push_back(event->name);
+				position += sizeof(inotify_event) + event->len;
+			}
+		}
+	}
+
+	close(inotify);
+	glfwMakeContextCurrent(nullptr);
+}
+
+#else
+
+void ShaderReloader::watchFiles() {
+	setTraceThreadName("shader reloader");
+	glfwMakeContextCurrent(workerContext);
+
+	// Without inotify the modification times of the sources are polled
+
+	std::map<std::string, std::filesystem::file_time_type> modified;
+	std::error_code error;
+
+	for (const auto& entry : std::filesystem::directory_iterator(directory, error))
+		modified[entry.path().filename().string()] = entry.last_write_time(error);
+
+	while (!stopping) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(POLL_MILLISECONDS));
+
+		std::vector<std::string> changedFiles;
+		for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+			std::string name = entry.path().filename().string();
+			auto time = entry.last_write_time(error);
+			if (entry.path().extension() == ".glsl" && modified[name] != time) {
+				modified[name] = time;
+				changedFiles.push_back(name);
+			}
+		}
+
+		if (!changedFiles.empty()) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(SETTLE_MILLISECONDS));
+			rebuild(changedFiles);
+		}
+	}
+
+	glfwMakeContextCurrent(nullptr);
+}
+
+#endif
@@ -0,0 +1,70 @@
+#include "supersampler.h"
+
+
+const std::vector<samplePattern> SAMPLE_PATTERNS = {
+	{ "off", {} },
+	{ "rotated grid 4x", { { -0.375f, 0.125f }, { 0.125f, 0.375f }, { 0.375f, -0.125f }, { -0.125f, -0.375f } } },
+	{ "grid 3x3", {
+		{ -1.0f / 3, -1.0f / 3 }, { 0.0f, -1.0f / 3 }, { 1.0f / 3, -1.0f / 3 },
+		{ -1.0f / 3, 0.0f }, { 0.0f, 0.0f }, { 1.0f / 3, 0.0f },
+		{ -1.0f / 3, 1.0f / 3 }, { 0.0f, 1.0f / 3 }, { 1.0f / 3, 1.0f / 3 } } },
+	{ "grid 4x4", {
+		{ -0.375f, -0.375f }, { -0.125f, -0.375f }, { 0.125f, -0.375f }, { 0.375f, -0.375f },
+		{ -0.375f, -0.125f }, { -0.125f, -0.125f }, { 0.125f, -0.125f }, { 0.375f, -0.125f },
+		{ -0.375f, 0.125f }, { -0.125f, 0.125f }, { 0.125f, 0.125f }, { 0.375f, 0.125f },
+		{ -0.375f, 0.375f }, { -0.125f, 0.375f }, { 0.125f, 0.375f }, { 0.375f, 0.375f } } }
+};
+
+
+EdgeSupersampler::EdgeSupersampler(const char* vertexShaderPath, const char* fragmentShaderPath)
+	: program(vertexShaderPath, fragmentShaderPath), memory("supersampler", memoryDomain::gpu) {
+
+	// Binding point 3 holds the amount of work spent in the current frame
+
+	glGenBuffers(1, &costSSBO);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, costSSBO);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, costSSBO);
+	memory.set(sizeof(GLuint));
+
+	// Binding point 6 holds the progress of the samples of every pixel, allocated by resize
+
+	glGenBuffers(1, &sampleSSBO);
+}
+
+
+EdgeSupersampler::~EdgeSupersampler() {
+	glDeleteBuffers(1, &costSSBO);
+	glDeleteBuffers(1, &sampleSSBO);
+}
+
+
+Shader& EdgeSupersampler::getProgram() {
+	return program;
+}
+
+
+void EdgeSupersampler::resize(const GLuint& width, const GLuint& height) {
+	// All zero is generation 0, which is never current, so every pixel starts with its first sample
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, sampleSSBO);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)width * height * SAMPLE_STATE_SIZE, nullptr, GL_DYNAMIC_COPY);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, sampleSSBO);
+	memory.set(sizeof(GLuint) + (int64_t)width * height * SAMPLE_STATE_SIZE);
+}
+
+
+void EdgeSupersampler::prepare(const samplePattern& pattern, const GLuint& generation, const GLuint& costBudget, const GLfloat& edgeThreshold) {
+	// Start counting the work of this frame from zero
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, costSSBO);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+	program.use();
+	glUniform2fv(glGetUniformLocation(program.getID(), "sampleOffsets"), (GLsizei)pattern.offsets.size(), pattern.offsets.data()->data());
+	program.setUInt("sampleCount", (GLuint)pattern.offsets.size());
+	program.setUInt("supersampleGeneration", generation);
+	program.setUInt("costBudget", costBudget);
+	program.setFloat("edgeThreshold", edgeThreshold);
+}
@@ -0,0 +1,254 @@
+#include "tile_pyramid.h"
+#include "cli.h"
+#include "mandelbrot.h"
+#include "png_writer.h"
+
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <set>
+#include <chrono>
+#include <limits>
+#include <cmath>
+
+
+// Set the default tile size, iteration count and palette directory
+constexpr int TILE_SIZE = 256;
+constexpr int TILE_ITERATIONS = 1000;
+const char* TILE_PALETTES_PATH = "./palettes";
+
+// Levels are limited so that the tile indices of a level fit in an int
+constexpr int MAX_TILE_LEVELS = 15;
+
+// A tile whose continuous iteration counts cross more palette segments than this is never uniform
+constexpr int MAX_UNIFORM_SEGMENTS = 64;
+
+// Marks a tile that is not known to be uniform in the per level lists
+constexpr int32_t NOT_UNIFORM = -1;
+
+
+viewState tileView(const pyramidRoot& root, const int& level, const int& x, const int& y, const int& tileSize, const int& maxIterations) {
+	double tiles = std::ldexp(1.0, level);
+	double side = 4.0 / root.zoom;
+
+	coord center{
+		root.center.x - side / 2 + (x + 0.5) * side / tiles,
+		root.center.y + side / 2 - (y + 0.5) * side / tiles
+	};
+
+	return { center, root.zoom * tiles, maxIterations, tileSize, tileSize };
+}
+
+
+bool uniformTileColor(const viewState& view, const Palette& palette, const float& paletteCycle, std::array<unsigned char, 3>& color) {
+	// Iterate the outermost ring of pixels
+
+	float lowest = std::numeric_limits<float>::max(), highest = -1.0f;
+	bool anyInterior = false;
+
+	for (int i = 0; i < view.width && !(anyInterior && highest >= 0); ++i) {
+		const int positions[4][2] = { { i, 0 }, { i, view.height - 1 }, { 0, i }, { view.width - 1, i } };
+
+		for (const int* position : positions) {
+			coord c = imageToCoord(view, position[0] + 0.5, position[1] + 0.5);
+			pixelEscape escape = iterateMandelbrot(c.x, c.y, view.maxIterations);
+
+			if (escape.escaped) {
+				float iteration = smoothIteration(escape);
+				lowest = std::min(lowest, iteration);
+				highest = std::max(highest, iteration);
+			}
+			else
+				anyInterior = true;
+		}
+	}
+
+	if (highest < 0) {
+		color = { 0, 0, 0 };
+		return true;
+	}
+
+	if (anyInterior)
+		return false;
+
+	// The set is connected and contains 0 and -2, if the tile misses either the escaping border means that the tile misses the set
+
+	coord topLeft = imageToCoord(view, 0, 0), bottomRight = imageToCoord(view, view.width, view.height);
+	auto contains = [&](const double& x, const double& y) {
+		return x >= topLeft.x && x <= bottomRight.x && y >= bottomRight.y && y <= topLeft.y;
+	};
+
+	if (contains(0.0, 0.0) && contains(-2.0, 0.0))
+		return false;
+
+	// The palette is linear between the half steps of (iteration / paletteCycle * size), so the color is constant
+	// over the range if it is the same at both ends and at every half step in between
+
+	double scale = 2.0 * palette.getSize() / paletteCycle;
+	double firstStep = std::ceil(lowest * scale), lastStep = std::floor(highest * scale);
+	if (lastStep - firstStep > MAX_UNIFORM_SEGMENTS)
+		return false;
+
+	color = map_to_color(palette, lowest, paletteCycle);
+	if (map_to_color(palette, highest, paletteCycle) != color)
+		return false;
+
+	for (double step = firstStep; step <= lastStep; ++step)
+		if (map_to_color(palette, (float)(step / scale), paletteCycle) != color)
+			return false;
+
+	return true;
+}
+
+
+int runTilePyramid(const std::vector<std::string>& args) {
+	std::vector<std::string> positional = getPositional(args);
+	if (positional.size() != 5) {
+		std::cout << "Usage: --tiles <output directory> <x> <y> <zoom> <levels> [--tile-size S] [--max-iterations N] [--palette name]"
+			" [--palette-cycle C] [--threads N]\n";
+		return -1;
+	}
+
+	pyramidRoot root{ {}, 1.0 };
+	int levels, tileSize = TILE_SIZE, iterations = TILE_ITERATIONS;
+	float paletteCycle = DEFAULT_PALETTE_CYCLE;
+	std::string value, paletteName;
+
+	try {
+		root.center.x = std::stod(value = positional[1]);
+		root.center.y = std::stod(value = positional[2]);
+		root.zoom = std::stod(value = positional[3]);
+		levels = std::stoi(value = positional[4]);
+		if (getOption(args, "--tile-size", value)) tileSize = std::stoi(value);
+		if (getOption(args, "--max-iterations", value)) iterations = std::stoi(value);
+		if (getOption(args, "--palette-cycle", value)) paletteCycle = std::stof(value);
+	}
+	catch (const std::exception&) {
+		std::cout << "ERROR:INVALID_OPTION_VALUE " << value << '\n';
+		return -1;
+	}
+	getOption(args, "--palette", paletteName);
+	unsigned threads = getThreadCount(args);
+
+	if (root.zoom <= 0 || levels <= 0 || levels > MAX_TILE_LEVELS || tileSize <= 1 || iterations <= 0 || paletteCycle <= 0) {
+		std::cout << "ERROR:INVALID_OPTION_VALUE\n";
+		return -1;
+	}
+
+	std::vector<std::unique_ptr<Palette>> palettes = loadPalettes(TILE_PALETTES_PATH);
+	Palette* palette = paletteName.empty() ? palettes.front().get() : findPalette(palettes, paletteName);
+	if (palette == nullptr) {
+		std::cout << "ERROR:UNKNOWN_PALETTE " << paletteName << '\n';
+		return -1;
+	}
+
+	std::filesystem::path directory(positional[0]);
+	std::filesystem::create_directories(directory / "uniform");
+
+	// Every uniform color is written once, the tiles of that color are hard links to it (or copies where links are not supported)
+
+	std::set<int32_t> writtenColors;
+	std::mutex uniformMutex;
+	std::atomic<bool> failed(false);
+
+	auto writeUniformTile = [&](const int32_t& packedColor, const std::filesystem::path& path) {
+		char name[16];
+		std::snprintf(name, sizeof(name), "%06x.png", (unsigned)packedColor);
+		std::filesystem::path shared = directory / "uniform" / name;
+
+		{
+			std::lock_guard<std::mutex> lock(uniformMutex);
+			if (writtenColors.insert(packedColor).second) {
+				std::vector<unsigned char> rgb((size_t)tileSize * tileSize * 3);
+				for (size_t i = 0; i < rgb.size(); i += 3) {
+					rgb[i] = (unsigned char)(packedColor >> 16);
+					rgb[i + 1] = (unsigned char)(packedColor >> 8);
+					rgb[i + 2] = (unsigned char)packedColor;
+				}
+				if (!writePng(shared.string().c_str(), rgb.data(), tileSize, tileSize))
+					failed = true;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::remove(path, error);
+		std::filesystem::create_hard_link(shared, path, error);
+		if (error && !std::filesystem::copy_file(shared, path, std::filesystem::copy_options::overwrite_existing, error))
+			failed = true;
+	};
+
+	// Tiles found uniform from their border, the children of such a tile are uniform with the same color
+
+	std::vector<int32_t> elidedParents;
+	auto start = std::chrono::steady_clock::now();
+	uint64_t totalTiles = 0, totalComputed = 0;
+
+	for (int level = 0; level < levels && !failed; ++level) {
+		int tiles = 1 << level;
+		for (int x = 0; x < tiles; ++x)
+			std::filesystem::create_directories(directory / std::to_string(level) / std::to_string(x));
+
+		std::vector<int32_t> elided((size_t)tiles * tiles, NOT_UNIFORM);
+		std::atomic<uint64_t> computed(0), bordered(0), inherited(0), shared(0);
+
+		parallelRows(tiles * tiles, threads, [&](int index) {
+			int x = index % tiles, y = index / tiles;
+			std::filesystem::path path = directory / std::to_string(level) / std::to_string(x) / (std::to_string(y) + ".png");
+			viewState view = tileView(root, level, x, y, tileSize, iterations);
+
+			int32_t packedColor = (level > 0) ? elidedParents[(size_t)(y / 2) * (tiles / 2) + x / 2] : NOT_UNIFORM;
+			std::array<unsigned char, 3> color;
+
+			if (packedColor != NOT_UNIFORM)
+				++inherited;
+			else if (uniformTileColor(view, *palette, paletteCycle, color)) {
+				packedColor = (color[0] << 16) | (color[1] << 8) | color[2];
+				++bordered;
+			}
+
+			if (packedColor != NOT_UNIFORM) {
+				elided[index] = packedColor;
+				writeUniformTile(packedColor, path);
+				return;
+			}
+
+			// Compute the tile, it is still shared if it turns out to have a single color
+
+			std::vector<pixelEscape> escapes;
+			std::vector<unsigned char> rgb;
+			renderEscapes(view, escapes, 1, true);
+			colorEscapes(escapes, *palette, paletteCycle, rgb);
+			++computed;
+
+			bool single = true;
+			for (size_t i = 3; i < rgb.size() && single; i += 3)
+				single = rgb[i] == rgb[0] && rgb[i + 1] == rgb[1] && rgb[i + 2] == rgb[2];
+
+			if (single) {
+				writeUniformTile((rgb[0] << 16) | (rgb[1] << 8) | rgb[2], path);
+				++shared;
+			}
+			else if (!writePng(path.string().c_str(), rgb.data(), tileSize, tileSize))
+				failed = true;
+		});
+
+		std::cout << "Level " << level << ": " << (uint64_t)tiles * tiles << " tiles, " << computed << " computed (" << shared << " of them uniform), "
+			<< bordered << " uniform from their border, " << inherited << " inherited from a uniform parent\n";
+
+		elidedParents = std::move(elided);
+		totalTiles += (uint64_t)tiles * tiles;
+		totalComputed += computed;
+	}
+
+	if (failed) {
+		std::cout << "ERROR:TILE_COULD_NOT_BE_WRITTEN " << positional[0] << '\n';
+		return 1;
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "Wrote " << totalTiles << " tiles in " << seconds << " s, " << totalComputed << " of them were computed\n";
+
+	return 0;
+}
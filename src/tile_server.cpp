@@ -0,0 +1,448 @@
+#include "tile_server.h"
+#include "tile_pyramid.h"
+#include "cli.h"
+#include "mandelbrot.h"
+#include "png_writer.h"
+#include "json_writer.h"
+#include "net.h"
+#include "memory_registry.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <algorithm>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <chrono>
+#include <cstdio>
+
+
+// Set the default port, tile size, iteration count, palette directory and cache settings
+constexpr uint16_t SERVER_PORT = 8080;
+constexpr int SERVER_TILE_SIZE = 256;
+constexpr int SERVER_ITERATIONS = 1000;
+const char* SERVER_PALETTES_PATH = "./palettes";
+const char* SERVER_CACHE_PATH = "./tile_cache";
+constexpr double SERVER_CACHE_MEGABYTES = 256.0;
+
+// Deepest level served (the tile indices of a level must fit in an int)
+constexpr int MAX_SERVER_LEVEL = 30;
+
+// Largest request header accepted and the time a client has to send it
+constexpr size_t MAX_REQUEST_SIZE = 8192;
+constexpr int REQUEST_TIMEOUT_MILLISECONDS = 5000;
+
+// Interval at which a connection waiting for its tile checks whether the client is still there
+constexpr auto DISCONNECT_CHECK_INTERVAL = std::chrono::milliseconds(50);
+
+
+TileCache::TileCache(const size_t& capacity) : capacity(capacity), size(0), memory("tile cache", memoryDomain::cpu) {}
+
+
+tileData TileCache::get(const std::string& key) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto entry = index.find(key);
+	if (entry == index.end())
+		return nullptr;
+
+	entries.splice(entries.begin(), entries, entry->second);
+	return entry->second->second;
+}
+
+
+void TileCache::put(const std::string& key, const tileData& data) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto entry = index.find(key);
+	if (entry != index.end()) {
+		size -= entry->second->second->size();
+		entries.erase(entry->second);
+		index.erase(entry);
+	}
+
+	entries.emplace_front(key, data);
+	index[key] = entries.begin();
+	size += data->size();
+
+	while ((size > capacity || !memory.fits((int64_t)size)) && entries.size() > 1) {
+		size -= entries.back().second->size();
+		index.erase(entries.back().first);
+		entries.pop_back();
+	}
+	memory.set((int64_t)size);
+}
+
+
+// A tile that is being rendered, shared by every connection waiting for it
+
+struct pendingTile {
+	std::string key;
+	int level, x, y;
+	int waiters;
+	bool done;
+	std::atomic<bool> cancelled;
+	tileData data;
+};
+
+
+struct serverState {
+	pyramidRoot root;
+	int tileSize, maxIterations;
+	Palette* palette;
+	float paletteCycle;
+	std::filesystem::path cacheDirectory;
+
+	TileCache* cache;
+
+	// Tiles being rendered by key and the queue of the render threads, both guarded by mutex
+
+	std::unordered_map<std::string, std::shared_ptr<pendingTile>> pending;
+	std::deque<std::shared_ptr<pendingTile>> queue;
+	std::mutex mutex;
+	std::condition_variable queueChanged, tileFinished;
+
+	std::atomic<uint64_t> requests, memoryHits, diskHits, rendered, coalesced, cancelled, failed;
+};
+
+
+static tileData readTileFile(const std::filesystem::path& path) {
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+		return nullptr;
+
+	std::ostringstream content;
+	content << in.rdbuf();
+	std::string bytes = content.str();
+
+	return std::make_shared<const std::vector<unsigned char>>(bytes.begin(), bytes.end());
+}
+
+
+static std::filesystem::path tilePath(const serverState& server, const int& level, const int& x, const int& y) {
+	return server.cacheDirectory / std::to_string(level) / std::to_string(x) / (std::to_string(y) + ".png");
+}
+
+
+// Render a tile into the disk cache and return its encoded data, nullptr if it was cancelled or could not be written
+
+static tileData renderTile(serverState& server, pendingTile& tile) {
+	viewState view = tileView(server.root, tile.level, tile.x, tile.y, server.tileSize, server.maxIterations);
+	std::vector<unsigned char> rgb((size_t)view.width * view.height * 3);
+	TrackedMemory memory("tile rendering", memoryDomain::cpu);
+	memory.set((int64_t)rgb.size());
+
+	std::array<unsigned char, 3> color;
+	if (uniformTileColor(view, *server.palette, server.paletteCycle, color)) {
+		for (size_t i = 0; i < rgb.size(); i += 3)
+			std::copy(color.begin(), color.end(), rgb.begin() + i);
+	}
+	else {
+		for (int row = 0; row < view.height; ++row) {
+			if (tile.cancelled)
+				return nullptr;
+
+			for (int column = 0; column < view.width; ++column) {
+				coord c = imageToCoord(view, column + 0.5, row + 0.5);
+				color = map_to_color(*server.palette, iterateMandelbrotAnalyzed(c.x, c.y, view.maxIterations, false, true), server.paletteCycle);
+				std::copy(color.begin(), color.end(), rgb.begin() + ((size_t)row * view.width + column) * 3);
+			}
+		}
+	}
+
+	// The file is renamed into place once complete, so a partially written tile is never served
+
+	std::filesystem::path path = tilePath(server, tile.level, tile.x, tile.y);
+	std::filesystem::path temporary = path;
+	temporary += ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+
+	std::error_code error;
+	std::filesystem::create_directories(path.parent_path(), error);
+	if (!writePng(temporary.string().c_str(), rgb.data(), view.width, view.height))
+		return nullptr;
+	std::filesystem::rename(temporary, path, error);
+
+	return error ? nullptr : readTileFile(path);
+}
+
+
+static void renderTiles(serverState& server) {
+	while (true) {
+		std::shared_ptr<pendingTile> tile;
+		{
+			std::unique_lock<std::mutex> lock(server.mutex);
+			server.queueChanged.wait(lock, [&]() { return !server.queue.empty(); });
+			tile = server.queue.front();
+			server.queue.pop_front();
+		}
+
+		tileData data = tile->cancelled ? nullptr : renderTile(server, *tile);
+
+		if (data != nullptr) {
+			server.cache->put(tile->key, data);
+			++server.rendered;
+		}
+		else if (!tile->cancelled)
+			++server.failed;
+
+		{
+			std::lock_guard<std::mutex> lock(server.mutex);
+			tile->data = data;
+			tile->done = true;
+
+			auto entry = server.pending.find(tile->key);
+			if (entry != server.pending.end() && entry->second == tile)
+				server.pending.erase(entry);
+		}
+		server.tileFinished.notify_all();
+	}
+}
+
+
+static void sendResponse(const socketHandle& connection, const char* status, const char* contentType, const void* body, const size_t& size) {
+	std::string header = std::string("HTTP/1.1 ") + status + "\r\nContent-Type: " + contentType + "\r\nContent-Length: " + std::to_string(size)
+		+ "\r\nAccess-Control-Allow-Origin: *\r\nConnection: close\r\n\r\n";
+
+	if (sendAll(connection, header.data(), header.size()))
+		sendAll(connection, body, size);
+}
+
+
+static void sendError(const socketHandle& connection, const char* status) {
+	std::string body = std::string(status) + '\n';
+	sendResponse(connection, status, "text/plain", body.data(), body.size());
+}
+
+
+static void sendStatistics(serverState& server, const socketHandle& connection) {
+	std::ostringstream out;
+	JsonWriter json(out);
+	json.beginObject();
+	json.key("requests");
+	json.value((uint64_t)server.requests);
+	json.key("memoryHits");
+	json.value((uint64_t)server.memoryHits);
+	json.key("diskHits");
+	json.value((uint64_t)server.diskHits);
+	json.key("rendered");
+	json.value((uint64_t)server.rendered);
+	json.key("coalesced");
+	json.value((uint64_t)server.coalesced);
+	json.key("cancelled");
+	json.value((uint64_t)server.cancelled);
+	json.key("failed");
+	json.value((uint64_t)server.failed);
+	json.key("memory");
+	writeMemoryUsage(json);
+	json.endObject();
+	out << '\n';
+
+	std::string body = out.str();
+	sendResponse(connection, "200 OK", "application/json", body.data(), body.size());
+}
+
+
+// Wait for a tile rendered on behalf of this connection and possibly others
+// Returns nullptr if the client disconnected (the rendering is cancelled when nobody waits for it anymore)
+
+static tileData waitForTile(serverState& server, const socketHandle& connection, const std::string& key, const int& level, const int& x, const int& y) {
+	std::unique_lock<std::mutex> lock(server.mutex);
+
+	std::shared_ptr<pendingTile> tile;
+	auto entry = server.pending.find(key);
+	if (entry != server.pending.end() && !entry->second->cancelled) {
+		tile = entry->second;
+		++server.coalesced;
+	}
+	else {
+		tile = std::make_shared<pendingTile>();
+		tile->key = key;
+		tile->level = level;
+		tile->x = x;
+		tile->y = y;
+		tile->waiters = 0;
+		tile->done = false;
+		tile->cancelled = false;
+
+		server.pending[key] = tile;
+		server.queue.push_back(tile);
+		server.queueChanged.notify_one();
+	}
+	++tile->waiters;
+
+	while (!tile->done) {
+		server.tileFinished.wait_for(lock, DISCONNECT_CHECK_INTERVAL);
+		if (tile->done)
+			break;
+
+		lock.unlock();
+		bool closed = peerClosed(connection);
+		lock.lock();
+
+		if (closed && !tile->done) {
+			if (--tile->waiters == 0) {
+				tile->cancelled = true;
+				++server.cancelled;
+			}
+			return nullptr;
+		}
+	}
+
+	return tile->data;
+}
+
+
+static void handleConnection(serverState& server, const socketHandle& connection) {
+	// Read the request header
+
+	std::string request;
+	char buffer[1024];
+	while (request.find("\r\n\r\n") == std::string::npos && request.size() < MAX_REQUEST_SIZE) {
+		long received = waitReadable(connection, REQUEST_TIMEOUT_MILLISECONDS) ? receiveSome(connection, buffer, sizeof(buffer)) : -1;
+		if (received <= 0) {
+			closeSocket(connection);
+			return;
+		}
+		request.append(buffer, (size_t)received);
+	}
+
+	++server.requests;
+
+	std::istringstream requestLine(request.substr(0, request.find("\r\n")));
+	std::string method, target;
+	requestLine >> method >> target;
+
+	int level, x, y, consumed = 0;
+	bool isTile = std::sscanf(target.c_str(), "/%d/%d/%d.png%n", &level, &x, &y, &consumed) == 3 && consumed == (int)target.size();
+
+	if (method != "GET")
+		sendError(connection, "405 Method Not Allowed");
+	else if (target == "/stats")
+		sendStatistics(server, connection);
+	else if (!isTile || level < 0 || level > MAX_SERVER_LEVEL || x < 0 || y < 0 || x >= (1 << level) || y >= (1 << level))
+		sendError(connection, "404 Not Found");
+	else {
+		std::string key = std::to_string(level) + '/' + std::to_string(x) + '/' + std::to_string(y);
+
+		// Memory, then disk, then render
+
+		tileData data = server.cache->get(key);
+		if (data != nullptr)
+			++server.memoryHits;
+		else if ((data = readTileFile(tilePath(server, level, x, y))) != nullptr) {
+			server.cache->put(key, data);
+			++server.diskHits;
+		}
+		else {
+			data = waitForTile(server, connection, key, level, x, y);
+			if (data == nullptr && peerClosed(connection)) {
+				closeSocket(connection);
+				return;
+			}
+		}
+
+		if (data != nullptr)
+			sendResponse(connection, "200 OK", "image/png", data->data(), data->size());
+		else
+			sendError(connection, "500 Internal Server Error");
+	}
+
+	closeSocket(connection);
+}
+
+
+// Identifier of the settings a tile depends on, tiles rendered with other settings go to another cache directory
+
+static std::string settingsHash(const std::string& settings) {
+	// 64 bit FNV-1a
+
+	uint64_t hash = 14695981039346656037ull;
+	for (unsigned char character : settings) {
+		hash ^= character;
+		hash *= 1099511628211ull;
+	}
+
+	char text[17];
+	std::snprintf(text, sizeof(text), "%016llx", (unsigned long long)hash);
+	return text;
+}
+
+
+int runTileServer(const std::vector<std::string>& args) {
+	std::vector<std::string> positional = getPositional(args);
+	if (positional.size() != 3) {
+		std::cout << "Usage: --serve <x> <y> <zoom> [--port P] [--tile-size S] [--max-iterations N] [--palette name] [--palette-cycle C]"
+			" [--cache-memory MB] [--cache-directory directory] [--threads N]\n";
+		return -1;
+	}
+
+	serverState server;
+	server.tileSize = SERVER_TILE_SIZE;
+	server.maxIterations = SERVER_ITERATIONS;
+	server.paletteCycle = DEFAULT_PALETTE_CYCLE;
+	int port = SERVER_PORT;
+	double cacheMegabytes = SERVER_CACHE_MEGABYTES;
+	std::string value, paletteName, cacheDirectory = SERVER_CACHE_PATH;
+
+	try {
+		server.root.center.x = std::stod(value = positional[0]);
+		server.root.center.y = std::stod(value = positional[1]);
+		server.root.zoom = std::stod(value = positional[2]);
+		if (getOption(args, "--port", value)) port = std::stoi(value);
+		if (getOption(args, "--tile-size", value)) server.tileSize = std::stoi(value);
+		if (getOption(args, "--max-iterations", value)) server.maxIterations = std::stoi(value);
+		if (getOption(args, "--palette-cycle", value)) server.paletteCycle = std::stof(value);
+		if (getOption(args, "--cache-memory", value)) cacheMegabytes = std::stod(value);
+	}
+	catch (const std::exception&) {
+		std::cout << "ERROR:INVALID_OPTION_VALUE " << value << '\n';
+		return -1;
+	}
+	getOption(args, "--palette", paletteName);
+	getOption(args, "--cache-directory", cacheDirectory);
+	unsigned threads = getThreadCount(args);
+
+	if (server.root.zoom <= 0 || port < 0 || port > 65535 || server.tileSize <= 1 || server.maxIterations <= 0 || server.paletteCycle <= 0 || cacheMegabytes < 0) {
+		std::cout << "ERROR:INVALID_OPTION_VALUE\n";
+		return -1;
+	}
+
+	std::vector<std::unique_ptr<Palette>> palettes = loadPalettes(SERVER_PALETTES_PATH);
+	server.palette = paletteName.empty() ? palettes.front().get() : findPalette(palettes, paletteName);
+	if (server.palette == nullptr) {
+		std::cout << "ERROR:UNKNOWN_PALETTE " << paletteName << '\n';
+		return -1;
+	}
+
+	std::ostringstream settings;
+	settings.precision(17);
+	settings << server.root.center.x << ' ' << server.root.center.y << ' ' << server.root.zoom << ' ' << server.tileSize << ' '
+		<< server.maxIterations << ' ' << server.palette->getName() << ' ' << server.paletteCycle;
+	server.cacheDirectory = std::filesystem::path(cacheDirectory) / settingsHash(settings.str());
+
+	uint16_t boundPort;
+	socketHandle listener = initializeSockets() ? listenOn((uint16_t)port, false, boundPort) : NO_SOCKET;
+	if (listener == NO_SOCKET)
+		return 1;
+
+	server.cache = new TileCache((size_t)(cacheMegabytes * 1024 * 1024));
+	for (std::atomic<uint64_t>* counter : { &server.requests, &server.memoryHits, &server.diskHits, &server.rendered, &server.coalesced, &server.cancelled, &server.failed })
+		*counter = 0;
+
+	std::cout << "Serving tiles on http://127.0.0.1:" << boundPort << "/{z}/{x}/{y}.png, statistics on /stats, disk cache in "
+		<< server.cacheDirectory.string() << std::endl;
+
+	// The server runs until the process is stopped
+
+	for (unsigned i = 0; i < threads; ++i)
+		std::thread(renderTiles, std::ref(server)).detach();
+
+	while (true) {
+		socketHandle connection = acceptConnection(listener);
+		if (connection != NO_SOCKET)
+			std::thread(handleConnection, std::ref(server), connection).detach();
+	}
+}
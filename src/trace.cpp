@@ -0,0 +1,221 @@
+#include "trace.h"
+#include "json_writer.h"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <cstdlib>
+
+
+// Number of events allocated at once for a thread
+constexpr size_t TRACE_CHUNK_EVENTS = 4096;
+
+
+struct traceEvent {
+	const char* name;
+	int64_t start, end;
+	unsigned threadId;
+};
+
+// Events are stored in a list of fixed size chunks that never move, so the writer of the trace can read
+// the published events while their thread keeps appending: count and next are stored with release order
+// after the events they publish
+
+struct traceChunk {
+	traceEvent events[TRACE_CHUNK_EVENTS];
+	std::atomic<size_t> count{ 0 };
+	std::atomic<traceChunk*> next{ nullptr };
+};
+
+// A buffer handed to a new thread keeps the events of the threads before it, every event carries the id of its thread
+
+struct traceThreadBuffer {
+	traceChunk* first;
+	traceChunk* last;
+	unsigned threadId;
+	std::atomic<const char*>* name;
+};
+
+
+std::atomic<bool> traceEnabled(false);
+
+static std::string tracePath;
+static std::chrono::steady_clock::time_point traceStart;
+
+// Buffers of every thread that recorded an event, they are kept until the program exits
+// The buffer of a thread that has ended is handed to the next new thread, so short lived workers (started for
+// every frame of a video) reuse a few buffers instead of allocating one each
+static std::mutex traceRegistryMutex;
+static std::vector<traceThreadBuffer*> traceRegistry;
+static std::vector<traceThreadBuffer*> traceReleasedBuffers;
+
+// Name of every thread id (id 1 first), a thread that reuses a buffer gets a new id and name
+static std::vector<std::atomic<const char*>*> traceThreadNames;
+
+struct traceThreadHandle {
+	traceThreadBuffer* buffer = nullptr;
+
+	~traceThreadHandle() {
+		if (buffer != nullptr) {
+			std::lock_guard<std::mutex> lock(traceRegistryMutex);
+			traceReleasedBuffers.push_back(buffer);
+		}
+	}
+};
+
+static thread_local traceThreadHandle threadHandle;
+
+
+// Buffer of the calling thread, taken on first use (the only time a lock is taken)
+
+static traceThreadBuffer* getThreadBuffer() {
+	if (threadHandle.buffer == nullptr) {
+		std::lock_guard<std::mutex> lock(traceRegistryMutex);
+
+		traceThreadBuffer* buffer;
+		if (!traceReleasedBuffers.empty()) {
+			buffer = traceReleasedBuffers.back();
+			traceReleasedBuffers.pop_back();
+		}
+		else {
+			buffer = new traceThreadBuffer;
+			buffer->first = buffer->last = new traceChunk;
+			traceRegistry.push_back(buffer);
+		}
+
+		traceThreadNames.push_back(new std::atomic<const char*>(nullptr));
+		buffer->threadId = (unsigned)traceThreadNames.size();
+		buffer->name = traceThreadNames.back();
+		threadHandle.buffer = buffer;
+	}
+
+	return threadHandle.buffer;
+}
+
+
+static void writeTraceAtExit() {
+	stopTracing();
+}
+
+
+void startTracing(const char* path) {
+	static bool exitHandlerRegistered = false;
+	if (!exitHandlerRegistered) {
+		std::atexit(writeTraceAtExit);
+		exitHandlerRegistered = true;
+	}
+
+	tracePath = path;
+	traceStart = std::chrono::steady_clock::now();
+	traceEnabled = true;
+}
+
+
+bool stopTracing() {
+	if (!traceEnabled.exchange(false))
+		return true;
+
+	std::ofstream out(tracePath);
+	if (!out) {
+		std::cout << "ERROR:TRACE_COULD_NOT_BE_WRITTEN " << tracePath << '\n';
+		return false;
+	}
+
+	std::vector<traceThreadBuffer*> buffers;
+	std::vector<std::atomic<const char*>*> names;
+	{
+		std::lock_guard<std::mutex> lock(traceRegistryMutex);
+		buffers = traceRegistry;
+		names = traceThreadNames;
+	}
+
+	// Complete events ("X") with microsecond timestamps, plus the names of the threads as metadata
+
+	JsonWriter json(out);
+	json.beginObject();
+	json.key("displayTimeUnit");
+	json.value("ms");
+	json.key("traceEvents");
+	json.beginArray();
+
+	for (size_t i = 0; i < names.size(); ++i) {
+		const char* name = names[i]->load(std::memory_order_acquire);
+		if (name != nullptr) {
+			json.beginObject();
+			json.key("name");
+			json.value("thread_name");
+			json.key("ph");
+			json.value("M");
+			json.key("pid");
+			json.value(1);
+			json.key("tid");
+			json.value((unsigned)i + 1);
+			json.key("args");
+			json.beginObject();
+			json.key("name");
+			json.value(name);
+			json.endObject();
+			json.endObject();
+		}
+	}
+
+	for (traceThreadBuffer* buffer : buffers) {
+		for (traceChunk* chunk = buffer->first; chunk != nullptr; chunk = chunk->next.load(std::memory_order_acquire)) {
+			size_t count = chunk->count.load(std::memory_order_acquire);
+			for (size_t i = 0; i < count; ++i) {
+				const traceEvent& event = chunk->events[i];
+				json.beginObject();
+				json.key("name");
+				json.value(event.name);
+				json.key("ph");
+				json.value("X");
+				json.key("pid");
+				json.value(1);
+				json.key("tid");
+				json.value(event.threadId);
+				json.key("ts");
+				json.value(event.start / 1000.0);
+				json.key("dur");
+				json.value((event.end - event.start) / 1000.0);
+				json.endObject();
+			}
+		}
+	}
+
+	json.endArray();
+	json.endObject();
+	out << '\n';
+
+	return (bool)out;
+}
+
+
+void setTraceThreadName(const char* name) {
+	if (traceEnabled.load(std::memory_order_relaxed))
+		getThreadBuffer()->name->store(name, std::memory_order_release);
+}
+
+
+int64_t traceNow() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - traceStart).count();
+}
+
+
+void recordTraceEvent(const char* name, const int64_t& start, const int64_t& end) {
+	traceThreadBuffer* buffer = getThreadBuffer();
+	traceChunk* chunk = buffer->last;
+	size_t count = chunk->count.load(std::memory_order_relaxed);
+
+	if (count == TRACE_CHUNK_EVENTS) {
+		traceChunk* next = new traceChunk;
+		chunk->next.store(next, std::memory_order_release);
+		buffer->last = chunk = next;
+		count = 0;
+	}
+
+	chunk->events[count] = { name, start, end, buffer->threadId };
+	chunk->count.store(count + 1, std::memory_order_release);
+}
@@ -0,0 +1,376 @@
+#include "zoom_video.h"
+#include "cli.h"
+#include "mandelbrot.h"
+#include "png_writer.h"
+#include "frame_stream.h"
+#include "escape_stats.h"
+#include "memory_registry.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <algorithm>
+#include <numeric>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cmath>
+
+
+// Set the default frame size, frame rate, iteration count and palette directory
+constexpr int VIDEO_WIDTH = 1280, VIDEO_HEIGHT = 720;
+constexpr double VIDEO_FPS = 30.0;
+constexpr int VIDEO_ITERATIONS = 1000;
+const char* VIDEO_PALETTES_PATH = "./palettes";
+
+// A pixel is only resampled from a frame that is at least this many times deeper, so that every
+// target pixel averages several source pixels instead of blurring a single one
+constexpr double DEFAULT_REUSE_RATIO = 1.5;
+
+// Number of frames kept as sources per reuse ratio (bounds the memory independently of the frame rate)
+constexpr int SOURCES_PER_REUSE_RATIO = 4;
+
+
+// A finished frame that later (shallower) frames can be resampled from
+
+struct renderedFrame {
+	viewState view;
+	std::vector<unsigned char> rgb;
+};
+
+
+bool readKeyframes(const char* path, const int& defaultIterations, std::vector<zoomKeyframe>& keyframes) {
+	std::ifstream in(path);
+
+	if (!in) {
+		std::cout << "ERROR:KEYFRAME_FILE_COULD_NOT_BE_READ " << path << '\n';
+		return false;
+	}
+
+	std::string line;
+	for (int number = 1; std::getline(in, line); ++number) {
+		size_t start = line.find_first_not_of(" \t\r");
+		if (start == std::string::npos || line[start] == '#')
+			continue;
+
+		std::istringstream fields(line);
+		zoomKeyframe keyframe{ 0.0, {}, 1.0, defaultIterations };
+
+		if (!(fields >> keyframe.time >> keyframe.center.x >> keyframe.center.y >> keyframe.zoom) || keyframe.zoom <= 0
+			|| (!keyframes.empty() && keyframe.time <= keyframes.back().time)) {
+			std::cout << "ERROR:KEYFRAME_INVALID " << path << ':' << number << '\n';
+			return false;
+		}
+
+		int iterations;
+		if (fields >> iterations && iterations > 0)
+			keyframe.maxIterations = iterations;
+
+		keyframes.push_back(keyframe);
+	}
+
+	if (keyframes.empty()) {
+		std::cout << "ERROR:KEYFRAME_FILE_EMPTY " << path << '\n';
+		return false;
+	}
+
+	return true;
+}
+
+
+viewState interpolateKeyframes(const std::vector<zoomKeyframe>& keyframes, const double& time, const int& width, const int& height) {
+	// Find the keyframes around the time
+
+	size_t next = 1;
+	while (next < keyframes.size() && keyframes[next].time < time)
+		++next;
+
+	if (next >= keyframes.size() || time <= keyframes.front().time) {
+		const zoomKeyframe& keyframe = (time <= keyframes.front().time) ? keyframes.front() : keyframes.back();
+		return { keyframe.center, keyframe.zoom, keyframe.maxIterations, width, height };
+	}
+
+	const zoomKeyframe& a = keyframes[next - 1];
+	const zoomKeyframe& b = keyframes[next];
+	double s = (time - a.time) / (b.time - a.time);
+
+	// Exponential interpolation makes every frame zoom by the same factor
+
+	double zoom = a.zoom * std::pow(b.zoom / a.zoom, s);
+
+	// The size of the visible area is proportional to 1 / zoom, moving the center in proportion to it
+	// keeps the screen space speed constant (a straight line in the zoomed in image)
+
+	double weight = (a.zoom == b.zoom) ? s : (1 / a.zoom - 1 / zoom) / (1 / a.zoom - 1 / b.zoom);
+	coord center{
+		a.center.x + (b.center.x - a.center.x) * weight,
+		a.center.y + (b.center.y - a.center.y) * weight
+	};
+
+	int iterations = (int)std::lround(a.maxIterations * std::pow((double)b.maxIterations / a.maxIterations, s));
+
+	return { center, zoom, iterations, width, height };
+}
+
+
+// Average of the source pixels under the footprint of a target pixel, returns false if the footprint
+// is not entirely inside the source image
+
+static bool resamplePixel(const renderedFrame& source, const viewState& target, const int& column, const int& row, unsigned char* rgb) {
+	double x0, y0, x1, y1;
+	coordToImage(source.view, imageToCoord(target, column, row), x0, y0);
+	coordToImage(source.view, imageToCoord(target, column + 1.0, row + 1.0), x1, y1);
+
+	if (x0 > x1)
+		std::swap(x0, x1);
+	if (y0 > y1)
+		std::swap(y0, y1);
+
+	if (x0 < 0 || y0 < 0 || x1 > source.view.width || y1 > source.view.height)
+		return false;
+
+	// Box filter: every source pixel is weighted by the area it shares with the footprint
+
+	double sum[3] = { 0.0, 0.0, 0.0 }, totalWeight = 0.0;
+
+	for (int y = (int)y0; y < (int)std::ceil(y1) && y < source.view.height; ++y) {
+		double height = std::min(y1, y + 1.0) - std::max(y0, (double)y);
+		for (int x = (int)x0; x < (int)std::ceil(x1) && x < source.view.width; ++x) {
+			double weight = height * (std::min(x1, x + 1.0) - std::max(x0, (double)x));
+			const unsigned char* pixel = source.rgb.data() + ((size_t)y * source.view.width + x) * 3;
+			for (int channel = 0; channel < 3; ++channel)
+				sum[channel] += weight * pixel[channel];
+			totalWeight += weight;
+		}
+	}
+
+	if (totalWeight <= 0)
+		return false;
+
+	for (int channel = 0; channel < 3; ++channel)
+		rgb[channel] = (unsigned char)std::lround(sum[channel] / totalWeight);
+
+	return true;
+}
+
+
+int runZoomVideo(const std::vector<std::string>& args) {
+	std::vector<std::string> positional = getPositional(args);
+	std::string streamTarget;
+	bool streaming = getOption(args, "--stream", streamTarget);
+
+	if (positional.size() != (streaming ? 1 : 2)) {
+		std::cout << "Usage: --zoom-video <keyframe file> <output directory> [--width W] [--height H] [--fps F] [--max-iterations N]"
+			" [--palette name] [--palette-cycle C] [--reuse-ratio R] [--resume] [--threads N]\n"
+			"       --zoom-video <keyframe file> --stream <file | named pipe | -> [--pixel-format rgb24 | yuv420p] [...]\n";
+		return -1;
+	}
+
+	int width = VIDEO_WIDTH, height = VIDEO_HEIGHT, iterations = VIDEO_ITERATIONS;
+	double fps = VIDEO_FPS, reuseRatio = DEFAULT_REUSE_RATIO;
+	float paletteCycle = DEFAULT_PALETTE_CYCLE;
+	std::string value, paletteName;
+
+	try {
+		if (getOption(args, "--width", value)) width = std::stoi(value);
+		if (getOption(args, "--height", value)) height = std::stoi(value);
+		if (getOption(args, "--fps", value)) fps = std::stod(value);
+		if (getOption(args, "--max-iterations", value)) iterations = std::stoi(value);
+		if (getOption(args, "--palette-cycle", value)) paletteCycle = std::stof(value);
+		if (getOption(args, "--reuse-ratio", value)) reuseRatio = std::stod(value);
+	}
+	catch (const std::exception&) {
+		std::cout << "ERROR:INVALID_OPTION_VALUE " << value << '\n';
+		return -1;
+	}
+	getOption(args, "--palette", paletteName);
+	unsigned threads = getThreadCount(args);
+
+	// Frames are only written under their final name once complete, so a killed render can skip the existing ones
+	bool resume = hasFlag(args, "--resume");
+
+	rawPixelFormat pixelFormat = rawPixelFormat::RGB24;
+	if (getOption(args, "--pixel-format", value) && !parsePixelFormat(value, pixelFormat)) {
+		std::cout << "ERROR:INVALID_OPTION_VALUE " << value << '\n';
+		return -1;
+	}
+
+	// 4:2:0 chroma covers 2 x 2 pixels
+	bool oddSize = pixelFormat == rawPixelFormat::YUV420P && (width % 2 != 0 || height % 2 != 0);
+
+	if (width <= 0 || height <= 0 || fps <= 0 || iterations <= 0 || paletteCycle <= 0 || reuseRatio < 1 || oddSize || (streaming && resume)) {
+		std::cout << "ERROR:INVALID_OPTION_VALUE\n";
+		return -1;
+	}
+
+	// The stream is opened first, so that with stdout as the target every later message already goes to stderr
+
+	std::unique_ptr<FrameStream> stream;
+	if (streaming) {
+		stream = std::make_unique<FrameStream>(streamTarget, width, height, pixelFormat);
+		if (!stream->isOpen())
+			return -1;
+	}
+
+	std::vector<zoomKeyframe> keyframes;
+	if (!readKeyframes(positional[0].c_str(), iterations, keyframes))
+		return -1;
+
+	// Escape statistics of the pixels each frame iterates (pixels reused from deeper frames are not counted)
+
+	std::unique_ptr<EscapeStatisticsLog> statisticsLog;
+	if (!getGlobalOptions().statisticsLogPath.empty()) {
+		statisticsLog = std::make_unique<EscapeStatisticsLog>(getGlobalOptions().statisticsLogPath);
+		if (!statisticsLog->isOpen())
+			return -1;
+	}
+
+	std::vector<std::unique_ptr<Palette>> palettes = loadPalettes(VIDEO_PALETTES_PATH);
+	Palette* palette = paletteName.empty() ? palettes.front().get() : findPalette(palettes, paletteName);
+	if (palette == nullptr) {
+		std::cout << "ERROR:UNKNOWN_PALETTE " << paletteName << '\n';
+		return -1;
+	}
+
+	if (!streaming)
+		std::filesystem::create_directories(positional[1]);
+
+	// Views of all frames
+
+	size_t frameCount = (size_t)std::floor((keyframes.back().time - keyframes.front().time) * fps) + 1;
+	std::vector<viewState> views(frameCount);
+	for (size_t i = 0; i < frameCount; ++i)
+		views[i] = interpolateKeyframes(keyframes, keyframes.front().time + i / fps, width, height);
+
+	// Render from the deepest to the shallowest frame, so that the center of a frame can be resampled
+	// from frames that were already rendered at a higher pixel density
+	// A stream needs the frames in time order, then only the parts of the path that zoom out reuse pixels
+
+	std::vector<size_t> order(frameCount);
+	std::iota(order.begin(), order.end(), 0);
+	if (!streaming)
+		std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return views[a].zoom > views[b].zoom; });
+	else
+		std::cout << "Streaming " << frameCount << " frames to " << streamTarget << ", read them with: ffmpeg -f rawvideo -pix_fmt "
+			<< pixelFormatName(pixelFormat) << " -video_size " << width << 'x' << height << " -framerate " << fps << " -i " << streamTarget << '\n';
+
+	double sourceStep = std::pow(reuseRatio, 1.0 / SOURCES_PER_REUSE_RATIO);
+	std::deque<renderedFrame> sources;
+	TrackedMemory sourceMemory("zoom video sources", memoryDomain::cpu);
+	int64_t frameBytes = (int64_t)width * height * 3;
+	uint64_t reusedPixels = 0, totalPixels = 0, skippedFrames = 0;
+	auto start = std::chrono::steady_clock::now();
+
+	for (size_t done = 0; done < frameCount; ++done) {
+		size_t index = order[done];
+		const viewState& view = views[index];
+
+		char name[32];
+		std::snprintf(name, sizeof(name), "/frame_%06zu.png", index);
+		std::string path = streaming ? std::string() : positional[1] + name;
+
+		// A skipped frame is not available as a source, the next frames compute more of their pixels instead
+		if (resume && std::filesystem::exists(path)) {
+			++skippedFrames;
+			continue;
+		}
+
+		// Sources are ordered from the deepest to the shallowest, a frame deeper than the previous one starts over
+		if (!sources.empty() && view.zoom > sources.back().view.zoom)
+			sources.clear();
+
+		// The best source is the shallowest frame that is still at least reuseRatio times deeper
+
+		while (sources.size() >= 2 && sources[1].view.zoom >= view.zoom * reuseRatio)
+			sources.pop_front();
+		sourceMemory.set((int64_t)sources.size() * frameBytes);
+		const renderedFrame* source = (!sources.empty() && sources.front().view.zoom >= view.zoom * reuseRatio) ? &sources.front() : nullptr;
+
+		renderedFrame frame{ view, std::vector<unsigned char>((size_t)width * height * 3) };
+		std::atomic<uint64_t> reused(0);
+
+		// Statistics of the iterated pixels, every row is reduced on its own and merged once
+		escapeStatistics frameStatistics;
+		frameStatistics.maxIterations = (uint32_t)view.maxIterations;
+		std::mutex statisticsMutex;
+
+		parallelRows(height, threads, [&](int row) {
+			uint64_t rowReused = 0;
+			escapeStatistics rowStatistics;
+			rowStatistics.maxIterations = (uint32_t)view.maxIterations;
+
+			for (int column = 0; column < width; ++column) {
+				unsigned char* pixel = frame.rgb.data() + ((size_t)row * width + column) * 3;
+
+				if (source != nullptr && resamplePixel(*source, view, column, row, pixel)) {
+					++rowReused;
+					continue;
+				}
+
+				coord c = imageToCoord(view, column + 0.5, row + 0.5);
+				pixelEscape escape = iterateMandelbrot(c.x, c.y, view.maxIterations);
+				std::array<unsigned char, 3> color = map_to_color(*palette, escape, paletteCycle);
+				std::copy(color.begin(), color.end(), pixel);
+
+				if (statisticsLog != nullptr)
+					rowStatistics.add(escape);
+			}
+			reused += rowReused;
+
+			if (statisticsLog != nullptr) {
+				std::lock_guard<std::mutex> lock(statisticsMutex);
+				frameStatistics.merge(rowStatistics);
+			}
+		});
+
+		if (statisticsLog != nullptr)
+			statisticsLog->write(index, frameStatistics);
+
+		if (streaming) {
+			if (!stream->write(frame.rgb)) {
+				std::cout << "ERROR:STREAM_COULD_NOT_BE_WRITTEN " << streamTarget << '\n';
+				return 1;
+			}
+		}
+		else {
+			std::error_code error;
+			bool written = writePng((path + ".tmp").c_str(), frame.rgb.data(), width, height);
+			if (written)
+				std::filesystem::rename(path + ".tmp", path, error);
+
+			if (!written || error) {
+				std::cout << "ERROR:FRAME_COULD_NOT_BE_WRITTEN " << path << '\n';
+				return 1;
+			}
+		}
+
+		reusedPixels += reused;
+		totalPixels += (uint64_t)width * height;
+		std::cout << '[' << done + 1 << '/' << frameCount << "] frame " << index << " zoom " << view.zoom
+			<< ", " << 100.0 * reused / ((double)width * height) << "% reused\n";
+
+		// Keep a few frames per reuse ratio as sources for the following frames, dropping the deepest ones
+		// if the memory budget cannot hold them
+
+		if (sources.empty() || sources.back().view.zoom >= view.zoom * sourceStep) {
+			while (!sources.empty() && !sourceMemory.fits((int64_t)(sources.size() + 1) * frameBytes))
+				sources.pop_front();
+			sources.push_back(std::move(frame));
+			sourceMemory.set((int64_t)sources.size() * frameBytes);
+		}
+	}
+
+	if (streaming && !stream->finish()) {
+		std::cout << "ERROR:STREAM_COULD_NOT_BE_WRITTEN " << streamTarget << '\n';
+		return 1;
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "Rendered " << frameCount - skippedFrames << " frames in " << seconds << " s (" << skippedFrames << " already existed), "
+		<< 100.0 * reusedPixels / std::max<double>((double)totalPixels, 1) << "% of the pixels were resampled\n";
+
+	return 0;
+}